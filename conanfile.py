@@ -11,8 +11,8 @@ class UcaNetConan(ConanFile):
     description = "TCP-based network bridge for libuca."
     topics = ("utilities",)
     settings = "os", "compiler", "build_type", "arch"
-    options = {"shared": [True, False], "with_zeromq": [True, False]}
-    default_options = {"shared": True, "with_zeromq": False}
+    options = {"shared": [True, False], "with_zeromq": [True, False], "with_lz4": [True, False]}
+    default_options = {"shared": True, "with_zeromq": False, "with_lz4": False}
     generators = "CMakeDeps"
     exports_sources = "*.h", "*.c", "cmake/*", "CMakeLists.txt", "config.h.in"
     
@@ -27,10 +27,13 @@ class UcaNetConan(ConanFile):
         if self.options.with_zeromq:
             self.requires("zeromq/4.3.5")
             self.requires("json-c/0.18")
+        if self.options.with_lz4:
+            self.requires("lz4/1.9.4")
 
     def generate(self):
         toolchain = CMakeToolchain(self)
         toolchain.variables["WITH_ZMQ_NETWORKING"] = (self.options.with_zeromq == True)
+        toolchain.variables["WITH_LZ4"] = (self.options.with_lz4 == True)
         toolchain.variables["USE_FIND_PACKAGE_FOR_GLIB"] = True
         toolchain.generate()
 
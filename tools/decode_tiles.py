@@ -0,0 +1,56 @@
+"""Reference decoder for ucad endpoints in UCA_NET_ENDPOINT_TILES mode.
+
+Usage with a PULL or SUB socket connected to such an endpoint::
+
+    decoder = TileDecoder()
+
+    while True:
+        header, data = socket.recv_multipart()
+        frame = decoder.decode(header, data)
+"""
+import json
+import numpy as np
+
+
+class TileDecoder:
+    def __init__(self):
+        self.keyframe = None
+        self.keyframe_number = None
+
+    def decode(self, header, data):
+        """Return the frame described by *header* and *data* as numpy array."""
+        if isinstance(header, (bytes, str)):
+            header = json.loads(header)
+
+        height, width = header['shape']
+        dtype = np.dtype(header['dtype'])
+        tiles = header['tiles']
+        values = np.frombuffer(data, dtype=dtype)
+
+        if tiles['keyframe']:
+            self.keyframe = values.reshape(height, width).copy()
+            self.keyframe_number = int(header['frame-number'])
+            return self.keyframe.copy()
+
+        if self.keyframe is None or tiles['keyframe-number'] != self.keyframe_number:
+            raise ValueError('Key frame {} was not received'.format(tiles['keyframe-number']))
+
+        frame = self.keyframe.copy()
+        size = tiles['size']
+        bitmap = bytes.fromhex(tiles['bitmap'])
+        num_x = (width + size - 1) // size
+        num_y = (height + size - 1) // size
+        offset = 0
+
+        for index in range(num_x * num_y):
+            if not bitmap[index // 8] & (1 << (index % 8)):
+                continue
+
+            y = (index // num_x) * size
+            x = (index % num_x) * size
+            h = min(size, height - y)
+            w = min(size, width - x)
+            frame[y:y + h, x:x + w] = values[offset:offset + h * w].reshape(h, w)
+            offset += h * w
+
+        return frame
@@ -0,0 +1,51 @@
+"""Reader for frames recorded by ucad to a file:// endpoint.
+
+The index (PREFIX.idx) is a fixed-size header followed by one fixed-size entry
+per frame, so any frame is located without scanning::
+
+    recording = Recording('/data/run')
+    print(len(recording))
+    frame = recording[1000]
+"""
+import os
+import struct
+import numpy as np
+
+HEADER = struct.Struct('=8sIIII')
+ENTRY = struct.Struct('=QQqQQIIIIII')
+DTYPES = {1: np.uint8, 2: np.uint16, 3: np.float32, 4: np.uint32}
+
+
+class Recording:
+    def __init__(self, prefix):
+        self.prefix = prefix
+        self.index = open(prefix + '.idx', 'rb')
+        magic, version, entry_size, self.alignment, _ = HEADER.unpack(self.index.read(HEADER.size))
+
+        if magic != b'UCADREC1' or entry_size != ENTRY.size:
+            raise ValueError('{}.idx is not a ucad recording index'.format(prefix))
+
+    def __len__(self):
+        return (os.fstat(self.index.fileno()).st_size - HEADER.size) // ENTRY.size
+
+    def entry(self, k):
+        """Return the index entry of frame *k* as dictionary."""
+        if not 0 <= k < len(self):
+            raise IndexError(k)
+
+        self.index.seek(HEADER.size + k * ENTRY.size)
+        values = ENTRY.unpack(self.index.read(ENTRY.size))
+        keys = ('frame_number', 'sequence', 'timestamp', 'offset', 'size', 'file',
+                'width', 'height', 'pixel_size', 'bitdepth', 'dtype')
+
+        return dict(zip(keys, values))
+
+    def __getitem__(self, k):
+        entry = self.entry(k)
+        dtype = DTYPES.get(entry['dtype'], np.uint8 if entry['pixel_size'] == 1 else np.uint16)
+
+        with open('{}-{:06d}.raw'.format(self.prefix, entry['file']), 'rb') as f:
+            f.seek(entry['offset'])
+            data = f.read(entry['size'])
+
+        return np.frombuffer(data, dtype=dtype).reshape(entry['height'], entry['width'])
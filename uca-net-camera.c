@@ -15,6 +15,7 @@
    with this library; if not, write to the Free Software Foundation, Inc., 51
    Franklin St, Fifth Floor, Boston, MA 02110, USA */
 
+#include <math.h>
 #include <stdlib.h>
 #include <gio/gio.h>
 #include <gmodule.h>
@@ -23,11 +24,21 @@
 #include <uca/uca-camera.h>
 #include "uca-net-camera.h"
 #include "uca-net-protocol.h"
+#include "uca-net-pack.h"
 #include "config.h"
 
+#ifdef HAVE_UNIX
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
 
 #define UCA_NET_CAMERA_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), UCA_TYPE_NET_CAMERA, UcaNetCameraPrivate))
 
+/* Seconds to wait for the first timed trigger reply, which servers that do not
+ * know timed triggers never send */
+#define UCA_NET_CLOCK_SYNC_TIMEOUT 2
+
 static void uca_net_camera_initable_iface_init (GInitableIface *iface);
 
 G_DEFINE_TYPE_WITH_CODE (UcaNetCamera, uca_net_camera, UCA_TYPE_CAMERA,
@@ -42,6 +53,15 @@ GQuark uca_net_camera_error_quark ()
 enum {
     PROP_HOST = N_BASE_PROPERTIES,
     PROP_PORT,
+    PROP_COMPRESSION,
+    PROP_PACKING,
+    PROP_NUM_STREAMS,
+    PROP_GRAB_LATEST,
+    PROP_TRIGGER_ROUND_TRIP,
+    PROP_TRIGGER_DURATION,
+    PROP_CAMERA_NAME,
+    PROP_SERVER_STATS,
+    PROP_CLOCK_OFFSET,
     N_PROPERTIES
 };
 
@@ -50,8 +70,25 @@ static GParamSpec *net_properties[N_PROPERTIES] = { NULL, };
 struct _UcaNetCameraPrivate {
     GError              *construct_error;
     gchar               *host;
+    gchar               *camera_name;
     GSocketClient       *client;
     gsize                size;
+    UcaNetCodec          codec;
+    gchar               *compressed;
+    gsize                compressed_size;
+    gchar               *scratch;
+    gboolean             pack;
+    gchar               *packed;
+    gsize                packed_size;
+    guint                num_streams;
+    gboolean             grab_latest;
+    guint64              next_sequence;
+    GSocketConnection   *trigger_connection;
+    gboolean             timed_triggers;    /* Server answered a timed trigger */
+    gboolean             plain_triggers;    /* Server does not know timed triggers */
+    guint64              trigger_id;
+    gdouble              trigger_round_trip;
+    gdouble              trigger_duration;
 };
 
 
@@ -95,10 +132,76 @@ handle_default_reply (GSocketConnection *connection, UcaNetMessageType type, GEr
     return FALSE;
 }
 
+/*
+ * Read a reply of exactly size bytes, a closed connection is an error.
+ */
+static gboolean
+read_reply (GSocketConnection *connection, gpointer reply, gsize size, GError **error)
+{
+    GInputStream *input;
+    gsize bytes_read;
+
+    input = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+
+    if (!g_input_stream_read_all (input, reply, size, &bytes_read, NULL, error))
+        return FALSE;
+
+    if (bytes_read != size) {
+        g_set_error (error, UCA_NET_CAMERA_ERROR, UCA_NET_CAMERA_ERROR_NO_DATA,
+                     "Server closed the connection after %" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT " bytes",
+                     bytes_read, size);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Read the reply to a grab request, which is only a UcaNetDefaultReply unless
+ * the request was extended.
+ */
+static gboolean
+handle_grab_reply (GSocketConnection *connection, gboolean extended, UcaNetMessageGrabReply *reply, GError **error)
+{
+    memset (reply, 0, sizeof (UcaNetMessageGrabReply));
+
+    if (read_reply (connection, reply, extended ? sizeof (UcaNetMessageGrabReply) : sizeof (UcaNetDefaultReply), error)) {
+        g_warn_if_fail (UCA_NET_MESSAGE_GET_TYPE (reply->type) == UCA_NET_MESSAGE_GRAB);
+
+        if (reply->error.occurred) {
+            g_set_error_literal (error, g_quark_from_string (reply->error.domain), reply->error.code, reply->error.message);
+            return FALSE;
+        }
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
 static GSocketConnection *
 connect_socket (UcaNetCameraPrivate *priv, GError **error)
 {
-    return g_socket_client_connect_to_host (priv->client, priv->host, UCA_NET_DEFAULT_PORT, NULL, error);
+    GSocketConnection *connection;
+    GOutputStream *output;
+    UcaNetMessageSelectCameraRequest request = { .type = UCA_NET_MESSAGE_SELECT_CAMERA };
+
+    connection = g_socket_client_connect_to_host (priv->client, priv->host, UCA_NET_DEFAULT_PORT, NULL, error);
+
+    if (connection == NULL || priv->camera_name == NULL)
+        return connection;
+
+    /* Requests go to the default camera unless another one is selected */
+    output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+    g_strlcpy (request.name, priv->camera_name, sizeof (request.name));
+
+    if (!g_output_stream_write_all (output, &request, sizeof (request), NULL, NULL, error) ||
+        !handle_default_reply (connection, UCA_NET_MESSAGE_SELECT_CAMERA, error)) {
+        g_object_unref (connection);
+        return NULL;
+    }
+
+    return connection;
 }
 
 static void
@@ -146,6 +249,7 @@ uca_net_camera_start_recording (UcaCamera *camera,
     if (!priv->size) {
         uca_net_camera_determine_size (camera);
     }
+    priv->next_sequence = 0;
     request_call (priv, UCA_NET_MESSAGE_START_RECORDING, error);
 }
 
@@ -217,17 +321,125 @@ uca_net_camera_write (UcaCamera *camera,
     g_object_unref (connection);
 }
 
+typedef struct {
+    GInputStream *input;
+    gchar *buffer;
+    gsize size;
+    GError *error;
+} UcaNetStripe;
+
+static gpointer
+read_stripe (UcaNetStripe *stripe)
+{
+    gsize bytes_read;
+
+    if (g_input_stream_read_all (stripe->input, stripe->buffer, stripe->size, &bytes_read, NULL, &stripe->error) &&
+        bytes_read != stripe->size) {
+        g_set_error (&stripe->error, UCA_NET_CAMERA_ERROR, UCA_NET_CAMERA_ERROR_NO_DATA,
+                     "Server closed the connection after %" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT " bytes",
+                     bytes_read, stripe->size);
+    }
+
+    return NULL;
+}
+
+/*
+ * Open the additional connections of a striped grab and announce them with
+ * token. The first connection is the one the grab request went to.
+ */
+static gboolean
+open_stripes (UcaNetCameraPrivate *priv, guint32 token, GSocketConnection **connections, GError **error)
+{
+    for (guint i = 1; i < priv->num_streams; i++) {
+        UcaNetMessageGrabStripeRequest request = {
+            .type = UCA_NET_MESSAGE_GRAB_STRIPE,
+            .token = token,
+            .index = i,
+        };
+        GOutputStream *output;
+
+        connections[i] = connect_socket (priv, error);
+
+        if (connections[i] == NULL)
+            return FALSE;
+
+        output = g_io_stream_get_output_stream (G_IO_STREAM (connections[i]));
+
+        if (!g_output_stream_write_all (output, &request, sizeof (request), NULL, NULL, error))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Read size bytes into buffer, split across the connections in the same
+ * consecutive ranges ucad sends them. All but the first are read in their own
+ * thread.
+ */
+static gboolean
+read_stripes (GSocketConnection **connections, guint num_streams, gchar *buffer, gsize size, GError **error)
+{
+    UcaNetStripe stripes[UCA_NET_MAX_STREAMS];
+    GThread *threads[UCA_NET_MAX_STREAMS];
+    gboolean success = TRUE;
+
+    for (guint i = 0; i < num_streams; i++) {
+        gsize first = size * i / num_streams;
+        gsize last = size * (i + 1) / num_streams;
+
+        stripes[i].input = g_io_stream_get_input_stream (G_IO_STREAM (connections[i]));
+        stripes[i].buffer = buffer + first;
+        stripes[i].size = last - first;
+        stripes[i].error = NULL;
+
+        if (i > 0)
+            threads[i] = g_thread_new (NULL, (GThreadFunc) read_stripe, &stripes[i]);
+    }
+
+    read_stripe (&stripes[0]);
+
+    for (guint i = 1; i < num_streams; i++)
+        g_thread_join (threads[i]);
+
+    for (guint i = 0; i < num_streams; i++) {
+        if (stripes[i].error != NULL) {
+            if (success)
+                g_propagate_error (error, stripes[i].error);
+            else
+                g_error_free (stripes[i].error);
+
+            success = FALSE;
+        }
+    }
+
+    return success;
+}
+
+static void
+close_connections (GSocketConnection **connections, guint num_connections)
+{
+    for (guint i = 0; i < num_connections; i++) {
+        if (connections[i] != NULL)
+            g_object_unref (connections[i]);
+    }
+}
+
 static gboolean
 uca_net_camera_grab (UcaCamera *camera,
                      gpointer data,
                      GError **error)
 {
     UcaNetCameraPrivate *priv;
-    GSocketConnection *connection;
-    GInputStream *input;
+    GSocketConnection *connections[UCA_NET_MAX_STREAMS] = { NULL, };
     GOutputStream *output;
-    gsize bytes_left;
+    gchar *buffer;
+    gchar *target;
+    gsize expected;
+    guint num_streams;
+    gboolean extended;
     UcaNetMessageGrabRequest request = { .type = UCA_NET_MESSAGE_GRAB };
+    UcaNetMessageGrabReply reply;
 
     g_return_val_if_fail (UCA_IS_NET_CAMERA (camera), FALSE);
     priv = UCA_NET_CAMERA_GET_PRIVATE (camera);
@@ -236,49 +448,203 @@ uca_net_camera_grab (UcaCamera *camera,
         uca_net_camera_determine_size (camera);
     }
 
-    connection = connect_socket (priv, error);
-    g_return_val_if_fail (connection != NULL, FALSE);
-    input = g_io_stream_get_input_stream (G_IO_STREAM (connection));
-    output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+    num_streams = priv->num_streams;
+    connections[0] = connect_socket (priv, error);
+    g_return_val_if_fail (connections[0] != NULL, FALSE);
+    output = g_io_stream_get_output_stream (G_IO_STREAM (connections[0]));
     request.size = priv->size;
+    request.codec = priv->codec;
+    request.pack = priv->pack;
+    request.num_streams = num_streams;
+    request.token = g_random_int ();
+    request.position = priv->grab_latest ? UCA_NET_POSITION_LATEST : UCA_NET_POSITION_NEXT;
+    request.sequence = priv->next_sequence;
+
+    /* Plain grabs are sent as the original request, so that older servers
+     * understand them */
+    extended = priv->codec != UCA_NET_CODEC_NONE || priv->pack || num_streams > 1 ||
+               priv->grab_latest || priv->next_sequence != 0;
+
+    if (extended)
+        request.type |= UCA_NET_MESSAGE_EXTENDED;
 
     /* request */
-    if (!g_output_stream_write_all (output, &request, sizeof (request), NULL, NULL, error)) {
-        g_object_unref (connection);
+    if (!g_output_stream_write_all (output, &request,
+                                    extended ? sizeof (request) : sizeof (UcaNetMessageOriginalGrabRequest),
+                                    NULL, NULL, error) ||
+        !open_stripes (priv, request.token, connections, error)) {
+        close_connections (connections, num_streams);
         return FALSE;
     }
 
     /* error reply */
-    if (handle_default_reply (connection, UCA_NET_MESSAGE_GRAB, error)) {
-        bytes_left = priv->size;
+    if (!handle_grab_reply (connections[0], extended, &reply, error)) {
+        close_connections (connections, num_streams);
+        return FALSE;
+    }
 
-        while (bytes_left > 0) {
-            gssize read;
-            gchar *buffer;
+    if (!extended) {
+        reply.codec = UCA_NET_CODEC_NONE;
+        reply.size = priv->size;
+    }
+
+    /* Continue after this frame if ucad acquires continuously */
+    priv->next_sequence = reply.sequence != 0 ? reply.sequence + 1 : 0;
 
-            buffer = (gchar *) data;
-            read = g_input_stream_read (input, &buffer[priv->size - bytes_left], bytes_left, NULL, error);
+    if (reply.dropped > 0)
+        g_debug ("Missed %" G_GUINT64_FORMAT " frames", reply.dropped);
 
-            if (read < 0)
-                return FALSE;
+    /* Packed pixels are decoded into target and then unpacked into data */
+    target = (gchar *) data;
+    expected = priv->size;
 
-            bytes_left -= read;
+    if (reply.packed_bits != 0) {
+        if (!uca_net_pack_is_supported (reply.packed_bits)) {
+            g_set_error (error, UCA_NET_CAMERA_ERROR, UCA_NET_CAMERA_ERROR_MAYBE_CORRUPTED,
+                         "Unsupported packing of %u bits", reply.packed_bits);
+            close_connections (connections, num_streams);
+            return FALSE;
         }
 
-        g_object_unref (connection);
-        return TRUE;
+        expected = uca_net_pack_get_size (priv->size / 2, reply.packed_bits);
+
+        if (priv->packed_size < expected) {
+            priv->packed = g_realloc (priv->packed, expected);
+            priv->packed_size = expected;
+        }
+
+        target = priv->packed;
     }
 
-    g_object_unref (connection);
-    return FALSE;
+    if (reply.codec == UCA_NET_CODEC_NONE) {
+        if (reply.size != expected) {
+            g_set_error (error, UCA_NET_CAMERA_ERROR, UCA_NET_CAMERA_ERROR_MAYBE_CORRUPTED,
+                         "Expected %" G_GSIZE_FORMAT " bytes but server sends %" G_GSIZE_FORMAT,
+                         expected, reply.size);
+            close_connections (connections, num_streams);
+            return FALSE;
+        }
+
+        buffer = target;
+    }
+    else {
+        if (priv->compressed_size < reply.size) {
+            priv->compressed = g_realloc (priv->compressed, reply.size);
+            priv->compressed_size = reply.size;
+        }
+
+        buffer = priv->compressed;
+    }
+
+    if (!read_stripes (connections, num_streams, buffer, reply.size, error)) {
+        close_connections (connections, num_streams);
+        return FALSE;
+    }
+
+    close_connections (connections, num_streams);
+
+    if (reply.codec != UCA_NET_CODEC_NONE) {
+        if (priv->scratch == NULL)
+            priv->scratch = g_malloc (UCA_NET_CODEC_BLOCK_SIZE);
+
+        if (!uca_net_codec_decompress (buffer, reply.size, target, expected, priv->scratch, error))
+            return FALSE;
+    }
+
+    if (reply.packed_bits != 0)
+        uca_net_unpack ((const guint8 *) target, (guint16 *) data, priv->size / 2, reply.packed_bits);
+
+    return TRUE;
 }
 
+static gboolean
+request_timed_trigger (UcaNetCameraPrivate *priv, GError **error)
+{
+    GOutputStream *output;
+    UcaNetMessageTimedTriggerRequest request = { .type = UCA_NET_MESSAGE_TIMED_TRIGGER };
+    UcaNetMessageTimedTriggerReply reply;
+    gint64 start;
+
+    output = g_io_stream_get_output_stream (G_IO_STREAM (priv->trigger_connection));
+    request.id = ++priv->trigger_id;
+    start = g_get_monotonic_time ();
+
+    if (!g_output_stream_write_all (output, &request, sizeof (request), NULL, NULL, error) ||
+        !read_reply (priv->trigger_connection, &reply, sizeof (reply), error))
+        return FALSE;
+
+    if (reply.type != request.type || reply.id != request.id) {
+        g_set_error (error, UCA_NET_CAMERA_ERROR, UCA_NET_CAMERA_ERROR_TRIGGER,
+                     "Reply does not match trigger %" G_GUINT64_FORMAT, request.id);
+        return FALSE;
+    }
+
+    priv->trigger_round_trip = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+    priv->trigger_duration = (reply.completed - reply.issued) / (gdouble) G_USEC_PER_SEC;
+
+    /* The camera refused the trigger but the connection is still fine */
+    if (reply.error.occurred)
+        g_set_error_literal (error, g_quark_from_string (reply.error.domain), reply.error.code, reply.error.message);
+
+    return TRUE;
+}
+
+/*
+ * Triggers are sent on their own persistent connection without Nagle's
+ * algorithm, so that no connection setup adds to their latency. Servers which
+ * do not know timed triggers close the connection on the first one and are
+ * sent plain triggers from then on. A trigger is never sent twice, since the
+ * camera may have been triggered even if its reply is missing.
+ */
 static void
 uca_net_camera_trigger (UcaCamera *camera,
                         GError **error)
 {
+    UcaNetCameraPrivate *priv;
+    GError *trigger_error = NULL;
+
     g_return_if_fail (UCA_IS_NET_CAMERA (camera));
-    request_call (UCA_NET_CAMERA_GET_PRIVATE (camera), UCA_NET_MESSAGE_TRIGGER, error);
+    priv = UCA_NET_CAMERA_GET_PRIVATE (camera);
+
+    if (priv->plain_triggers) {
+        request_call (priv, UCA_NET_MESSAGE_TRIGGER, error);
+        return;
+    }
+
+    if (priv->trigger_connection == NULL) {
+        priv->trigger_connection = connect_socket (priv, error);
+
+        if (priv->trigger_connection == NULL)
+            return;
+
+#if defined (HAVE_UNIX) && GLIB_CHECK_VERSION (2, 36, 0)
+        g_socket_set_option (g_socket_connection_get_socket (priv->trigger_connection),
+                             IPPROTO_TCP, TCP_NODELAY, TRUE, NULL);
+#endif
+    }
+
+    if (request_timed_trigger (priv, &trigger_error)) {
+        priv->timed_triggers = TRUE;
+
+        if (trigger_error != NULL)
+            g_propagate_error (error, trigger_error);
+
+        return;
+    }
+
+    /* The connection is opened again with the next trigger */
+    g_clear_object (&priv->trigger_connection);
+
+    if (!priv->timed_triggers &&
+        g_error_matches (trigger_error, UCA_NET_CAMERA_ERROR, UCA_NET_CAMERA_ERROR_NO_DATA)) {
+        g_debug ("Server does not support timed triggers, sending plain ones");
+        g_error_free (trigger_error);
+        priv->plain_triggers = TRUE;
+        request_call (priv, UCA_NET_MESSAGE_TRIGGER, error);
+        return;
+    }
+
+    g_propagate_error (error, trigger_error);
 }
 
 static gboolean
@@ -333,6 +699,38 @@ uca_net_camera_set_property (GObject *object,
         return;
     }
 
+    if (property_id == PROP_CAMERA_NAME) {
+        g_free (priv->camera_name);
+        priv->camera_name = g_value_dup_string (value);
+        return;
+    }
+
+    if (property_id == PROP_COMPRESSION) {
+        if (!g_value_get_boolean (value))
+            priv->codec = UCA_NET_CODEC_NONE;
+        else if (uca_net_codec_is_available (UCA_NET_CODEC_SHUFFLE_LZ4))
+            priv->codec = UCA_NET_CODEC_SHUFFLE_LZ4;
+        else
+            g_warning ("Compression not available, transferring uncompressed frames");
+
+        return;
+    }
+
+    if (property_id == PROP_PACKING) {
+        priv->pack = g_value_get_boolean (value);
+        return;
+    }
+
+    if (property_id == PROP_NUM_STREAMS) {
+        priv->num_streams = g_value_get_uint (value);
+        return;
+    }
+
+    if (property_id == PROP_GRAB_LATEST) {
+        priv->grab_latest = g_value_get_boolean (value);
+        return;
+    }
+
     /* handle remote props */
     connection = connect_socket (priv, &error);
     g_return_if_fail (connection != NULL);
@@ -421,6 +819,110 @@ request_get_property (GSocketConnection *connection, const gchar *name, GValue *
     return TRUE;
 }
 
+static gchar *
+request_stats (UcaNetCameraPrivate *priv, GError **error)
+{
+    GSocketConnection *connection;
+    GInputStream *input;
+    UcaNetMessageGetStatsReply reply;
+    gchar *stats = NULL;
+
+    connection = connect_socket (priv, error);
+
+    if (connection == NULL)
+        return NULL;
+
+    input = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+
+    if (send_default_message (connection, UCA_NET_MESSAGE_GET_STATS, error) &&
+        g_input_stream_read_all (input, &reply, sizeof (reply), NULL, NULL, error)) {
+        g_warn_if_fail (reply.type == UCA_NET_MESSAGE_GET_STATS);
+
+        if (reply.error.occurred) {
+            g_set_error_literal (error, g_quark_from_string (reply.error.domain), reply.error.code, reply.error.message);
+        }
+        else {
+            stats = g_malloc0 (reply.size + 1);
+
+            if (!g_input_stream_read_all (input, stats, reply.size, NULL, NULL, error)) {
+                g_free (stats);
+                stats = NULL;
+            }
+        }
+    }
+
+    g_object_unref (connection);
+
+    return stats;
+}
+
+/*
+ * Offset of the monotonic clock of ucad to ours in microseconds, taken from
+ * the exchange with the shortest round trip out of a few. Servers which do not
+ * know clock syncs close the connection, and replies are only waited for a
+ * while so that a stuck server does not block the property.
+ */
+static gboolean
+request_clock_offset (UcaNetCameraPrivate *priv, gint64 *offset, GError **error)
+{
+    GSocketConnection *connection;
+    GOutputStream *output;
+    UcaNetMessageClockSyncRequest request = { .type = UCA_NET_MESSAGE_CLOCK_SYNC };
+    UcaNetMessageClockSyncReply reply;
+    gint64 best_round_trip = G_MAXINT64;
+
+    connection = connect_socket (priv, error);
+
+    if (connection == NULL)
+        return FALSE;
+
+    g_socket_set_timeout (g_socket_connection_get_socket (connection), UCA_NET_CLOCK_SYNC_TIMEOUT);
+    output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+
+    for (guint i = 0; i < 8; i++) {
+        gint64 received;
+
+        request.client_time = g_get_monotonic_time ();
+
+        if (!g_output_stream_write_all (output, &request, sizeof (request), NULL, NULL, error) ||
+            !read_reply (connection, &reply, sizeof (reply), error))
+            break;
+
+        received = g_get_monotonic_time ();
+
+        if (reply.type != request.type || reply.client_time != request.client_time) {
+            g_set_error_literal (error, UCA_NET_CAMERA_ERROR, UCA_NET_CAMERA_ERROR_NO_DATA,
+                                 "Reply does not match clock sync request");
+            break;
+        }
+
+        if (reply.error.occurred) {
+            g_set_error_literal (error, g_quark_from_string (reply.error.domain), reply.error.code, reply.error.message);
+            break;
+        }
+
+        if (received - reply.client_time < best_round_trip) {
+            best_round_trip = received - reply.client_time;
+            *offset = reply.monotonic - (reply.client_time + received) / 2;
+        }
+    }
+
+    g_object_unref (connection);
+
+    /* A failed exchange does not matter if an earlier one succeeded */
+    if (best_round_trip == G_MAXINT64) {
+        if (error != NULL && *error == NULL)
+            g_set_error_literal (error, UCA_NET_CAMERA_ERROR, UCA_NET_CAMERA_ERROR_NO_DATA,
+                                 "No clock sync exchange succeeded");
+
+        return FALSE;
+    }
+
+    g_clear_error (error);
+
+    return TRUE;
+}
+
 static void
 uca_net_camera_get_property (GObject *object,
                              guint property_id,
@@ -442,6 +944,53 @@ uca_net_camera_get_property (GObject *object,
         case PROP_PORT:
             g_value_set_uint (value, UCA_NET_DEFAULT_PORT);
             return;
+        case PROP_COMPRESSION:
+            g_value_set_boolean (value, priv->codec != UCA_NET_CODEC_NONE);
+            return;
+        case PROP_PACKING:
+            g_value_set_boolean (value, priv->pack);
+            return;
+        case PROP_NUM_STREAMS:
+            g_value_set_uint (value, priv->num_streams);
+            return;
+        case PROP_GRAB_LATEST:
+            g_value_set_boolean (value, priv->grab_latest);
+            return;
+        case PROP_TRIGGER_ROUND_TRIP:
+            g_value_set_double (value, priv->trigger_round_trip);
+            return;
+        case PROP_TRIGGER_DURATION:
+            g_value_set_double (value, priv->trigger_duration);
+            return;
+        case PROP_CAMERA_NAME:
+            g_value_set_string (value, priv->camera_name);
+            return;
+        case PROP_SERVER_STATS:
+            if (priv->client != NULL) {
+                gchar *stats = request_stats (priv, &error);
+
+                if (stats == NULL) {
+                    g_warning ("Could not get statistics: %s", error->message);
+                    g_error_free (error);
+                }
+
+                g_value_take_string (value, stats);
+            }
+            return;
+        case PROP_CLOCK_OFFSET:
+            if (priv->client != NULL) {
+                gint64 offset;
+
+                /* NaN rather than an offset of 0, which would look valid */
+                if (!request_clock_offset (priv, &offset, &error)) {
+                    g_warning ("Could not synchronize clocks: %s", error->message);
+                    g_error_free (error);
+                    g_value_set_double (value, NAN);
+                }
+                else
+                    g_value_set_double (value, offset / (gdouble) G_USEC_PER_SEC);
+            }
+            return;
     }
 
     if (priv->client == NULL) {
@@ -477,6 +1026,7 @@ uca_net_camera_dispose (GObject *object)
         }
     }
 
+    g_clear_object (&priv->trigger_connection);
     g_clear_object (&priv->client);
     G_OBJECT_CLASS (uca_net_camera_parent_class)->dispose (object);
 }
@@ -490,6 +1040,10 @@ uca_net_camera_finalize (GObject *object)
     g_clear_error (&priv->construct_error);
 
     g_free (priv->host);
+    g_free (priv->camera_name);
+    g_free (priv->compressed);
+    g_free (priv->scratch);
+    g_free (priv->packed);
 
     G_OBJECT_CLASS (uca_net_camera_parent_class)->finalize (object);
 }
@@ -623,6 +1177,9 @@ uca_net_camera_constructed (GObject *object)
     env = g_getenv ("UCA_NET_HOST");
     priv->host = env != NULL ? g_strdup (env) : g_strdup ("localhost");
 
+    if (priv->camera_name == NULL)
+        priv->camera_name = g_strdup (g_getenv ("UCA_NET_CAMERA"));
+
     connection = connect_socket (priv, &priv->construct_error);
 
     if (connection != NULL) {
@@ -676,6 +1233,69 @@ uca_net_camera_class_init (UcaNetCameraClass *klass)
             1, G_MAXUINT, UCA_NET_DEFAULT_PORT,
             G_PARAM_READABLE);
 
+    net_properties[PROP_COMPRESSION] =
+        g_param_spec_boolean ("compression",
+            "Compress frames on the wire",
+            "Compress frames on the wire",
+            FALSE,
+            G_PARAM_READWRITE);
+
+    net_properties[PROP_PACKING] =
+        g_param_spec_boolean ("packing",
+            "Transfer 10 and 12 bit pixels packed",
+            "Transfer 10 and 12 bit pixels packed",
+            FALSE,
+            G_PARAM_READWRITE);
+
+    net_properties[PROP_NUM_STREAMS] =
+        g_param_spec_uint ("num-streams",
+            "Number of connections a grabbed frame is striped across",
+            "Number of connections a grabbed frame is striped across",
+            1, UCA_NET_MAX_STREAMS, 1,
+            G_PARAM_READWRITE);
+
+    net_properties[PROP_GRAB_LATEST] =
+        g_param_spec_boolean ("grab-latest",
+            "Grab the most recent frame instead of the next one",
+            "Grab the most recent frame instead of the next one if ucad acquires continuously",
+            FALSE,
+            G_PARAM_READWRITE);
+
+    net_properties[PROP_TRIGGER_ROUND_TRIP] =
+        g_param_spec_double ("trigger-round-trip",
+            "Seconds until the last trigger was acknowledged",
+            "Seconds from sending the last software trigger until its acknowledgement arrived",
+            0.0, G_MAXDOUBLE, 0.0,
+            G_PARAM_READABLE);
+
+    net_properties[PROP_TRIGGER_DURATION] =
+        g_param_spec_double ("trigger-duration",
+            "Seconds ucad spent on the last trigger",
+            "Seconds between issuing the last software trigger in ucad and the camera accepting it",
+            0.0, G_MAXDOUBLE, 0.0,
+            G_PARAM_READABLE);
+
+    net_properties[PROP_CAMERA_NAME] =
+        g_param_spec_string ("camera-name",
+            "Name of the camera served by ucad",
+            "Name of the camera served by ucad, the default one if not set",
+            NULL,
+            G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+    net_properties[PROP_SERVER_STATS] =
+        g_param_spec_string ("server-stats",
+            "Metrics of ucad",
+            "Counters and latency histograms of all cameras served by ucad in the Prometheus text format",
+            NULL,
+            G_PARAM_READABLE);
+
+    net_properties[PROP_CLOCK_OFFSET] =
+        g_param_spec_double ("clock-offset",
+            "Seconds the monotonic clock of ucad is ahead",
+            "Seconds the monotonic clock of ucad, which frame timestamps are taken from, is ahead of ours, NaN if unknown",
+            -G_MAXDOUBLE, G_MAXDOUBLE, 0.0,
+            G_PARAM_READABLE);
+
     for (guint i = PROP_0 + 1; i < N_BASE_PROPERTIES; i++)
         g_object_class_override_property (oclass, i, uca_camera_props[i]);
 
@@ -693,9 +1313,26 @@ uca_net_camera_init (UcaNetCamera *self)
     self->priv = priv = UCA_NET_CAMERA_GET_PRIVATE (self);
 
     priv->host = NULL;
+    priv->camera_name = NULL;
     priv->construct_error = NULL;
     priv->client = g_socket_client_new ();
     priv->size = 0;
+    priv->codec = UCA_NET_CODEC_NONE;
+    priv->compressed = NULL;
+    priv->compressed_size = 0;
+    priv->scratch = NULL;
+    priv->pack = FALSE;
+    priv->packed = NULL;
+    priv->packed_size = 0;
+    priv->num_streams = 1;
+    priv->grab_latest = FALSE;
+    priv->next_sequence = 0;
+    priv->trigger_connection = NULL;
+    priv->timed_triggers = FALSE;
+    priv->plain_triggers = FALSE;
+    priv->trigger_id = 0;
+    priv->trigger_round_trip = 0.0;
+    priv->trigger_duration = 0.0;
 }
 
 G_MODULE_EXPORT GType
@@ -0,0 +1,226 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#include <string.h>
+#include <gio/gio.h>
+#include "uca-net-codec.h"
+#include "config.h"
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#define BLOCK_BOUND (LZ4_COMPRESSBOUND (UCA_NET_CODEC_BLOCK_SIZE))
+#else
+#define BLOCK_BOUND (UCA_NET_CODEC_BLOCK_SIZE)
+#endif
+
+gboolean
+uca_net_codec_is_available (UcaNetCodec codec)
+{
+#ifdef HAVE_LZ4
+    return codec == UCA_NET_CODEC_NONE || codec == UCA_NET_CODEC_SHUFFLE_LZ4;
+#else
+    return codec == UCA_NET_CODEC_NONE;
+#endif
+}
+
+const gchar *
+uca_net_codec_get_name (UcaNetCodec codec)
+{
+    return codec == UCA_NET_CODEC_SHUFFLE_LZ4 ? "shuffle-lz4" : "none";
+}
+
+guint
+uca_net_codec_get_num_blocks (gsize size)
+{
+    return (guint) ((size + UCA_NET_CODEC_BLOCK_SIZE - 1) / UCA_NET_CODEC_BLOCK_SIZE);
+}
+
+static gsize
+get_table_size (guint num_blocks)
+{
+    return sizeof (UcaNetCodecHeader) + num_blocks * sizeof (guint32);
+}
+
+/**
+ * Return the number of bytes the destination of uca_net_codec_compress() and
+ * uca_net_codec_compress_block() must provide for size input bytes.
+ */
+gsize
+uca_net_codec_get_bound (gsize size)
+{
+    guint num_blocks = uca_net_codec_get_num_blocks (size);
+
+    return get_table_size (num_blocks) + (gsize) num_blocks * BLOCK_BOUND;
+}
+
+static void
+shuffle (const guint8 *restrict src, guint8 *restrict dst, gsize size, guint pixel_size)
+{
+    gsize n = size / pixel_size;
+
+    for (guint b = 0; b < pixel_size; b++) {
+        for (gsize i = 0; i < n; i++)
+            dst[b * n + i] = src[i * pixel_size + b];
+    }
+
+    /* Trailing bytes which do not make up a whole pixel */
+    memcpy (dst + n * pixel_size, src + n * pixel_size, size - n * pixel_size);
+}
+
+static void
+unshuffle (const guint8 *restrict src, guint8 *restrict dst, gsize size, guint pixel_size)
+{
+    gsize n = size / pixel_size;
+
+    for (guint b = 0; b < pixel_size; b++) {
+        for (gsize i = 0; i < n; i++)
+            dst[i * pixel_size + b] = src[b * n + i];
+    }
+
+    memcpy (dst + n * pixel_size, src + n * pixel_size, size - n * pixel_size);
+}
+
+/**
+ * Compress one block of src into its staging slot in dst and record its size.
+ * scratch must be as large as src. Different blocks may be compressed
+ * concurrently, uca_net_codec_finish() must be called afterwards.
+ */
+void
+uca_net_codec_compress_block (const gchar *src, gsize size, guint pixel_size, guint block,
+                              gchar *dst, gchar *scratch)
+{
+    guint32 *sizes = (guint32 *) (dst + sizeof (UcaNetCodecHeader));
+    gsize offset = (gsize) block * UCA_NET_CODEC_BLOCK_SIZE;
+    gsize block_size = MIN (UCA_NET_CODEC_BLOCK_SIZE, size - offset);
+    gchar *slot = dst + get_table_size (uca_net_codec_get_num_blocks (size)) + (gsize) block * BLOCK_BOUND;
+    gint compressed = 0;
+
+#ifdef HAVE_LZ4
+    const gchar *input = src + offset;
+
+    if (pixel_size > 1) {
+        shuffle ((const guint8 *) src + offset, (guint8 *) scratch + offset, block_size, pixel_size);
+        input = scratch + offset;
+    }
+
+    compressed = LZ4_compress_default (input, slot, (gint) block_size, BLOCK_BOUND);
+#endif
+
+    if (compressed <= 0 || (gsize) compressed >= block_size) {
+        memcpy (slot, src + offset, block_size);
+        compressed = (gint) block_size;
+    }
+
+    sizes[block] = (guint32) compressed;
+}
+
+/**
+ * Write the header and move the compressed blocks next to each other. Returns
+ * the total compressed size.
+ */
+gsize
+uca_net_codec_finish (gchar *dst, gsize size, guint pixel_size)
+{
+    UcaNetCodecHeader *header = (UcaNetCodecHeader *) dst;
+    guint32 *sizes = (guint32 *) (dst + sizeof (UcaNetCodecHeader));
+    guint num_blocks = uca_net_codec_get_num_blocks (size);
+    gsize table_size = get_table_size (num_blocks);
+    gsize offset = table_size;
+
+    header->num_blocks = num_blocks;
+    header->block_size = UCA_NET_CODEC_BLOCK_SIZE;
+    header->pixel_size = pixel_size;
+    header->reserved = 0;
+
+    /* Slots are never before their final position, so moving in order is safe */
+    for (guint i = 0; i < num_blocks; i++) {
+        memmove (dst + offset, dst + table_size + (gsize) i * BLOCK_BOUND, sizes[i]);
+        offset += sizes[i];
+    }
+
+    return offset;
+}
+
+gsize
+uca_net_codec_compress (const gchar *src, gsize size, guint pixel_size, gchar *dst, gchar *scratch)
+{
+    guint num_blocks = uca_net_codec_get_num_blocks (size);
+
+    for (guint i = 0; i < num_blocks; i++)
+        uca_net_codec_compress_block (src, size, pixel_size, i, dst, scratch);
+
+    return uca_net_codec_finish (dst, size, pixel_size);
+}
+
+/**
+ * Decompress src into dst which must hold exactly dst_size bytes. scratch must
+ * provide UCA_NET_CODEC_BLOCK_SIZE bytes.
+ */
+gboolean
+uca_net_codec_decompress (const gchar *src, gsize src_size, gchar *dst, gsize dst_size,
+                          gchar *scratch, GError **error)
+{
+    const UcaNetCodecHeader *header = (const UcaNetCodecHeader *) src;
+    const guint32 *sizes;
+    gsize in_offset, out_offset = 0;
+
+    if (src_size < sizeof (UcaNetCodecHeader) ||
+        header->num_blocks != uca_net_codec_get_num_blocks (dst_size) ||
+        header->block_size != UCA_NET_CODEC_BLOCK_SIZE ||
+        src_size < get_table_size (header->num_blocks)) {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                             "Compressed frame does not match expected frame size");
+        return FALSE;
+    }
+
+    sizes = (const guint32 *) (src + sizeof (UcaNetCodecHeader));
+    in_offset = get_table_size (header->num_blocks);
+
+    for (guint i = 0; i < header->num_blocks; i++) {
+        gsize block_size = MIN (UCA_NET_CODEC_BLOCK_SIZE, dst_size - out_offset);
+
+        if (in_offset + sizes[i] > src_size)
+            goto corrupted;
+
+        if (sizes[i] == block_size) {
+            memcpy (dst + out_offset, src + in_offset, block_size);
+        }
+        else {
+#ifdef HAVE_LZ4
+            gchar *output = header->pixel_size > 1 ? scratch : dst + out_offset;
+
+            if (LZ4_decompress_safe (src + in_offset, output, (gint) sizes[i], (gint) block_size) != (gint) block_size)
+                goto corrupted;
+
+            if (header->pixel_size > 1)
+                unshuffle ((const guint8 *) scratch, (guint8 *) dst + out_offset, block_size, header->pixel_size);
+#else
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                 "Compiled without LZ4 support");
+            return FALSE;
+#endif
+        }
+
+        in_offset += sizes[i];
+        out_offset += block_size;
+    }
+
+    return TRUE;
+
+corrupted:
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Compressed frame is corrupted");
+    return FALSE;
+}
@@ -0,0 +1,70 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#ifndef UCA_NET_CODEC_H
+#define UCA_NET_CODEC_H
+
+#include <glib.h>
+
+/*
+ * Compressed frames are split into blocks of UCA_NET_CODEC_BLOCK_SIZE bytes
+ * which are byte-shuffled and compressed independently, so that they can be
+ * processed in parallel. A compressed frame is laid out as
+ *
+ *   UcaNetCodecHeader | guint32 compressed block sizes[num_blocks] | blocks
+ *
+ * A block whose compressed size equals its uncompressed size is stored as is.
+ */
+#define UCA_NET_CODEC_BLOCK_SIZE    (1 << 20)
+
+typedef enum {
+    UCA_NET_CODEC_NONE = 0,
+    UCA_NET_CODEC_SHUFFLE_LZ4,
+} UcaNetCodec;
+
+typedef struct {
+    guint32 num_blocks;
+    guint32 block_size;
+    guint32 pixel_size;
+    guint32 reserved;
+} UcaNetCodecHeader;
+
+gboolean    uca_net_codec_is_available      (UcaNetCodec codec);
+const gchar *uca_net_codec_get_name         (UcaNetCodec codec);
+guint       uca_net_codec_get_num_blocks    (gsize size);
+gsize       uca_net_codec_get_bound         (gsize size);
+void        uca_net_codec_compress_block    (const gchar *src,
+                                             gsize size,
+                                             guint pixel_size,
+                                             guint block,
+                                             gchar *dst,
+                                             gchar *scratch);
+gsize       uca_net_codec_finish            (gchar *dst,
+                                             gsize size,
+                                             guint pixel_size);
+gsize       uca_net_codec_compress          (const gchar *src,
+                                             gsize size,
+                                             guint pixel_size,
+                                             gchar *dst,
+                                             gchar *scratch);
+gboolean    uca_net_codec_decompress        (const gchar *src,
+                                             gsize src_size,
+                                             gchar *dst,
+                                             gsize dst_size,
+                                             gchar *scratch,
+                                             GError **error);
+
+#endif
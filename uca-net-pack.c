@@ -0,0 +1,161 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#include <string.h>
+#include "uca-net-pack.h"
+
+gboolean
+uca_net_pack_is_supported (guint bits)
+{
+    return bits == 10 || bits == 12;
+}
+
+/**
+ * Return the number of pixels that pack into a whole number of bytes. Packing
+ * and unpacking can be split at multiples of it.
+ */
+guint
+uca_net_pack_get_group_size (guint bits)
+{
+    return bits == 10 ? 4 : 2;
+}
+
+gsize
+uca_net_pack_get_size (gsize num_pixels, guint bits)
+{
+    return (num_pixels * bits + 7) / 8;
+}
+
+/* Loops over whole groups are kept free of branches to be vectorized */
+static void
+pack_12 (const guint16 *restrict src, guint8 *restrict dst, gsize num_groups)
+{
+    for (gsize i = 0; i < num_groups; i++) {
+        guint p0 = src[2 * i] & 0xfff;
+        guint p1 = src[2 * i + 1] & 0xfff;
+
+        dst[3 * i] = p0 & 0xff;
+        dst[3 * i + 1] = (p0 >> 8) | ((p1 & 0xf) << 4);
+        dst[3 * i + 2] = p1 >> 4;
+    }
+}
+
+static void
+unpack_12 (const guint8 *restrict src, guint16 *restrict dst, gsize num_groups)
+{
+    for (gsize i = 0; i < num_groups; i++) {
+        guint b0 = src[3 * i];
+        guint b1 = src[3 * i + 1];
+        guint b2 = src[3 * i + 2];
+
+        dst[2 * i] = b0 | ((b1 & 0xf) << 8);
+        dst[2 * i + 1] = (b1 >> 4) | (b2 << 4);
+    }
+}
+
+static void
+pack_10 (const guint16 *restrict src, guint8 *restrict dst, gsize num_groups)
+{
+    for (gsize i = 0; i < num_groups; i++) {
+        guint64 v = ((guint64) (src[4 * i] & 0x3ff)) |
+                    ((guint64) (src[4 * i + 1] & 0x3ff) << 10) |
+                    ((guint64) (src[4 * i + 2] & 0x3ff) << 20) |
+                    ((guint64) (src[4 * i + 3] & 0x3ff) << 30);
+
+        dst[5 * i] = v & 0xff;
+        dst[5 * i + 1] = (v >> 8) & 0xff;
+        dst[5 * i + 2] = (v >> 16) & 0xff;
+        dst[5 * i + 3] = (v >> 24) & 0xff;
+        dst[5 * i + 4] = (v >> 32) & 0xff;
+    }
+}
+
+static void
+unpack_10 (const guint8 *restrict src, guint16 *restrict dst, gsize num_groups)
+{
+    for (gsize i = 0; i < num_groups; i++) {
+        guint64 v = ((guint64) src[5 * i]) |
+                    ((guint64) src[5 * i + 1] << 8) |
+                    ((guint64) src[5 * i + 2] << 16) |
+                    ((guint64) src[5 * i + 3] << 24) |
+                    ((guint64) src[5 * i + 4] << 32);
+
+        dst[4 * i] = v & 0x3ff;
+        dst[4 * i + 1] = (v >> 10) & 0x3ff;
+        dst[4 * i + 2] = (v >> 20) & 0x3ff;
+        dst[4 * i + 3] = (v >> 30) & 0x3ff;
+    }
+}
+
+static void
+pack_groups (const guint16 *src, guint8 *dst, gsize num_groups, guint bits)
+{
+    if (bits == 10)
+        pack_10 (src, dst, num_groups);
+    else
+        pack_12 (src, dst, num_groups);
+}
+
+static void
+unpack_groups (const guint8 *src, guint16 *dst, gsize num_groups, guint bits)
+{
+    if (bits == 10)
+        unpack_10 (src, dst, num_groups);
+    else
+        unpack_12 (src, dst, num_groups);
+}
+
+/**
+ * Pack num_pixels pixels of src into uca_net_pack_get_size() bytes of dst.
+ * Pixel values are truncated to bits.
+ */
+void
+uca_net_pack (const guint16 *src, guint8 *dst, gsize num_pixels, guint bits)
+{
+    guint group = uca_net_pack_get_group_size (bits);
+    gsize num_groups = num_pixels / group;
+    gsize remaining = num_pixels - num_groups * group;
+
+    pack_groups (src, dst, num_groups, bits);
+
+    if (remaining > 0) {
+        guint16 tail[4] = { 0, };
+        guint8 packed[5];
+
+        memcpy (tail, src + num_groups * group, remaining * sizeof (guint16));
+        pack_groups (tail, packed, 1, bits);
+        memcpy (dst + num_groups * group * bits / 8, packed, uca_net_pack_get_size (remaining, bits));
+    }
+}
+
+void
+uca_net_unpack (const guint8 *src, guint16 *dst, gsize num_pixels, guint bits)
+{
+    guint group = uca_net_pack_get_group_size (bits);
+    gsize num_groups = num_pixels / group;
+    gsize remaining = num_pixels - num_groups * group;
+
+    unpack_groups (src, dst, num_groups, bits);
+
+    if (remaining > 0) {
+        guint16 tail[4];
+        guint8 packed[5] = { 0, };
+
+        memcpy (packed, src + num_groups * group * bits / 8, uca_net_pack_get_size (remaining, bits));
+        unpack_groups (packed, tail, 1, bits);
+        memcpy (dst + num_groups * group, tail, remaining * sizeof (guint16));
+    }
+}
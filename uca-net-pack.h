@@ -0,0 +1,42 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#ifndef UCA_NET_PACK_H
+#define UCA_NET_PACK_H
+
+#include <glib.h>
+
+/*
+ * Packed pixels form a little-endian bit stream in which pixel i occupies the
+ * bits [i * bits, (i + 1) * bits). 12 bit pixels are thus stored as pairs in
+ * three bytes and 10 bit pixels as groups of four in five bytes. A last
+ * incomplete group is padded with zero bits to the next byte.
+ */
+
+gboolean    uca_net_pack_is_supported   (guint bits);
+guint       uca_net_pack_get_group_size (guint bits);
+gsize       uca_net_pack_get_size       (gsize num_pixels,
+                                         guint bits);
+void        uca_net_pack                (const guint16 *src,
+                                         guint8 *dst,
+                                         gsize num_pixels,
+                                         guint bits);
+void        uca_net_unpack              (const guint8 *src,
+                                         guint16 *dst,
+                                         gsize num_pixels,
+                                         guint bits);
+
+#endif
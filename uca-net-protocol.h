@@ -2,9 +2,11 @@
 #define PROTOCOL_H
 
 #include <gio/gio.h>
+#include "uca-net-codec.h"
 
 #define UCA_NET_MAX_ENUM_LENGTH         32
 #define UCA_NET_MAX_ENUM_NAME_LENGTH    128
+#define UCA_NET_MAX_STREAMS             16
 
 typedef enum {
     UCA_NET_MESSAGE_INVALID = 0,
@@ -23,8 +25,68 @@ typedef enum {
     UCA_NET_MESSAGE_ZMQ_REMOVE_ENDPOINT,
     UCA_NET_MESSAGE_ZMQ_REMOVE_ALL_ENDPOINTS,
     UCA_NET_MESSAGE_WRITE,
+    UCA_NET_MESSAGE_SET_REFERENCE,
+    UCA_NET_MESSAGE_ACQUIRE_REFERENCE,
+    UCA_NET_MESSAGE_GRAB_STRIPE,
+    UCA_NET_MESSAGE_READ_HISTORY,
+    UCA_NET_MESSAGE_QUEUE_PROPERTY,
+    UCA_NET_MESSAGE_TIMED_TRIGGER,
+    UCA_NET_MESSAGE_SELECT_CAMERA,
+    UCA_NET_MESSAGE_GET_STATS,
+    UCA_NET_MESSAGE_CLOCK_SYNC,
 } UcaNetMessageType;
 
+/*
+ * Set in the type of a request that grew since the first version of this
+ * protocol to announce that it is sent with all fields of its current
+ * structure. Without it, the request is taken as the original structure, with
+ * all later fields zero, and answered with the original reply.
+ */
+#define UCA_NET_MESSAGE_EXTENDED        0x10000
+#define UCA_NET_MESSAGE_GET_TYPE(type)  ((UcaNetMessageType) ((type) & ~UCA_NET_MESSAGE_EXTENDED))
+
+/* Frame a consumer reads while ucad acquires continuously */
+typedef enum {
+    UCA_NET_POSITION_NEXT = 0,  /* Frame following the previously read one */
+    UCA_NET_POSITION_LATEST,    /* Most recent frame */
+} UcaNetPosition;
+
+typedef enum {
+    UCA_NET_HISTORY_TCP = 0,    /* Frames follow the reply */
+    UCA_NET_HISTORY_ZMQ,        /* Frames are sent to all ZMQ endpoints */
+    UCA_NET_HISTORY_RELEASE,    /* Only resume overwriting a frozen history */
+} UcaNetHistoryTarget;
+
+typedef enum {
+    UCA_NET_DTYPE_NATIVE = 0,   /* Send frames as they come from the camera */
+    UCA_NET_DTYPE_UINT8,
+    UCA_NET_DTYPE_UINT16,
+    UCA_NET_DTYPE_FLOAT32,
+    UCA_NET_DTYPE_UINT32,
+} UcaNetDtype;
+
+typedef enum {
+    UCA_NET_WINDOW_FULL_RANGE = 0,  /* Map [0, 2^sensor-bitdepth - 1] */
+    UCA_NET_WINDOW_MANUAL,          /* Map [window_min, window_max] */
+    UCA_NET_WINDOW_AUTO,            /* Follow the running frame minimum and maximum */
+} UcaNetWindow;
+
+typedef enum {
+    UCA_NET_ENDPOINT_FRAMES = 0,        /* Send full frames */
+    UCA_NET_ENDPOINT_PROJECTIONS,       /* Send row sums followed by column sums as float64 */
+    UCA_NET_ENDPOINT_TILES,             /* Send tiles which changed since the last key frame */
+} UcaNetEndpointMode;
+
+typedef enum {
+    UCA_NET_ACCUMULATE_SUM = 0,     /* Send the uint32 sum of the grabbed frames */
+    UCA_NET_ACCUMULATE_AVERAGE,     /* Send the float32 average of the grabbed frames */
+} UcaNetAccumulation;
+
+typedef enum {
+    UCA_NET_REFERENCE_DARK = 0,
+    UCA_NET_REFERENCE_FLAT,
+} UcaNetReference;
+
 typedef struct {
     gboolean occurred;
     gchar domain[64];
@@ -57,22 +119,201 @@ typedef struct {
     gchar property_value[128];
 } UcaNetMessageSetPropertyRequest;
 
+/* Addresses all following requests of a connection to the named camera of a
+ * ucad serving several, instead of the first one */
+typedef struct {
+    UcaNetMessageType type;
+    gchar name[128];
+} UcaNetMessageSelectCameraRequest;
+
+/* Followed by size bytes of metrics of all cameras in the Prometheus text
+ * format, requested with a UcaNetMessageDefault */
+typedef struct {
+    UcaNetMessageType type;
+    UcaNetErrorReply error;
+    gsize size;
+} UcaNetMessageGetStatsReply;
+
+/*
+ * Relates a clock of the client to the monotonic clock of ucad, which frame
+ * timestamps are taken from. With t0 and t1 taken by the client before
+ * sending and after receiving the reply, the ucad clock is ahead by about
+ * monotonic - (t0 + t1) / 2, with an error of at most half the round trip.
+ */
+typedef struct {
+    UcaNetMessageType type;
+    gint64 client_time; /* Returned in the reply */
+} UcaNetMessageClockSyncRequest;
+
+/* Times in microseconds */
+typedef struct {
+    UcaNetMessageType type;
+    UcaNetErrorReply error;
+    gint64 client_time;
+    gint64 monotonic;
+    gint64 real; /* Wall clock at the same time */
+} UcaNetMessageClockSyncReply;
+
+/* Sets a property between two frames of a running push, or right away */
+typedef struct {
+    UcaNetMessageType type;
+    gchar property_name[128];
+    gchar property_value[128];
+} UcaNetMessageQueuePropertyRequest;
+
+typedef struct {
+    UcaNetMessageType type;
+    UcaNetErrorReply error;
+    guint64 generation; /* "config-generation" of the first frame with the new value */
+} UcaNetMessageQueuePropertyReply;
+
+/* Software trigger meant for a persistent connection */
+typedef struct {
+    UcaNetMessageType type;
+    guint64 id; /* Returned in the reply */
+    gboolean grab; /* Grab the triggered frame, followed by a grab reply and the frame */
+    gsize size; /* Frame size if grab is set */
+} UcaNetMessageTimedTriggerRequest;
+
+/* Times are taken from the monotonic clock of ucad in microseconds */
+typedef struct {
+    UcaNetMessageType type;
+    UcaNetErrorReply error;
+    guint64 id;
+    gint64 issued; /* Before the camera was triggered */
+    gint64 completed; /* After the camera accepted the trigger */
+} UcaNetMessageTimedTriggerReply;
+
+/* Original grab request, answered with a UcaNetDefaultReply and the frame */
 typedef struct {
     UcaNetMessageType type;
     gsize size;
+} UcaNetMessageOriginalGrabRequest;
+
+/* Answered with a UcaNetMessageGrabReply if sent with UCA_NET_MESSAGE_EXTENDED */
+typedef struct {
+    UcaNetMessageType type;
+    gsize size;
+    UcaNetCodec codec; /* Codec the client accepts for the frame data */
+    gboolean pack; /* Client accepts packed 10 and 12 bit pixels */
+    guint num_streams; /* Connections the frame data is striped across (0, 1: this one) */
+    guint32 token; /* Identifies the GRAB_STRIPE connections of this request */
+    UcaNetPosition position; /* Frame read during continuous acquisition */
+    guint64 sequence; /* Next frame for UCA_NET_POSITION_NEXT (0: next acquired one) */
 } UcaNetMessageGrabRequest;
 
+/*
+ * Opens the additional connection index (1 <= index < num_streams) of a
+ * striped grab. The connection receives bytes [index * size / num_streams,
+ * (index + 1) * size / num_streams) of the frame data announced in the grab
+ * reply, the grab connection itself the first range.
+ */
+typedef struct {
+    UcaNetMessageType type;
+    guint32 token;
+    guint index;
+} UcaNetMessageGrabStripeRequest;
+
+/* Followed by size bytes of frame data encoded with codec, starts like a
+ * UcaNetDefaultReply */
+typedef struct {
+    UcaNetMessageType type;
+    UcaNetErrorReply error;
+    UcaNetCodec codec;
+    gsize size;
+    guint packed_bits; /* Bits per packed pixel (0: not packed) */
+    guint64 sequence; /* Acquisition sequence of the frame (0: grabbed on request) */
+    guint64 dropped; /* Frames skipped since the requested sequence */
+} UcaNetMessageGrabReply;
+
+/* Original push request, answered with a UcaNetDefaultReply */
 typedef struct {
     UcaNetMessageType type;
     gint64 num_frames;
     gboolean end; /* Send poison pill at the end */
+} UcaNetMessageOriginalPushRequest;
+
+/* Answered with a UcaNetMessagePushReply if sent with UCA_NET_MESSAGE_EXTENDED */
+typedef struct {
+    UcaNetMessageType type;
+    gint64 num_frames;
+    gboolean end; /* Send poison pill at the end */
+    guint accumulate; /* Number of grabbed frames combined into one sent frame (0, 1: off) */
+    UcaNetAccumulation accumulate_mode;
+    UcaNetPosition position; /* Frames pushed during continuous acquisition */
+    gboolean burst; /* Capture all frames into memory at camera speed before sending them */
+    gboolean drain_during_capture; /* Start sending burst frames while still capturing */
 } UcaNetMessagePushRequest;
 
+typedef struct {
+    UcaNetMessageType type;
+    UcaNetErrorReply error;
+    guint64 num_captured; /* Frames captured by a burst */
+    gdouble capture_rate; /* Frames per second captured by a burst */
+    gdouble drain_time; /* Seconds spent sending the frames */
+    guint max_queue_depth; /* Most frames queued for a single endpoint */
+    guint64 num_spilled; /* Frames spilled to disk for slow endpoints */
+    guint64 spilled_bytes;
+} UcaNetMessagePushReply;
+
+/*
+ * Freezes the frame history of the continuous acquisition, so that no frame in
+ * it is overwritten, and sends a range of it. While frozen, no new frames are
+ * acquired and reading them from the acquisition fails.
+ */
+typedef struct {
+    UcaNetMessageType type;
+    gint64 first; /* Sequence of the first frame (< 0: relative to the newest one, -1; 0: oldest) */
+    guint64 count; /* Number of frames (0: up to the newest) */
+    UcaNetHistoryTarget target;
+    gboolean release; /* Resume overwriting the history afterwards */
+    gboolean end; /* Send poison pill to ZMQ endpoints at the end */
+} UcaNetMessageReadHistoryRequest;
+
+/* Followed by count frames of frame_size bytes for UCA_NET_HISTORY_TCP */
+typedef struct {
+    UcaNetMessageType type;
+    UcaNetErrorReply error;
+    guint64 first;
+    guint64 count;
+    gsize frame_size;
+} UcaNetMessageReadHistoryReply;
+
+/* Original endpoint request */
+typedef struct {
+    UcaNetMessageType type;
+    gchar endpoint[128];
+    gint socket_type;
+    gint sndhwm; /* High water mark for outbound messages (-1: do not set) */
+} UcaNetMessageOriginalAddZmqEndpointRequest;
+
+/* Must be sent with UCA_NET_MESSAGE_EXTENDED */
 typedef struct {
     UcaNetMessageType type;
     gchar endpoint[128];
     gint socket_type;
     gint sndhwm; /* High water mark for outbound messages (-1: do not set) */
+    UcaNetDtype dtype; /* Data type sent to this endpoint */
+    UcaNetWindow window; /* Intensity window used when reducing the bit depth */
+    gdouble window_min;
+    gdouble window_max;
+    gdouble gamma; /* Exponent applied to the windowed intensity (<= 0: linear) */
+    gboolean flat_correct; /* Send (raw - dark) / (flat - dark) as float32 or uint16 */
+    gdouble flat_scale; /* Scale of corrected uint16 frames (<= 0: 2^14) */
+    UcaNetEndpointMode mode;
+    guint roi_x; /* Region used for projections (0 width or height: whole frame) */
+    guint roi_y;
+    guint roi_width;
+    guint roi_height;
+    guint tile_size; /* Edge length of tiles (0: 64) */
+    gdouble tile_threshold; /* Maximum absolute difference of unchanged tiles (0: lossless) */
+    guint keyframe_interval; /* Frames between two full key frames (0: 100) */
+    UcaNetCodec codec; /* Compression of the frame data */
+    gboolean pack; /* Pack unconverted 10 and 12 bit frames */
+    guint queue_depth; /* Frames queued in memory for a slow endpoint (0: send in lockstep) */
+    gchar spill_directory[128]; /* Spill frames beyond queue_depth into this directory below the server's --data-directory (empty: wait) */
+    guint64 max_file_size; /* Rotate the data files of a file:// endpoint at this size (0: never) */
+    gboolean timing; /* Add monotonic latency timestamps of ucad to the frame headers */
 } UcaNetMessageAddZmqEndpointRequest;
 
 typedef struct {
@@ -86,6 +327,22 @@ typedef struct {
     gchar name[128];
 } UcaNetMessageWriteRequest;
 
+/* Followed by size bytes of reference data */
+typedef struct {
+    UcaNetMessageType type;
+    UcaNetReference reference;
+    UcaNetDtype dtype; /* uint8, uint16 or float32 */
+    guint width;
+    guint height;
+    gsize size;
+} UcaNetMessageSetReferenceRequest;
+
+typedef struct {
+    UcaNetMessageType type;
+    UcaNetReference reference;
+    guint num_frames; /* Number of frames averaged into the reference */
+} UcaNetMessageAcquireReferenceRequest;
+
 typedef struct {
     UcaNetMessageType type;
     guint num_properties;
@@ -0,0 +1,272 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdlib.h>
+#include <gio/gio.h>
+#include "ucad-affinity.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct _UcadAffinity {
+#ifdef __linux__
+    cpu_set_t cpus;
+#endif
+    gchar *description;
+};
+
+struct _UcadAffinityState {
+#ifdef __linux__
+    cpu_set_t cpus;
+    gint policy;
+    struct sched_param param;
+#endif
+    gboolean pinned;
+    gboolean scheduled;
+};
+
+/**
+ * Parse a CPU list as used by the kernel and taskset, e.g. "0-3,8,10-11".
+ */
+UcadAffinity *
+ucad_affinity_new_from_list (const gchar *list, GError **error)
+{
+#ifdef __linux__
+    UcadAffinity *affinity;
+    gchar **ranges;
+
+    affinity = g_new0 (UcadAffinity, 1);
+    affinity->description = g_strstrip (g_strdup (list));
+    CPU_ZERO (&affinity->cpus);
+    ranges = g_strsplit (affinity->description, ",", -1);
+
+    for (guint i = 0; ranges[i] != NULL; i++) {
+        gchar *end;
+        guint64 first, last;
+
+        first = last = g_ascii_strtoull (ranges[i], &end, 10);
+
+        if (end != ranges[i] && *end == '-')
+            last = g_ascii_strtoull (end + 1, &end, 10);
+
+        if (end == ranges[i] || *end != '\0' || last < first || last >= CPU_SETSIZE) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                         "Invalid CPU list `%s'", list);
+            g_strfreev (ranges);
+            ucad_affinity_free (affinity);
+            return NULL;
+        }
+
+        for (guint64 cpu = first; cpu <= last; cpu++)
+            CPU_SET (cpu, &affinity->cpus);
+    }
+
+    g_strfreev (ranges);
+    return affinity;
+#else
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                         "CPU affinity is not supported on this platform");
+    return NULL;
+#endif
+}
+
+/**
+ * Use the CPUs of NUMA node as listed by sysfs, which does not need libnuma.
+ */
+UcadAffinity *
+ucad_affinity_new_for_node (guint node, GError **error)
+{
+    UcadAffinity *affinity;
+    gchar *path;
+    gchar *list;
+
+    path = g_strdup_printf ("/sys/devices/system/node/node%u/cpulist", node);
+
+    if (!g_file_get_contents (path, &list, NULL, NULL)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No NUMA node %u", node);
+        g_free (path);
+        return NULL;
+    }
+
+    affinity = ucad_affinity_new_from_list (list, error);
+    g_free (path);
+    g_free (list);
+
+    if (affinity != NULL) {
+        gchar *description = g_strdup_printf ("node %u (%s)", node, affinity->description);
+
+        g_free (affinity->description);
+        affinity->description = description;
+    }
+
+    return affinity;
+}
+
+void
+ucad_affinity_free (UcadAffinity *affinity)
+{
+    if (affinity == NULL)
+        return;
+
+    g_free (affinity->description);
+    g_free (affinity);
+}
+
+const gchar *
+ucad_affinity_get_description (UcadAffinity *affinity)
+{
+    return affinity->description;
+}
+
+guint
+ucad_affinity_get_num_cpus (UcadAffinity *affinity)
+{
+#ifdef __linux__
+    return CPU_COUNT (&affinity->cpus);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Get the CPU at index, counting around the set so that any number of
+ * threads can be spread over it.
+ */
+gboolean
+ucad_affinity_get_cpu (UcadAffinity *affinity, guint index, guint *cpu)
+{
+#ifdef __linux__
+    guint num_cpus = CPU_COUNT (&affinity->cpus);
+
+    if (num_cpus == 0)
+        return FALSE;
+
+    index %= num_cpus;
+
+    for (guint i = 0; i < CPU_SETSIZE; i++) {
+        if (CPU_ISSET (i, &affinity->cpus) && index-- == 0) {
+            *cpu = i;
+            return TRUE;
+        }
+    }
+#endif
+    return FALSE;
+}
+
+/**
+ * Limit a SCHED_FIFO priority to the range of the system, 0 stays off.
+ */
+gint
+ucad_affinity_clamp_priority (gint priority)
+{
+#ifdef __linux__
+    if (priority <= 0)
+        return 0;
+
+    return CLAMP (priority, sched_get_priority_min (SCHED_FIFO), sched_get_priority_max (SCHED_FIFO));
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Restrict the calling thread to the CPUs of affinity, or only the CPU at
+ * index unless it is negative, and run it with SCHED_FIFO at priority if
+ * that is positive. Either may be left out with a NULL affinity or zero
+ * priority. Returns the previous state, or NULL if nothing could be changed.
+ */
+UcadAffinityState *
+ucad_affinity_pin_thread (UcadAffinity *affinity, gint index, gint priority, GError **error)
+{
+#ifdef __linux__
+    UcadAffinityState *state;
+    cpu_set_t cpus;
+    gint err;
+
+    state = g_new0 (UcadAffinityState, 1);
+
+    if (affinity != NULL) {
+        guint cpu;
+
+        if (index >= 0 && ucad_affinity_get_cpu (affinity, (guint) index, &cpu)) {
+            CPU_ZERO (&cpus);
+            CPU_SET (cpu, &cpus);
+        }
+        else {
+            cpus = affinity->cpus;
+        }
+
+        if (sched_getaffinity (0, sizeof (state->cpus), &state->cpus) < 0 ||
+            sched_setaffinity (0, sizeof (cpus), &cpus) < 0) {
+            g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                         "Could not pin thread to CPUs %s: %s", affinity->description, g_strerror (errno));
+            g_free (state);
+            return NULL;
+        }
+
+        state->pinned = TRUE;
+    }
+
+    if (priority > 0) {
+        struct sched_param param = { .sched_priority = ucad_affinity_clamp_priority (priority) };
+
+        pthread_getschedparam (pthread_self (), &state->policy, &state->param);
+        err = pthread_setschedparam (pthread_self (), SCHED_FIFO, &param);
+
+        if (err != 0) {
+            /* Usually needs CAP_SYS_NICE or an RLIMIT_RTPRIO */
+            g_set_error (error, G_IO_ERROR, g_io_error_from_errno (err),
+                         "Could not run thread with SCHED_FIFO priority %d: %s",
+                         param.sched_priority, g_strerror (err));
+            ucad_affinity_restore_thread (state);
+            return NULL;
+        }
+
+        state->scheduled = TRUE;
+    }
+
+    return state;
+#else
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                         "CPU affinity is not supported on this platform");
+    return NULL;
+#endif
+}
+
+/**
+ * Give the calling thread back the CPUs and scheduling it had before it was
+ * pinned and free state.
+ */
+void
+ucad_affinity_restore_thread (UcadAffinityState *state)
+{
+    if (state == NULL)
+        return;
+
+#ifdef __linux__
+    if (state->pinned)
+        sched_setaffinity (0, sizeof (state->cpus), &state->cpus);
+
+    if (state->scheduled)
+        pthread_setschedparam (pthread_self (), state->policy, &state->param);
+#endif
+
+    g_free (state);
+}
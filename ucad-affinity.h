@@ -0,0 +1,54 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#ifndef UCAD_AFFINITY_H
+#define UCAD_AFFINITY_H
+
+#include <glib.h>
+
+/*
+ * Set of CPUs which the threads of a camera are restricted to, either given
+ * as a list like "0-3,8" or taken from a NUMA node. Memory is allocated on
+ * the node of the thread that touches it first, so frames written by a
+ * pinned thread end up close to its frame grabber.
+ */
+typedef struct _UcadAffinity UcadAffinity;
+
+/*
+ * CPUs and scheduling of a thread before it was pinned. Threads borrowed
+ * from a pool must get them back before they return to it.
+ */
+typedef struct _UcadAffinityState UcadAffinityState;
+
+UcadAffinity *ucad_affinity_new_from_list   (const gchar *list,
+                                             GError **error);
+UcadAffinity *ucad_affinity_new_for_node    (guint node,
+                                             GError **error);
+void          ucad_affinity_free            (UcadAffinity *affinity);
+const gchar  *ucad_affinity_get_description (UcadAffinity *affinity);
+guint         ucad_affinity_get_num_cpus    (UcadAffinity *affinity);
+gboolean      ucad_affinity_get_cpu         (UcadAffinity *affinity,
+                                             guint index,
+                                             guint *cpu);
+gint          ucad_affinity_clamp_priority  (gint priority);
+
+UcadAffinityState *ucad_affinity_pin_thread     (UcadAffinity *affinity,
+                                                 gint index,
+                                                 gint priority,
+                                                 GError **error);
+void               ucad_affinity_restore_thread (UcadAffinityState *state);
+
+#endif
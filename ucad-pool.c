@@ -0,0 +1,300 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+#include "ucad-pool.h"
+#include "config.h"
+
+#ifdef HAVE_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define UCAD_POOL_HUGE_PAGE_SIZE    (2 << 20)
+#define UCAD_POOL_MAX_IDLE          8   /* Released buffers kept by default */
+
+typedef struct {
+    gchar *data;
+    gsize size;
+    gsize memory_size;
+    gboolean mapped;
+    gboolean locked;
+} UcadPoolBuffer;
+
+struct _UcadPool {
+    GMutex lock;
+    gboolean hugepages;
+    gboolean lock_memory;
+    gboolean warned;
+    gsize frame_size;
+    guint max_idle;
+    GQueue idle;            /* Most recently released first */
+    GHashTable *buffers;    /* All buffers by their data */
+};
+
+static gsize
+get_page_size (void)
+{
+#ifdef HAVE_UNIX
+    return (gsize) sysconf (_SC_PAGESIZE);
+#else
+    return 4096;
+#endif
+}
+
+/*
+ * Allocate a buffer from huge pages if requested and possible, falling back
+ * to transparent huge pages and regular memory like the ring does, and fault
+ * it in right away.
+ */
+static UcadPoolBuffer *
+allocate_buffer (UcadPool *pool, gsize size)
+{
+    UcadPoolBuffer *buffer;
+    gsize page_size = get_page_size ();
+
+    buffer = g_new0 (UcadPoolBuffer, 1);
+    buffer->size = size;
+
+#if defined(HAVE_UNIX) && defined(MAP_HUGETLB)
+    if (pool->hugepages) {
+        gsize rounded = (size + UCAD_POOL_HUGE_PAGE_SIZE - 1) / UCAD_POOL_HUGE_PAGE_SIZE * UCAD_POOL_HUGE_PAGE_SIZE;
+        gpointer memory;
+
+        memory = mmap (NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if (memory == MAP_FAILED) {
+            memory = mmap (NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (memory != MAP_FAILED)
+                madvise (memory, rounded, MADV_HUGEPAGE);
+#endif
+        }
+        else {
+            page_size = UCAD_POOL_HUGE_PAGE_SIZE;
+        }
+
+        if (memory != MAP_FAILED) {
+            buffer->data = memory;
+            buffer->memory_size = rounded;
+            buffer->mapped = TRUE;
+        }
+    }
+#endif
+
+    /* Page-aligned, so that recordings can write frames with direct I/O */
+    if (buffer->data == NULL) {
+#ifdef HAVE_UNIX
+        if (posix_memalign ((void **) &buffer->data, page_size, MAX (size, 1)))
+            g_error ("Could not allocate %" G_GSIZE_FORMAT " bytes", size);
+#else
+        buffer->data = g_malloc (MAX (size, 1));
+#endif
+        buffer->memory_size = size;
+    }
+
+    /* Touch every page now instead of during the first frame */
+    for (gsize offset = 0; offset < buffer->memory_size; offset += page_size)
+        buffer->data[offset] = 0;
+
+#ifdef HAVE_UNIX
+    if (pool->lock_memory) {
+        buffer->locked = mlock (buffer->data, buffer->memory_size) == 0;
+
+        if (!buffer->locked && !pool->warned) {
+            g_warning ("Could not lock frame buffers in memory: %s", g_strerror (errno));
+            pool->warned = TRUE;
+        }
+    }
+#endif
+
+    return buffer;
+}
+
+static void
+free_buffer (UcadPoolBuffer *buffer)
+{
+#ifdef HAVE_UNIX
+    if (buffer->locked)
+        munlock (buffer->data, buffer->memory_size);
+
+    if (buffer->mapped)
+        munmap (buffer->data, buffer->memory_size);
+    else
+        free (buffer->data);
+#else
+    g_free (buffer->data);
+#endif
+
+    g_free (buffer);
+}
+
+UcadPool *
+ucad_pool_new (gboolean hugepages, gboolean lock)
+{
+    UcadPool *pool;
+
+    pool = g_new0 (UcadPool, 1);
+    pool->hugepages = hugepages;
+    pool->lock_memory = lock;
+    pool->max_idle = UCAD_POOL_MAX_IDLE;
+    pool->buffers = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) free_buffer);
+    g_mutex_init (&pool->lock);
+    g_queue_init (&pool->idle);
+
+    return pool;
+}
+
+/**
+ * Free the pool together with all of its buffers, including those still
+ * acquired.
+ */
+void
+ucad_pool_free (UcadPool *pool)
+{
+    if (pool == NULL)
+        return;
+
+    g_queue_clear (&pool->idle);
+    g_hash_table_destroy (pool->buffers);
+    g_mutex_clear (&pool->lock);
+    g_free (pool);
+}
+
+/* Called with the lock held */
+static void
+drop_buffer (UcadPool *pool, UcadPoolBuffer *buffer)
+{
+    g_queue_remove (&pool->idle, buffer);
+    g_hash_table_remove (pool->buffers, buffer->data);
+}
+
+/**
+ * Tell the pool the size of frames with the current geometry and keep at
+ * least num_buffers of them ready. Buffers kept for another frame size are
+ * dropped if the size changed.
+ */
+void
+ucad_pool_set_frame_size (UcadPool *pool, gsize frame_size, guint num_buffers)
+{
+    guint num_ready = 0;
+
+    g_mutex_lock (&pool->lock);
+    num_buffers = MIN (num_buffers, pool->max_idle);
+
+    if (pool->frame_size != frame_size) {
+        while (!g_queue_is_empty (&pool->idle))
+            drop_buffer (pool, g_queue_peek_head (&pool->idle));
+
+        g_debug ("Frame pool resized from %" G_GSIZE_FORMAT " to %" G_GSIZE_FORMAT " bytes",
+                 pool->frame_size, frame_size);
+        pool->frame_size = frame_size;
+    }
+
+    for (GList *it = pool->idle.head; it != NULL; it = g_list_next (it))
+        num_ready += ((UcadPoolBuffer *) it->data)->size == frame_size;
+
+    g_mutex_unlock (&pool->lock);
+
+    /* Faulting in may take a while and must not block other requests */
+    for (; num_ready < num_buffers; num_ready++) {
+        UcadPoolBuffer *buffer = allocate_buffer (pool, frame_size);
+
+        g_mutex_lock (&pool->lock);
+        g_hash_table_insert (pool->buffers, buffer->data, buffer);
+        g_queue_push_tail (&pool->idle, buffer);
+        g_mutex_unlock (&pool->lock);
+    }
+}
+
+/**
+ * Get a buffer of size bytes, a kept one if possible.
+ */
+gpointer
+ucad_pool_acquire (UcadPool *pool, gsize size)
+{
+    UcadPoolBuffer *buffer;
+
+    g_mutex_lock (&pool->lock);
+
+    for (GList *it = pool->idle.head; it != NULL; it = g_list_next (it)) {
+        buffer = it->data;
+
+        if (buffer->size == size) {
+            g_queue_delete_link (&pool->idle, it);
+            g_mutex_unlock (&pool->lock);
+            return buffer->data;
+        }
+    }
+
+    g_mutex_unlock (&pool->lock);
+    buffer = allocate_buffer (pool, size);
+
+    g_mutex_lock (&pool->lock);
+    g_hash_table_insert (pool->buffers, buffer->data, buffer);
+    g_mutex_unlock (&pool->lock);
+
+    return buffer->data;
+}
+
+/**
+ * Give a buffer back to the pool, which keeps the most recently released
+ * ones.
+ */
+void
+ucad_pool_release (UcadPool *pool, gpointer data)
+{
+    UcadPoolBuffer *buffer;
+
+    if (data == NULL)
+        return;
+
+    g_mutex_lock (&pool->lock);
+    buffer = g_hash_table_lookup (pool->buffers, data);
+
+    if (buffer == NULL) {
+        g_mutex_unlock (&pool->lock);
+        g_warning ("Releasing buffer %p which is not part of the frame pool", data);
+        return;
+    }
+
+    g_queue_push_head (&pool->idle, buffer);
+
+    if (g_queue_get_length (&pool->idle) > pool->max_idle)
+        drop_buffer (pool, g_queue_peek_tail (&pool->idle));
+
+    g_mutex_unlock (&pool->lock);
+}
+
+/**
+ * Keep up to max_idle released buffers, but at least the default number, for
+ * users which hold many buffers at once and would otherwise allocate and
+ * fault in one for each they acquire.
+ */
+void
+ucad_pool_set_max_idle (UcadPool *pool, guint max_idle)
+{
+    g_mutex_lock (&pool->lock);
+    pool->max_idle = MAX (max_idle, UCAD_POOL_MAX_IDLE);
+
+    while (g_queue_get_length (&pool->idle) > pool->max_idle)
+        drop_buffer (pool, g_queue_peek_tail (&pool->idle));
+
+    g_mutex_unlock (&pool->lock);
+}
@@ -0,0 +1,44 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#ifndef UCAD_POOL_H
+#define UCAD_POOL_H
+
+#include <glib.h>
+
+/*
+ * Frame buffers shared by all requests of a camera. Buffers are faulted in
+ * when they are allocated, optionally locked in memory and backed by huge
+ * pages, and kept after release, so that a new grab or push does not start
+ * with page faults across the whole frame. Setting another frame size after
+ * the geometry changed drops the buffers kept for the old one.
+ */
+typedef struct _UcadPool UcadPool;
+
+UcadPool   *ucad_pool_new               (gboolean hugepages,
+                                         gboolean lock);
+void        ucad_pool_free              (UcadPool *pool);
+void        ucad_pool_set_frame_size    (UcadPool *pool,
+                                         gsize frame_size,
+                                         guint num_buffers);
+gpointer    ucad_pool_acquire           (UcadPool *pool,
+                                         gsize size);
+void        ucad_pool_release           (UcadPool *pool,
+                                         gpointer buffer);
+void        ucad_pool_set_max_idle      (UcadPool *pool,
+                                         guint max_idle);
+
+#endif
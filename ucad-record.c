@@ -0,0 +1,365 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+#include "ucad-record.h"
+#include "config.h"
+
+#ifdef HAVE_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* Frames are collected and written in chunks of this size */
+#define UCAD_RECORD_BUFFER_SIZE (16 << 20)
+
+/* Frames of at least this size are written from where they are */
+#define UCAD_RECORD_DIRECT_SIZE (1 << 20)
+
+struct _UcadRecorder {
+    gchar *prefix;
+    guint64 max_file_size;
+    gint index_fd;
+    gint data_fd;
+    guint32 file;
+    gboolean direct;
+    guint64 file_size;      /* Written and buffered bytes of the data file */
+    guint64 written;        /* Written bytes of the data file */
+    gchar *buffer;
+    gsize buffer_size;
+    gsize buffer_used;
+    GArray *pending;        /* Entries of buffered frames */
+    guint64 num_indexed;
+};
+
+#ifdef HAVE_UNIX
+
+static gsize
+align (gsize size)
+{
+    return (size + UCAD_RECORD_ALIGNMENT - 1) & ~((gsize) UCAD_RECORD_ALIGNMENT - 1);
+}
+
+static gboolean
+write_all (gint fd, gconstpointer data, gsize size, goffset offset, const gchar *what, GError **error)
+{
+    const gchar *source = data;
+    gsize written = 0;
+
+    while (written < size) {
+        gssize result = pwrite (fd, source + written, size - written, offset + written);
+
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+
+            g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                         "Could not write %s: %s", what, g_strerror (errno));
+            return FALSE;
+        }
+
+        written += result;
+    }
+
+    return TRUE;
+}
+
+static gint
+open_file (const gchar *path, gboolean direct, GError **error)
+{
+    gint flags = O_WRONLY | O_CREAT | O_TRUNC;
+    gint fd;
+
+#ifdef O_DIRECT
+    if (direct)
+        flags |= O_DIRECT;
+#endif
+
+    fd = open (path, flags, 0644);
+
+    if (fd < 0)
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                     "Could not open `%s': %s", path, g_strerror (errno));
+
+    return fd;
+}
+
+static gboolean
+open_data_file (UcadRecorder *recorder, GError **error)
+{
+    gchar *path;
+
+    path = g_strdup_printf ("%s-%06u.raw", recorder->prefix, recorder->file);
+    recorder->data_fd = open_file (path, TRUE, NULL);
+    recorder->direct = recorder->data_fd >= 0;
+
+    /* Some file systems do not support direct I/O */
+    if (recorder->data_fd < 0)
+        recorder->data_fd = open_file (path, FALSE, error);
+
+    if (recorder->data_fd >= 0)
+        g_debug ("Recording into `%s'%s", path, recorder->direct ? " with direct I/O" : "");
+
+    recorder->file_size = 0;
+    recorder->written = 0;
+    g_free (path);
+
+    return recorder->data_fd >= 0;
+}
+
+static gboolean
+reserve_buffer (UcadRecorder *recorder, gsize size)
+{
+    gchar *buffer;
+
+    if (size <= recorder->buffer_size)
+        return TRUE;
+
+    if (posix_memalign ((void **) &buffer, UCAD_RECORD_ALIGNMENT, size))
+        return FALSE;
+
+    free (recorder->buffer);
+    recorder->buffer = buffer;
+    recorder->buffer_size = size;
+
+    return TRUE;
+}
+
+/**
+ * Create the index and the first data file. With a max_file_size of 0, data
+ * files are never rotated.
+ */
+UcadRecorder *
+ucad_recorder_new (const gchar *prefix, guint64 max_file_size, GError **error)
+{
+    UcadRecorder *recorder;
+    UcadRecordHeader header = { UCAD_RECORD_MAGIC, };
+    gchar *path;
+
+    recorder = g_new0 (UcadRecorder, 1);
+    recorder->prefix = g_strdup (prefix);
+    recorder->max_file_size = max_file_size;
+    recorder->data_fd = -1;
+    recorder->pending = g_array_new (FALSE, FALSE, sizeof (UcadRecordEntry));
+
+    path = g_strdup_printf ("%s.idx", prefix);
+    recorder->index_fd = open_file (path, FALSE, error);
+    g_free (path);
+
+    header.version = UCAD_RECORD_VERSION;
+    header.entry_size = sizeof (UcadRecordEntry);
+    header.alignment = UCAD_RECORD_ALIGNMENT;
+
+    if (recorder->index_fd < 0 ||
+        !write_all (recorder->index_fd, &header, sizeof (header), 0, "index", error) ||
+        !open_data_file (recorder, error) ||
+        !reserve_buffer (recorder, UCAD_RECORD_BUFFER_SIZE)) {
+        if (error != NULL && *error == NULL)
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not allocate recording buffer");
+
+        ucad_recorder_free (recorder);
+        return NULL;
+    }
+
+    return recorder;
+}
+
+void
+ucad_recorder_free (UcadRecorder *recorder)
+{
+    GError *error = NULL;
+
+    if (recorder == NULL)
+        return;
+
+    if (recorder->data_fd >= 0 && recorder->index_fd >= 0 && !ucad_recorder_flush (recorder, &error)) {
+        g_warning ("%s", error->message);
+        g_error_free (error);
+    }
+
+    if (recorder->data_fd >= 0)
+        close (recorder->data_fd);
+
+    if (recorder->index_fd >= 0)
+        close (recorder->index_fd);
+
+    g_array_free (recorder->pending, TRUE);
+    free (recorder->buffer);
+    g_free (recorder->prefix);
+    g_free (recorder);
+}
+
+/**
+ * Write buffered frames and then their index entries, so that the index never
+ * refers to data that is not on disk yet.
+ */
+gboolean
+ucad_recorder_flush (UcadRecorder *recorder, GError **error)
+{
+    goffset position;
+
+    if (recorder->buffer_used > 0) {
+        if (!write_all (recorder->data_fd, recorder->buffer, recorder->buffer_used,
+                        recorder->written, "frames", error))
+            return FALSE;
+
+        recorder->written += recorder->buffer_used;
+        recorder->buffer_used = 0;
+    }
+
+    if (recorder->pending->len > 0) {
+        position = sizeof (UcadRecordHeader) + recorder->num_indexed * sizeof (UcadRecordEntry);
+
+        if (!write_all (recorder->index_fd, recorder->pending->data,
+                        recorder->pending->len * sizeof (UcadRecordEntry), position, "index", error))
+            return FALSE;
+
+        recorder->num_indexed += recorder->pending->len;
+        g_array_set_size (recorder->pending, 0);
+    }
+
+    return TRUE;
+}
+
+/*
+ * Write a large frame without copying it. With direct I/O data must be aligned
+ * like the file, so only its last partial block is copied and padded in the
+ * staging buffer. Smaller frames are cheaper to copy than to write one by one.
+ */
+static gboolean
+write_unbuffered (UcadRecorder *recorder, gconstpointer data, gsize size, GError **error)
+{
+    gsize head = size & ~((gsize) UCAD_RECORD_ALIGNMENT - 1);
+    gsize tail = size - head;
+
+    if (!ucad_recorder_flush (recorder, error) ||
+        !write_all (recorder->data_fd, data, head, recorder->written, "frames", error))
+        return FALSE;
+
+    recorder->written += head;
+
+    if (tail > 0) {
+        memcpy (recorder->buffer, (const gchar *) data + head, tail);
+        memset (recorder->buffer + tail, 0, UCAD_RECORD_ALIGNMENT - tail);
+
+        if (!write_all (recorder->data_fd, recorder->buffer, UCAD_RECORD_ALIGNMENT,
+                        recorder->written, "frames", error))
+            return FALSE;
+
+        recorder->written += UCAD_RECORD_ALIGNMENT;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Append entry->size bytes of data. The file and offset of entry are filled in,
+ * all other fields are taken as they are.
+ */
+gboolean
+ucad_recorder_write (UcadRecorder *recorder, UcadRecordEntry *entry, gconstpointer data, GError **error)
+{
+    gsize aligned = align (entry->size);
+
+    if (recorder->max_file_size > 0 && recorder->file_size > 0 &&
+        recorder->file_size + aligned > recorder->max_file_size) {
+        if (!ucad_recorder_flush (recorder, error))
+            return FALSE;
+
+        close (recorder->data_fd);
+        recorder->file++;
+
+        if (!open_data_file (recorder, error))
+            return FALSE;
+    }
+
+    if (aligned >= UCAD_RECORD_DIRECT_SIZE &&
+        (!recorder->direct || ((guintptr) data & (UCAD_RECORD_ALIGNMENT - 1)) == 0)) {
+        if (!write_unbuffered (recorder, data, entry->size, error))
+            return FALSE;
+    }
+    else {
+        if (recorder->buffer_used + aligned > recorder->buffer_size && !ucad_recorder_flush (recorder, error))
+            return FALSE;
+
+        if (!reserve_buffer (recorder, aligned)) {
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not allocate recording buffer");
+            return FALSE;
+        }
+
+        memcpy (recorder->buffer + recorder->buffer_used, data, entry->size);
+        memset (recorder->buffer + recorder->buffer_used + entry->size, 0, aligned - entry->size);
+        recorder->buffer_used += aligned;
+    }
+
+    entry->file = recorder->file;
+    entry->offset = recorder->file_size;
+    g_array_append_val (recorder->pending, *entry);
+
+    recorder->file_size += aligned;
+
+    return TRUE;
+}
+
+guint64
+ucad_recorder_get_num_frames (UcadRecorder *recorder)
+{
+    return recorder->num_indexed + recorder->pending->len;
+}
+
+#else
+
+UcadRecorder *
+ucad_recorder_new (const gchar *prefix, guint64 max_file_size, GError **error)
+{
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                         "Recording frames is not supported on this platform");
+    return NULL;
+}
+
+void
+ucad_recorder_free (UcadRecorder *recorder)
+{
+    g_free (recorder);
+}
+
+gboolean
+ucad_recorder_flush (UcadRecorder *recorder, GError **error)
+{
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                         "Recording frames is not supported on this platform");
+    return FALSE;
+}
+
+gboolean
+ucad_recorder_write (UcadRecorder *recorder, UcadRecordEntry *entry, gconstpointer data, GError **error)
+{
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                         "Recording frames is not supported on this platform");
+    return FALSE;
+}
+
+guint64
+ucad_recorder_get_num_frames (UcadRecorder *recorder)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,74 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#ifndef UCAD_RECORD_H
+#define UCAD_RECORD_H
+
+#include <glib.h>
+
+/*
+ * Recording of frames into local files. Frames are appended to the data files
+ * PREFIX-000000.raw, PREFIX-000001.raw, ..., each frame starting at a multiple
+ * of UCAD_RECORD_ALIGNMENT. A new data file is started before one would grow
+ * beyond its maximum size. PREFIX.idx starts with a UcadRecordHeader followed
+ * by one UcadRecordEntry per frame, so that the entry of frame k is found at
+ * sizeof (UcadRecordHeader) + k * sizeof (UcadRecordEntry) without scanning.
+ * All fields are in host byte order.
+ */
+#define UCAD_RECORD_MAGIC       "UCADREC1"
+#define UCAD_RECORD_VERSION     1
+#define UCAD_RECORD_ALIGNMENT   4096
+
+/* Endpoints starting with this are recorded, followed by the PREFIX */
+#define UCAD_RECORD_SCHEME      "file://"
+
+typedef struct {
+    gchar magic[8];
+    guint32 version;
+    guint32 entry_size;
+    guint32 alignment;
+    guint32 reserved;
+} UcadRecordHeader;
+
+typedef struct {
+    guint64 frame_number;
+    guint64 sequence;       /* Grabbed frame, the first one if accumulated */
+    gint64 timestamp;       /* Microseconds since the epoch */
+    guint64 offset;         /* Position in the data file */
+    guint64 size;           /* Bytes of frame data, without padding */
+    guint32 file;           /* Number of the data file */
+    guint32 width;
+    guint32 height;
+    guint32 pixel_size;
+    guint32 bitdepth;
+    guint32 dtype;          /* UcaNetDtype */
+} UcadRecordEntry;
+
+typedef struct _UcadRecorder UcadRecorder;
+
+UcadRecorder   *ucad_recorder_new           (const gchar *prefix,
+                                             guint64 max_file_size,
+                                             GError **error);
+void            ucad_recorder_free          (UcadRecorder *recorder);
+gboolean        ucad_recorder_write         (UcadRecorder *recorder,
+                                             UcadRecordEntry *entry,
+                                             gconstpointer data,
+                                             GError **error);
+gboolean        ucad_recorder_flush         (UcadRecorder *recorder,
+                                             GError **error);
+guint64         ucad_recorder_get_num_frames (UcadRecorder *recorder);
+
+#endif
@@ -0,0 +1,502 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#include <errno.h>
+#include <string.h>
+#include <gio/gio.h>
+#include "ucad-replay.h"
+#include "ucad-record.h"
+#include "config.h"
+
+#ifdef HAVE_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define UCAD_REPLAY_CAMERA_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), UCAD_TYPE_REPLAY_CAMERA, UcadReplayCameraPrivate))
+
+/* Frames ahead of the current one which the kernel is asked to read in */
+#define UCAD_REPLAY_PREFETCH 4
+
+G_DEFINE_TYPE (UcadReplayCamera, ucad_replay_camera, UCA_TYPE_CAMERA)
+
+GQuark ucad_replay_camera_error_quark ()
+{
+    return g_quark_from_static_string ("ucad-replay-camera-error-quark");
+}
+
+static const gint base_overrideables[] = {
+    PROP_NAME,
+    PROP_SENSOR_WIDTH,
+    PROP_SENSOR_HEIGHT,
+    PROP_SENSOR_BITDEPTH,
+    PROP_ROI_X,
+    PROP_ROI_Y,
+    PROP_ROI_WIDTH,
+    PROP_ROI_HEIGHT,
+    PROP_EXPOSURE_TIME,
+    PROP_FRAMES_PER_SECOND,
+    PROP_HAS_STREAMING,
+    PROP_HAS_CAMRAM_RECORDING,
+    0,
+};
+
+typedef struct {
+    gchar *data;
+    gsize size;
+#ifndef HAVE_UNIX
+    GMappedFile *mapped;
+#endif
+} UcadReplayMap;
+
+struct _UcadReplayCameraPrivate {
+    UcadReplayMap index;
+    const UcadRecordEntry *entries;
+    guint64 num_frames;
+    UcadReplayMap *files;
+    guint num_files;
+    guint width;
+    guint height;
+    guint bitdepth;
+    gsize frame_size;
+    gsize page_size;
+    gdouble frames_per_second;  /* 0: as fast as possible */
+    gdouble exposure_time;
+    guint64 current;
+    guint64 paced_from;         /* Frame sent at paced_time */
+    gint64 paced_time;
+};
+
+#ifdef HAVE_UNIX
+static gboolean
+map_file (const gchar *path, UcadReplayMap *map, GError **error)
+{
+    struct stat st;
+    gint fd;
+
+    if ((fd = open (path, O_RDONLY)) < 0 || fstat (fd, &st) < 0) {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                     "Could not open `%s': %s", path, g_strerror (errno));
+
+        if (fd >= 0)
+            close (fd);
+
+        return FALSE;
+    }
+
+    map->size = st.st_size;
+    map->data = NULL;
+
+    if (map->size > 0) {
+        map->data = mmap (NULL, map->size, PROT_READ, MAP_SHARED, fd, 0);
+
+        if (map->data == MAP_FAILED) {
+            g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                         "Could not map `%s': %s", path, g_strerror (errno));
+            map->data = NULL;
+            close (fd);
+            return FALSE;
+        }
+
+        madvise (map->data, map->size, MADV_SEQUENTIAL);
+    }
+
+    close (fd);
+
+    return TRUE;
+}
+
+static void
+unmap_file (UcadReplayMap *map)
+{
+    if (map->data != NULL)
+        munmap (map->data, map->size);
+
+    map->data = NULL;
+}
+#else
+static gboolean
+map_file (const gchar *path, UcadReplayMap *map, GError **error)
+{
+    map->mapped = g_mapped_file_new (path, FALSE, error);
+
+    if (map->mapped == NULL)
+        return FALSE;
+
+    map->data = g_mapped_file_get_contents (map->mapped);
+    map->size = g_mapped_file_get_length (map->mapped);
+
+    return TRUE;
+}
+
+static void
+unmap_file (UcadReplayMap *map)
+{
+    if (map->mapped != NULL)
+        g_mapped_file_unref (map->mapped);
+
+    map->mapped = NULL;
+    map->data = NULL;
+}
+#endif
+
+static gboolean
+open_recording (UcadReplayCameraPrivate *priv, const gchar *prefix, GError **error)
+{
+    const UcadRecordHeader *header;
+    const UcadRecordEntry *last;
+    gchar *path;
+    gboolean success;
+
+    path = g_strdup_printf ("%s.idx", prefix);
+    success = map_file (path, &priv->index, error);
+    g_free (path);
+
+    if (!success)
+        return FALSE;
+
+    header = (const UcadRecordHeader *) priv->index.data;
+
+    if (priv->index.size < sizeof (UcadRecordHeader) ||
+        memcmp (header->magic, UCAD_RECORD_MAGIC, sizeof (header->magic)) ||
+        header->entry_size != sizeof (UcadRecordEntry)) {
+        g_set_error (error, UCAD_REPLAY_CAMERA_ERROR, UCAD_REPLAY_CAMERA_ERROR_INVALID_RECORDING,
+                     "`%s.idx' is not a recording index", prefix);
+        return FALSE;
+    }
+
+    priv->entries = (const UcadRecordEntry *) (priv->index.data + sizeof (UcadRecordHeader));
+    priv->num_frames = (priv->index.size - sizeof (UcadRecordHeader)) / sizeof (UcadRecordEntry);
+
+    if (priv->num_frames == 0) {
+        g_set_error (error, UCAD_REPLAY_CAMERA_ERROR, UCAD_REPLAY_CAMERA_ERROR_NO_DATA,
+                     "`%s' contains no frames", prefix);
+        return FALSE;
+    }
+
+    /* Frames are sent as the camera would, so they must be as grabbed */
+    if (priv->entries[0].pixel_size != 1 && priv->entries[0].pixel_size != 2) {
+        g_set_error (error, UCAD_REPLAY_CAMERA_ERROR, UCAD_REPLAY_CAMERA_ERROR_INVALID_RECORDING,
+                     "Cannot replay frames of %u bytes per pixel", priv->entries[0].pixel_size);
+        return FALSE;
+    }
+
+    priv->width = priv->entries[0].width;
+    priv->height = priv->entries[0].height;
+    priv->bitdepth = priv->entries[0].bitdepth;
+    priv->frame_size = priv->entries[0].size;
+
+    last = &priv->entries[priv->num_frames - 1];
+    priv->num_files = last->file + 1;
+    priv->files = g_new0 (UcadReplayMap, priv->num_files);
+
+    for (guint i = 0; i < priv->num_files; i++) {
+        path = g_strdup_printf ("%s-%06u.raw", prefix, i);
+        success = map_file (path, &priv->files[i], error);
+        g_free (path);
+
+        if (!success)
+            return FALSE;
+    }
+
+    g_debug ("Replaying %" G_GUINT64_FORMAT " frames of %ux%u pixels from %u files",
+             priv->num_frames, priv->width, priv->height, priv->num_files);
+
+    return TRUE;
+}
+
+static const gchar *
+get_frame (UcadReplayCameraPrivate *priv, guint64 index, GError **error)
+{
+    const UcadRecordEntry *entry = &priv->entries[index % priv->num_frames];
+
+    if (entry->file >= priv->num_files || entry->size != priv->frame_size ||
+        entry->offset + entry->size > priv->files[entry->file].size) {
+        g_set_error (error, UCAD_REPLAY_CAMERA_ERROR, UCAD_REPLAY_CAMERA_ERROR_INVALID_RECORDING,
+                     "Frame %" G_GUINT64_FORMAT " is missing or differs in size", index % priv->num_frames);
+        return NULL;
+    }
+
+    return priv->files[entry->file].data + entry->offset;
+}
+
+static void
+prefetch (UcadReplayCameraPrivate *priv, guint64 index)
+{
+#ifdef HAVE_UNIX
+    const UcadRecordEntry *entry = &priv->entries[index % priv->num_frames];
+    gsize start;
+
+    if (entry->file >= priv->num_files || entry->offset + entry->size > priv->files[entry->file].size)
+        return;
+
+    start = entry->offset & ~(priv->page_size - 1);
+    madvise (priv->files[entry->file].data + start, entry->offset + entry->size - start, MADV_WILLNEED);
+#endif
+}
+
+static void
+restart (UcadReplayCameraPrivate *priv)
+{
+    priv->current = 0;
+    priv->paced_from = 0;
+    priv->paced_time = g_get_monotonic_time ();
+
+    for (guint64 i = 0; i < UCAD_REPLAY_PREFETCH; i++)
+        prefetch (priv, i);
+}
+
+static void
+ucad_replay_camera_start_recording (UcaCamera *camera, GError **error)
+{
+    g_return_if_fail (UCAD_IS_REPLAY_CAMERA (camera));
+    restart (UCAD_REPLAY_CAMERA_GET_PRIVATE (camera));
+}
+
+static void
+ucad_replay_camera_stop_recording (UcaCamera *camera, GError **error)
+{
+    g_return_if_fail (UCAD_IS_REPLAY_CAMERA (camera));
+}
+
+static void
+ucad_replay_camera_start_readout (UcaCamera *camera, GError **error)
+{
+    g_return_if_fail (UCAD_IS_REPLAY_CAMERA (camera));
+    restart (UCAD_REPLAY_CAMERA_GET_PRIVATE (camera));
+}
+
+static void
+ucad_replay_camera_stop_readout (UcaCamera *camera, GError **error)
+{
+    g_return_if_fail (UCAD_IS_REPLAY_CAMERA (camera));
+}
+
+static void
+ucad_replay_camera_trigger (UcaCamera *camera, GError **error)
+{
+    g_return_if_fail (UCAD_IS_REPLAY_CAMERA (camera));
+}
+
+/**
+ * Copy the next frame, starting over after the last one. With a frame rate,
+ * frames are not delivered before they are due.
+ */
+static gboolean
+ucad_replay_camera_grab (UcaCamera *camera, gpointer data, GError **error)
+{
+    UcadReplayCameraPrivate *priv;
+    const gchar *frame;
+
+    g_return_val_if_fail (UCAD_IS_REPLAY_CAMERA (camera), FALSE);
+    priv = UCAD_REPLAY_CAMERA_GET_PRIVATE (camera);
+
+    if ((frame = get_frame (priv, priv->current, error)) == NULL)
+        return FALSE;
+
+    if (priv->frames_per_second > 0.0) {
+        gint64 due = priv->paced_time +
+                     (gint64) ((priv->current - priv->paced_from) * G_USEC_PER_SEC / priv->frames_per_second);
+        gint64 now = g_get_monotonic_time ();
+
+        if (due > now)
+            g_usleep (due - now);
+    }
+
+    memcpy (data, frame, priv->frame_size);
+    prefetch (priv, priv->current + UCAD_REPLAY_PREFETCH);
+    priv->current++;
+
+    return TRUE;
+}
+
+static gboolean
+ucad_replay_camera_readout (UcaCamera *camera, gpointer data, guint index, GError **error)
+{
+    UcadReplayCameraPrivate *priv;
+    const gchar *frame;
+
+    g_return_val_if_fail (UCAD_IS_REPLAY_CAMERA (camera), FALSE);
+    priv = UCAD_REPLAY_CAMERA_GET_PRIVATE (camera);
+
+    if (index >= priv->num_frames) {
+        g_set_error (error, UCAD_REPLAY_CAMERA_ERROR, UCAD_REPLAY_CAMERA_ERROR_NO_DATA,
+                     "Recording has only %" G_GUINT64_FORMAT " frames", priv->num_frames);
+        return FALSE;
+    }
+
+    if ((frame = get_frame (priv, index, error)) == NULL)
+        return FALSE;
+
+    memcpy (data, frame, priv->frame_size);
+
+    return TRUE;
+}
+
+static void
+ucad_replay_camera_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec)
+{
+    UcadReplayCameraPrivate *priv = UCAD_REPLAY_CAMERA_GET_PRIVATE (object);
+
+    switch (property_id) {
+        case PROP_FRAMES_PER_SECOND:
+            priv->frames_per_second = MAX (g_value_get_double (value), 0.0);
+            priv->paced_from = priv->current;
+            priv->paced_time = g_get_monotonic_time ();
+            break;
+        case PROP_EXPOSURE_TIME:
+            priv->exposure_time = g_value_get_double (value);
+            break;
+        case PROP_SENSOR_WIDTH:
+        case PROP_SENSOR_HEIGHT:
+        case PROP_SENSOR_BITDEPTH:
+        case PROP_ROI_X:
+        case PROP_ROI_Y:
+        case PROP_ROI_WIDTH:
+        case PROP_ROI_HEIGHT:
+            g_warning ("`%s' is given by the recording", g_param_spec_get_name (pspec));
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    }
+}
+
+static void
+ucad_replay_camera_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
+{
+    UcadReplayCameraPrivate *priv = UCAD_REPLAY_CAMERA_GET_PRIVATE (object);
+
+    switch (property_id) {
+        case PROP_NAME:
+            g_value_set_string (value, "replay");
+            break;
+        case PROP_SENSOR_WIDTH:
+        case PROP_ROI_WIDTH:
+            g_value_set_uint (value, priv->width);
+            break;
+        case PROP_SENSOR_HEIGHT:
+        case PROP_ROI_HEIGHT:
+            g_value_set_uint (value, priv->height);
+            break;
+        case PROP_SENSOR_BITDEPTH:
+            g_value_set_uint (value, priv->bitdepth);
+            break;
+        case PROP_ROI_X:
+        case PROP_ROI_Y:
+            g_value_set_uint (value, 0);
+            break;
+        case PROP_EXPOSURE_TIME:
+            g_value_set_double (value, priv->exposure_time);
+            break;
+        case PROP_FRAMES_PER_SECOND:
+            g_value_set_double (value, priv->frames_per_second);
+            break;
+        case PROP_HAS_STREAMING:
+            g_value_set_boolean (value, TRUE);
+            break;
+        case PROP_HAS_CAMRAM_RECORDING:
+            g_value_set_boolean (value, FALSE);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    }
+}
+
+static void
+ucad_replay_camera_finalize (GObject *object)
+{
+    UcadReplayCameraPrivate *priv = UCAD_REPLAY_CAMERA_GET_PRIVATE (object);
+
+    for (guint i = 0; i < priv->num_files; i++)
+        unmap_file (&priv->files[i]);
+
+    unmap_file (&priv->index);
+    g_free (priv->files);
+
+    G_OBJECT_CLASS (ucad_replay_camera_parent_class)->finalize (object);
+}
+
+static void
+ucad_replay_camera_class_init (UcadReplayCameraClass *klass)
+{
+    GObjectClass *oclass = G_OBJECT_CLASS (klass);
+    UcaCameraClass *camera_class = UCA_CAMERA_CLASS (klass);
+
+    oclass->set_property = ucad_replay_camera_set_property;
+    oclass->get_property = ucad_replay_camera_get_property;
+    oclass->finalize = ucad_replay_camera_finalize;
+
+    camera_class->start_recording = ucad_replay_camera_start_recording;
+    camera_class->stop_recording = ucad_replay_camera_stop_recording;
+    camera_class->start_readout = ucad_replay_camera_start_readout;
+    camera_class->stop_readout = ucad_replay_camera_stop_readout;
+    camera_class->grab = ucad_replay_camera_grab;
+    camera_class->readout = ucad_replay_camera_readout;
+    camera_class->trigger = ucad_replay_camera_trigger;
+
+    for (guint i = 0; base_overrideables[i] != 0; i++)
+        g_object_class_override_property (oclass, base_overrideables[i], uca_camera_props[base_overrideables[i]]);
+
+    g_type_class_add_private (klass, sizeof (UcadReplayCameraPrivate));
+}
+
+static void
+ucad_replay_camera_init (UcadReplayCamera *self)
+{
+    UcadReplayCameraPrivate *priv;
+
+    self->priv = priv = UCAD_REPLAY_CAMERA_GET_PRIVATE (self);
+
+    priv->index.data = NULL;
+    priv->entries = NULL;
+    priv->num_frames = 0;
+    priv->files = NULL;
+    priv->num_files = 0;
+#ifdef HAVE_UNIX
+    priv->page_size = sysconf (_SC_PAGESIZE);
+#else
+    priv->page_size = 4096;
+#endif
+    priv->frames_per_second = 0.0;
+    priv->exposure_time = 0.0;
+    priv->current = 0;
+    priv->paced_from = 0;
+    priv->paced_time = 0;
+}
+
+/**
+ * Open the recording PREFIX.idx with its data files. Frames are replayed at
+ * frames_per_second or, if 0, as fast as they are grabbed.
+ */
+UcaCamera *
+ucad_replay_camera_new (const gchar *prefix, gdouble frames_per_second, GError **error)
+{
+    UcadReplayCamera *camera;
+
+    camera = g_object_new (UCAD_TYPE_REPLAY_CAMERA, NULL);
+
+    if (!open_recording (camera->priv, prefix, error)) {
+        g_object_unref (camera);
+        return NULL;
+    }
+
+    camera->priv->frames_per_second = MAX (frames_per_second, 0.0);
+    restart (camera->priv);
+
+    return UCA_CAMERA (camera);
+}
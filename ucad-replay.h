@@ -0,0 +1,68 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#ifndef UCAD_REPLAY_H
+#define UCAD_REPLAY_H
+
+#include <glib-object.h>
+#include <uca/uca-camera.h>
+
+G_BEGIN_DECLS
+
+#define UCAD_TYPE_REPLAY_CAMERA             (ucad_replay_camera_get_type())
+#define UCAD_REPLAY_CAMERA(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), UCAD_TYPE_REPLAY_CAMERA, UcadReplayCamera))
+#define UCAD_IS_REPLAY_CAMERA(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), UCAD_TYPE_REPLAY_CAMERA))
+#define UCAD_REPLAY_CAMERA_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), UCAD_TYPE_REPLAY_CAMERA, UcadReplayCameraClass))
+
+#define UCAD_REPLAY_CAMERA_ERROR ucad_replay_camera_error_quark()
+typedef enum {
+    UCAD_REPLAY_CAMERA_ERROR_INVALID_RECORDING,
+    UCAD_REPLAY_CAMERA_ERROR_NO_DATA,
+} UcadReplayCameraError;
+
+typedef struct _UcadReplayCamera           UcadReplayCamera;
+typedef struct _UcadReplayCameraClass      UcadReplayCameraClass;
+typedef struct _UcadReplayCameraPrivate    UcadReplayCameraPrivate;
+
+/**
+ * UcadReplayCamera:
+ *
+ * Virtual camera serving the frames of a recording written to a file://
+ * endpoint (see ucad-record.h) in a loop. The contents of the
+ * #UcadReplayCamera structure are private and should only be accessed via the
+ * provided API.
+ */
+struct _UcadReplayCamera {
+    /*< private >*/
+    UcaCamera parent;
+
+    UcadReplayCameraPrivate *priv;
+};
+
+struct _UcadReplayCameraClass {
+    /*< private >*/
+    UcaCameraClass parent;
+};
+
+GQuark      ucad_replay_camera_error_quark  (void);
+GType       ucad_replay_camera_get_type     (void);
+UcaCamera  *ucad_replay_camera_new          (const gchar *prefix,
+                                             gdouble frames_per_second,
+                                             GError **error);
+
+G_END_DECLS
+
+#endif
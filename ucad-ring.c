@@ -0,0 +1,441 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#include <string.h>
+#include <gio/gio.h>
+#include "ucad-ring.h"
+#include "config.h"
+
+#ifdef HAVE_UNIX
+#include <sys/mman.h>
+#endif
+
+#define UCAD_RING_HUGE_PAGE_SIZE    (2 << 20)
+#define UCAD_RING_POLL_INTERVAL     (100 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct {
+    GRWLock lock;
+    guint64 sequence;   /* 0 while being written */
+    gint64 timestamp;
+    guint64 generation;
+    gint64 grab_start;
+    gint64 grab_end;
+    gchar *data;
+} UcadRingSlot;
+
+struct _UcadRing {
+    GMutex lock;
+    GCond published;
+    UcadRingSlot *slots;
+    guint num_slots;
+    gsize frame_size;
+    guint64 head;       /* Sequence of the last published frame */
+    gboolean closed;
+    gboolean frozen;    /* Frames are written to discard instead of a slot */
+    gboolean discarding;
+    gchar *discard;
+    gchar *memory;
+    gsize memory_size;
+    gboolean mapped;
+};
+
+/*
+ * Allocate the memory of all slots in one block, from huge pages if requested
+ * and possible. Transparent huge pages are tried if no huge pages are
+ * reserved.
+ */
+static void
+allocate_memory (UcadRing *ring, gsize size, gboolean hugepages)
+{
+#if defined(HAVE_UNIX) && defined(MAP_HUGETLB)
+    if (hugepages) {
+        gsize rounded = (size + UCAD_RING_HUGE_PAGE_SIZE - 1) / UCAD_RING_HUGE_PAGE_SIZE * UCAD_RING_HUGE_PAGE_SIZE;
+        gpointer memory;
+
+        memory = mmap (NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if (memory == MAP_FAILED) {
+            g_debug ("No huge pages reserved, using transparent huge pages");
+            memory = mmap (NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (memory != MAP_FAILED)
+                madvise (memory, rounded, MADV_HUGEPAGE);
+#endif
+        }
+
+        if (memory != MAP_FAILED) {
+            ring->memory = memory;
+            ring->memory_size = rounded;
+            ring->mapped = TRUE;
+            return;
+        }
+
+        g_warning ("Could not map %" G_GSIZE_FORMAT " bytes, falling back to regular memory", rounded);
+    }
+#endif
+
+    ring->memory = g_try_malloc (size);
+    ring->memory_size = size;
+    ring->mapped = FALSE;
+}
+
+UcadRing *
+ucad_ring_new (guint num_slots, gsize frame_size, gboolean hugepages)
+{
+    UcadRing *ring;
+    gsize stride;
+
+    g_return_val_if_fail (num_slots >= 2, NULL);
+
+    /* Keep slots cache line aligned */
+    stride = (frame_size + 63) & ~((gsize) 63);
+
+    ring = g_new0 (UcadRing, 1);
+    ring->num_slots = num_slots;
+    ring->frame_size = frame_size;
+    ring->slots = g_new0 (UcadRingSlot, num_slots);
+    allocate_memory (ring, stride * num_slots, hugepages);
+
+    if (ring->memory == NULL) {
+        g_free (ring->slots);
+        g_free (ring);
+        return NULL;
+    }
+
+    for (guint i = 0; i < num_slots; i++) {
+        g_rw_lock_init (&ring->slots[i].lock);
+        ring->slots[i].data = ring->memory + i * stride;
+    }
+
+    g_mutex_init (&ring->lock);
+    g_cond_init (&ring->published);
+
+    return ring;
+}
+
+void
+ucad_ring_free (UcadRing *ring)
+{
+    if (ring == NULL)
+        return;
+
+    for (guint i = 0; i < ring->num_slots; i++)
+        g_rw_lock_clear (&ring->slots[i].lock);
+
+#ifdef HAVE_UNIX
+    if (ring->mapped)
+        munmap (ring->memory, ring->memory_size);
+    else
+#endif
+        g_free (ring->memory);
+
+    g_free (ring->discard);
+    g_free (ring->slots);
+    g_mutex_clear (&ring->lock);
+    g_cond_clear (&ring->published);
+    g_free (ring);
+}
+
+gsize
+ucad_ring_get_frame_size (UcadRing *ring)
+{
+    return ring->frame_size;
+}
+
+guint
+ucad_ring_get_num_slots (UcadRing *ring)
+{
+    return ring->num_slots;
+}
+
+guint64
+ucad_ring_get_head (UcadRing *ring)
+{
+    guint64 head;
+
+    g_mutex_lock (&ring->lock);
+    head = ring->head;
+    g_mutex_unlock (&ring->lock);
+
+    return head;
+}
+
+static UcadRingSlot *
+get_slot (UcadRing *ring, guint64 sequence)
+{
+    return &ring->slots[sequence % ring->num_slots];
+}
+
+static void
+ucad_ring_get_range_unlocked (UcadRing *ring, guint64 *first, guint64 *last)
+{
+    /* The slot following head is the one being written */
+    *first = ring->head + 2 > ring->num_slots ? ring->head + 2 - ring->num_slots : 1;
+    *last = ring->head;
+}
+
+/**
+ * Return the buffer of the next frame. It must be passed on with
+ * ucad_ring_end_write() before the next call.
+ */
+gpointer
+ucad_ring_begin_write (UcadRing *ring)
+{
+    UcadRingSlot *slot;
+
+    g_mutex_lock (&ring->lock);
+    ring->discarding = ring->frozen;
+    g_mutex_unlock (&ring->lock);
+
+    if (ring->discarding) {
+        if (ring->discard == NULL)
+            ring->discard = g_malloc (ring->frame_size);
+
+        return ring->discard;
+    }
+
+    /* Only the producer changes head, so it can be read without lock */
+    slot = get_slot (ring, ring->head + 1);
+    g_rw_lock_writer_lock (&slot->lock);
+    slot->sequence = 0;
+
+    return slot->data;
+}
+
+/**
+ * Finish writing the frame and make it available to readers if publish is
+ * TRUE. Otherwise the slot is left invalid. The generation and grab times of
+ * info are handed to readers with the frame, the ring sets the others.
+ */
+void
+ucad_ring_end_write (UcadRing *ring, gboolean publish, const UcadRingFrameInfo *info)
+{
+    UcadRingSlot *slot;
+
+    if (ring->discarding)
+        return;
+
+    slot = get_slot (ring, ring->head + 1);
+
+    g_mutex_lock (&ring->lock);
+    publish = publish && !ring->frozen;
+    g_mutex_unlock (&ring->lock);
+
+    if (publish) {
+        slot->sequence = ring->head + 1;
+        slot->timestamp = g_get_real_time ();
+        slot->generation = info->generation;
+        slot->grab_start = info->grab_start;
+        slot->grab_end = info->grab_end;
+    }
+
+    g_rw_lock_writer_unlock (&slot->lock);
+
+    if (publish) {
+        g_mutex_lock (&ring->lock);
+        ring->head++;
+        g_cond_broadcast (&ring->published);
+        g_mutex_unlock (&ring->lock);
+    }
+}
+
+/**
+ * Wake up all readers waiting for a frame and let further reads fail once all
+ * frames were read.
+ */
+void
+ucad_ring_close (UcadRing *ring)
+{
+    g_mutex_lock (&ring->lock);
+    ring->closed = TRUE;
+    g_cond_broadcast (&ring->published);
+    g_mutex_unlock (&ring->lock);
+}
+
+/**
+ * Stop overwriting frames, newly grabbed ones are discarded until
+ * ucad_ring_thaw() is called. first and last are set to the range of
+ * sequences that can be read with ucad_ring_read_sequence(); last is 0 if
+ * there is none.
+ */
+void
+ucad_ring_freeze (UcadRing *ring, guint64 *first, guint64 *last)
+{
+    g_mutex_lock (&ring->lock);
+    ring->frozen = TRUE;
+    ucad_ring_get_range_unlocked (ring, first, last);
+    g_mutex_unlock (&ring->lock);
+}
+
+void
+ucad_ring_thaw (UcadRing *ring)
+{
+    g_mutex_lock (&ring->lock);
+    ring->frozen = FALSE;
+    g_mutex_unlock (&ring->lock);
+}
+
+gboolean
+ucad_ring_is_frozen (UcadRing *ring)
+{
+    gboolean frozen;
+
+    g_mutex_lock (&ring->lock);
+    frozen = ring->frozen;
+    g_mutex_unlock (&ring->lock);
+
+    return frozen;
+}
+
+void
+ucad_ring_get_range (UcadRing *ring, guint64 *first, guint64 *last)
+{
+    g_mutex_lock (&ring->lock);
+    ucad_ring_get_range_unlocked (ring, first, last);
+    g_mutex_unlock (&ring->lock);
+}
+
+/**
+ * Copy the frame with the given sequence into dst. Fails if it was not
+ * acquired yet or has been overwritten.
+ */
+gboolean
+ucad_ring_read_sequence (UcadRing *ring, guint64 sequence, gpointer dst, UcadRingFrameInfo *info, GError **error)
+{
+    UcadRingSlot *slot;
+    gboolean found;
+
+    slot = get_slot (ring, sequence);
+    g_rw_lock_reader_lock (&slot->lock);
+    found = sequence != 0 && slot->sequence == sequence;
+
+    if (found) {
+        memcpy (dst, slot->data, ring->frame_size);
+
+        if (info != NULL) {
+            info->sequence = sequence;
+            info->timestamp = slot->timestamp;
+            info->generation = slot->generation;
+            info->grab_start = slot->grab_start;
+            info->grab_end = slot->grab_end;
+        }
+    }
+
+    g_rw_lock_reader_unlock (&slot->lock);
+
+    if (!found)
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                     "Frame %" G_GUINT64_FORMAT " is not available", sequence);
+
+    return found;
+}
+
+/*
+ * Return the sequence to read for cursor or 0 if there is none yet. Must be
+ * called with the ring lock held.
+ */
+static guint64
+select_sequence (UcadRing *ring, UcadRingCursor *cursor, UcadRingPosition position)
+{
+    guint64 oldest, last;
+
+    if (cursor->next == 0)
+        cursor->next = position == UCAD_RING_LATEST && ring->head > 0 ? ring->head : ring->head + 1;
+
+    if (ring->head < cursor->next)
+        return 0;
+
+    if (position == UCAD_RING_LATEST)
+        return ring->head;
+
+    ucad_ring_get_range_unlocked (ring, &oldest, &last);
+
+    if (cursor->next < oldest) {
+        cursor->dropped += oldest - cursor->next;
+        cursor->next = oldest;
+    }
+
+    return cursor->next;
+}
+
+/**
+ * Copy the frame at position relative to cursor into dst, waiting for it to
+ * be published if necessary, and advance the cursor past it. Fails once the
+ * ring is closed and no frame is left for the cursor, and as soon as the
+ * cancelled flag is set. Without a cancelled flag, which could end waiting
+ * for a frozen ring to be thawed, that fails right away.
+ */
+gboolean
+ucad_ring_read (UcadRing *ring, UcadRingCursor *cursor, UcadRingPosition position,
+                gpointer dst, UcadRingFrameInfo *info, const gint *cancelled, GError **error)
+{
+    while (TRUE) {
+        UcadRingSlot *slot;
+        guint64 sequence;
+        gboolean frozen = FALSE;
+        gboolean stopped = FALSE;
+
+        g_mutex_lock (&ring->lock);
+
+        while ((sequence = select_sequence (ring, cursor, position)) == 0 && !ring->closed) {
+            frozen = ring->frozen && cancelled == NULL;
+            stopped = cancelled != NULL && g_atomic_int_get (cancelled);
+
+            if (frozen || stopped)
+                break;
+
+            /* Woken up now and then to look at the cancelled flag */
+            g_cond_wait_until (&ring->published, &ring->lock,
+                               g_get_monotonic_time () + UCAD_RING_POLL_INTERVAL);
+        }
+
+        g_mutex_unlock (&ring->lock);
+
+        if (sequence == 0) {
+            if (stopped)
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Reading stopped");
+            else if (frozen)
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                                     "Frame history is frozen, no new frames are acquired until it is released");
+            else
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED, "Acquisition stopped");
+
+            return FALSE;
+        }
+
+        slot = get_slot (ring, sequence);
+        g_rw_lock_reader_lock (&slot->lock);
+
+        if (slot->sequence == sequence) {
+            memcpy (dst, slot->data, ring->frame_size);
+
+            if (info != NULL) {
+                info->sequence = sequence;
+                info->timestamp = slot->timestamp;
+                info->generation = slot->generation;
+                info->grab_start = slot->grab_start;
+                info->grab_end = slot->grab_end;
+            }
+
+            g_rw_lock_reader_unlock (&slot->lock);
+            cursor->next = sequence + 1;
+            return TRUE;
+        }
+
+        /* Overwritten while we were waiting for the slot, try again */
+        g_rw_lock_reader_unlock (&slot->lock);
+    }
+}
@@ -0,0 +1,82 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#ifndef UCAD_RING_H
+#define UCAD_RING_H
+
+#include <glib.h>
+
+/*
+ * Ring of frames written by a single producer and read by any number of
+ * consumers, each with its own cursor. Frames are numbered by a sequence
+ * starting at 1. Readers copy frames out, so a slow reader only loses frames
+ * that were overwritten in the meantime and never blocks other readers.
+ * A frozen ring keeps its frames as history and discards new ones.
+ */
+typedef struct _UcadRing UcadRing;
+
+typedef enum {
+    UCAD_RING_NEXT = 0,     /* Next frame after the previously read one */
+    UCAD_RING_LATEST,       /* Most recent frame not read yet */
+} UcadRingPosition;
+
+typedef struct {
+    guint64 next;       /* Sequence of the next frame to read (0: next published one) */
+    guint64 dropped;    /* Frames overwritten before they could be read */
+} UcadRingCursor;
+
+typedef struct {
+    guint64 sequence;
+    gint64 timestamp;   /* Real time at which the frame was published */
+    guint64 generation; /* Configuration generation the frame was acquired with */
+    gint64 grab_start;  /* Monotonic times around grabbing it from the camera */
+    gint64 grab_end;
+} UcadRingFrameInfo;
+
+UcadRing   *ucad_ring_new           (guint num_slots,
+                                     gsize frame_size,
+                                     gboolean hugepages);
+void        ucad_ring_free          (UcadRing *ring);
+gsize       ucad_ring_get_frame_size (UcadRing *ring);
+guint       ucad_ring_get_num_slots (UcadRing *ring);
+guint64     ucad_ring_get_head      (UcadRing *ring);
+gpointer    ucad_ring_begin_write   (UcadRing *ring);
+void        ucad_ring_end_write     (UcadRing *ring,
+                                     gboolean publish,
+                                     const UcadRingFrameInfo *info);
+void        ucad_ring_close         (UcadRing *ring);
+void        ucad_ring_freeze        (UcadRing *ring,
+                                     guint64 *first,
+                                     guint64 *last);
+void        ucad_ring_thaw          (UcadRing *ring);
+gboolean    ucad_ring_is_frozen     (UcadRing *ring);
+void        ucad_ring_get_range     (UcadRing *ring,
+                                     guint64 *first,
+                                     guint64 *last);
+gboolean    ucad_ring_read_sequence (UcadRing *ring,
+                                     guint64 sequence,
+                                     gpointer dst,
+                                     UcadRingFrameInfo *info,
+                                     GError **error);
+gboolean    ucad_ring_read          (UcadRing *ring,
+                                     UcadRingCursor *cursor,
+                                     UcadRingPosition position,
+                                     gpointer dst,
+                                     UcadRingFrameInfo *info,
+                                     const gint *cancelled,
+                                     GError **error);
+
+#endif
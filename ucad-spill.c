@@ -0,0 +1,252 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+#include "ucad-spill.h"
+#include "config.h"
+
+#ifdef HAVE_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* Alignment of offsets, sizes and buffers for direct I/O */
+#define UCAD_SPILL_ALIGNMENT 4096
+
+typedef struct {
+    gchar *data;
+    gsize size;
+} UcadSpillBuffer;
+
+struct _UcadSpill {
+    gint fd;
+    goffset end;
+    gboolean direct;
+    /* Writing and reading happen in different threads */
+    UcadSpillBuffer write_buffer;
+    UcadSpillBuffer read_buffer;
+};
+
+#ifdef HAVE_UNIX
+
+static gsize
+align (gsize size)
+{
+    return (size + UCAD_SPILL_ALIGNMENT - 1) & ~((gsize) UCAD_SPILL_ALIGNMENT - 1);
+}
+
+static gchar *
+get_buffer (UcadSpillBuffer *buffer, gsize size)
+{
+    if (buffer->size < size) {
+        free (buffer->data);
+        buffer->data = NULL;
+        buffer->size = 0;
+
+        if (posix_memalign ((void **) &buffer->data, UCAD_SPILL_ALIGNMENT, size))
+            return NULL;
+
+        buffer->size = size;
+    }
+
+    return buffer->data;
+}
+
+/**
+ * Create the spill file in directory. It is unlinked right away and vanishes
+ * when freed.
+ */
+UcadSpill *
+ucad_spill_new (const gchar *directory, GError **error)
+{
+    UcadSpill *spill;
+    gchar *path;
+    gint fd;
+
+    path = g_build_filename (directory, "ucad-spill-XXXXXX", NULL);
+    fd = g_mkstemp (path);
+
+    if (fd < 0) {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                     "Could not create spill file in `%s': %s", directory, g_strerror (errno));
+        g_free (path);
+        return NULL;
+    }
+
+    unlink (path);
+    g_free (path);
+
+    spill = g_new0 (UcadSpill, 1);
+    spill->fd = fd;
+
+#ifdef O_DIRECT
+    spill->direct = fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_DIRECT) == 0;
+#endif
+
+    if (!spill->direct)
+        g_debug ("Direct I/O not supported in `%s'", directory);
+
+    return spill;
+}
+
+void
+ucad_spill_free (UcadSpill *spill)
+{
+    if (spill == NULL)
+        return;
+
+    close (spill->fd);
+    free (spill->write_buffer.data);
+    free (spill->read_buffer.data);
+    g_free (spill);
+}
+
+/**
+ * Append size bytes of data as one record and return its offset. Records are
+ * padded to the direct I/O alignment.
+ */
+gboolean
+ucad_spill_write (UcadSpill *spill, gconstpointer data, gsize size, goffset *offset, GError **error)
+{
+    gsize aligned = align (size);
+    gsize written = 0;
+    const gchar *source = data;
+
+    if (spill->direct) {
+        gchar *buffer = get_buffer (&spill->write_buffer, aligned);
+
+        if (buffer == NULL) {
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not allocate spill buffer");
+            return FALSE;
+        }
+
+        memcpy (buffer, data, size);
+        memset (buffer + size, 0, aligned - size);
+        source = buffer;
+    }
+    else {
+        aligned = size;
+    }
+
+    while (written < aligned) {
+        gssize result = pwrite (spill->fd, source + written, aligned - written, spill->end + written);
+
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+
+            g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                         "Could not spill frame: %s", g_strerror (errno));
+            return FALSE;
+        }
+
+        written += result;
+    }
+
+    *offset = spill->end;
+    spill->end += align (aligned);
+
+    return TRUE;
+}
+
+gboolean
+ucad_spill_read (UcadSpill *spill, goffset offset, gpointer data, gsize size, GError **error)
+{
+    gsize aligned = spill->direct ? align (size) : size;
+    gchar *target = data;
+    gsize read = 0;
+
+    if (spill->direct && (target = get_buffer (&spill->read_buffer, aligned)) == NULL) {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED, "Could not allocate spill buffer");
+        return FALSE;
+    }
+
+    while (read < aligned) {
+        gssize result = pread (spill->fd, target + read, aligned - read, offset + read);
+
+        if (result <= 0) {
+            if (result < 0 && errno == EINTR)
+                continue;
+
+            g_set_error (error, G_IO_ERROR, result < 0 ? g_io_error_from_errno (errno) : G_IO_ERROR_FAILED,
+                         "Could not read spilled frame: %s", result < 0 ? g_strerror (errno) : "end of file");
+            return FALSE;
+        }
+
+        read += result;
+    }
+
+    if (spill->direct)
+        memcpy (data, target, size);
+
+    return TRUE;
+}
+
+/**
+ * Discard all records once they were read, so that the file does not grow
+ * beyond the largest backlog.
+ */
+void
+ucad_spill_reset (UcadSpill *spill)
+{
+    spill->end = 0;
+
+    if (ftruncate (spill->fd, 0) < 0)
+        g_debug ("Could not truncate spill file: %s", g_strerror (errno));
+}
+
+#else
+
+UcadSpill *
+ucad_spill_new (const gchar *directory, GError **error)
+{
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                         "Spilling frames is not supported on this platform");
+    return NULL;
+}
+
+void
+ucad_spill_free (UcadSpill *spill)
+{
+    g_free (spill);
+}
+
+gboolean
+ucad_spill_write (UcadSpill *spill, gconstpointer data, gsize size, goffset *offset, GError **error)
+{
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                         "Spilling frames is not supported on this platform");
+    return FALSE;
+}
+
+gboolean
+ucad_spill_read (UcadSpill *spill, goffset offset, gpointer data, gsize size, GError **error)
+{
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                         "Spilling frames is not supported on this platform");
+    return FALSE;
+}
+
+void
+ucad_spill_reset (UcadSpill *spill)
+{
+}
+
+#endif
@@ -0,0 +1,45 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#ifndef UCAD_SPILL_H
+#define UCAD_SPILL_H
+
+#include <glib.h>
+
+/*
+ * Anonymous file in a local directory which frames of a slow endpoint are
+ * appended to and read back from in order. Records are written with direct
+ * I/O where the file system supports it, so that spilling does not evict
+ * the page cache.
+ */
+typedef struct _UcadSpill UcadSpill;
+
+UcadSpill  *ucad_spill_new      (const gchar *directory,
+                                 GError **error);
+void        ucad_spill_free     (UcadSpill *spill);
+gboolean    ucad_spill_write    (UcadSpill *spill,
+                                 gconstpointer data,
+                                 gsize size,
+                                 goffset *offset,
+                                 GError **error);
+gboolean    ucad_spill_read     (UcadSpill *spill,
+                                 goffset offset,
+                                 gpointer data,
+                                 gsize size,
+                                 GError **error);
+void        ucad_spill_reset    (UcadSpill *spill);
+
+#endif
@@ -0,0 +1,388 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#include <stdarg.h>
+#include <string.h>
+#include <gio/gio.h>
+#include "ucad-stats.h"
+
+/* Buckets up to 1 us, 2 us, ..., 2^24 us (about 17 s) and one beyond */
+#define UCAD_STATS_NUM_BUCKETS  26
+
+struct _UcadStatsMetric {
+    UcadStatsKind kind;
+    gchar *name;
+    gchar *help;
+    gchar *labels;
+
+    /* 64 bit values, which not every platform updates atomically */
+    GMutex lock;
+    gint64 value;
+    guint64 sum;
+    guint64 buckets[UCAD_STATS_NUM_BUCKETS];
+
+    /* State of the previous summary, only used with the registry locked */
+    gint64 last_value;
+    guint64 last_sum;
+    guint64 last_buckets[UCAD_STATS_NUM_BUCKETS];
+};
+
+static GMutex registry_lock;
+static GPtrArray *registry = NULL;
+static gint64 last_summary = 0;
+
+static const gchar *kind_names[] = { "counter", "gauge", "histogram" };
+
+static void
+append_escaped (GString *string, const gchar *value)
+{
+    for (; *value != '\0'; value++) {
+        if (*value == '\\' || *value == '"')
+            g_string_append_c (string, '\\');
+
+        if (*value == '\n')
+            g_string_append (string, "\\n");
+        else
+            g_string_append_c (string, *value);
+    }
+}
+
+/**
+ * Build the label set of a metric from NULL-terminated key and value pairs,
+ * e.g. camera="mock",endpoint="tcp://host:5555".
+ */
+gchar *
+ucad_stats_labels (const gchar *first_key, ...)
+{
+    GString *labels;
+    const gchar *key;
+    va_list args;
+
+    labels = g_string_new (NULL);
+    va_start (args, first_key);
+
+    for (key = first_key; key != NULL; key = va_arg (args, const gchar *)) {
+        if (labels->len > 0)
+            g_string_append_c (labels, ',');
+
+        g_string_append_printf (labels, "%s=\"", key);
+        append_escaped (labels, va_arg (args, const gchar *));
+        g_string_append_c (labels, '"');
+    }
+
+    va_end (args);
+
+    return g_string_free (labels, FALSE);
+}
+
+/**
+ * Create and register a metric. Metrics of the same name must have the same
+ * kind and help and differ in their labels, which may be NULL.
+ */
+UcadStatsMetric *
+ucad_stats_metric_new (UcadStatsKind kind, const gchar *name, const gchar *help, const gchar *labels)
+{
+    UcadStatsMetric *metric;
+
+    metric = g_new0 (UcadStatsMetric, 1);
+    metric->kind = kind;
+    metric->name = g_strdup (name);
+    metric->help = g_strdup (help);
+    metric->labels = g_strdup (labels != NULL ? labels : "");
+    g_mutex_init (&metric->lock);
+
+    g_mutex_lock (&registry_lock);
+
+    if (registry == NULL) {
+        registry = g_ptr_array_new ();
+        last_summary = g_get_monotonic_time ();
+    }
+
+    g_ptr_array_add (registry, metric);
+    g_mutex_unlock (&registry_lock);
+
+    return metric;
+}
+
+void
+ucad_stats_metric_free (UcadStatsMetric *metric)
+{
+    if (metric == NULL)
+        return;
+
+    g_mutex_lock (&registry_lock);
+    g_ptr_array_remove (registry, metric);
+    g_mutex_unlock (&registry_lock);
+
+    g_free (metric->name);
+    g_free (metric->help);
+    g_free (metric->labels);
+    g_mutex_clear (&metric->lock);
+    g_free (metric);
+}
+
+void
+ucad_stats_add (UcadStatsMetric *metric, guint64 value)
+{
+    g_mutex_lock (&metric->lock);
+    metric->value += (gint64) value;
+    g_mutex_unlock (&metric->lock);
+}
+
+void
+ucad_stats_set (UcadStatsMetric *metric, gint64 value)
+{
+    g_mutex_lock (&metric->lock);
+    metric->value = value;
+    g_mutex_unlock (&metric->lock);
+}
+
+/**
+ * Count a duration in microseconds as taken from g_get_monotonic_time.
+ */
+void
+ucad_stats_observe (UcadStatsMetric *metric, gint64 duration)
+{
+    guint bucket = 0;
+
+    duration = MAX (duration, 0);
+
+    if (duration > 1)
+        bucket = MIN (g_bit_storage ((gulong) duration - 1), UCAD_STATS_NUM_BUCKETS - 1);
+
+    g_mutex_lock (&metric->lock);
+    metric->buckets[bucket]++;
+    metric->sum += (guint64) duration;
+    g_mutex_unlock (&metric->lock);
+}
+
+/* Consistent copy of the value or the buckets and sum of a metric */
+static void
+get_values (UcadStatsMetric *metric, gint64 *value, guint64 *buckets, guint64 *sum)
+{
+    g_mutex_lock (&metric->lock);
+    *value = metric->value;
+    *sum = metric->sum;
+    memcpy (buckets, metric->buckets, sizeof (metric->buckets));
+    g_mutex_unlock (&metric->lock);
+}
+
+static gdouble
+get_bucket_bound (guint bucket)
+{
+    return (gdouble) (G_GUINT64_CONSTANT (1) << bucket) / G_USEC_PER_SEC;
+}
+
+static void
+append_sample (GString *string, const gchar *name, const gchar *suffix, const gchar *labels,
+               const gchar *extra, gdouble value)
+{
+    gchar number[G_ASCII_DTOSTR_BUF_SIZE];
+
+    g_string_append_printf (string, "%s%s", name, suffix);
+
+    if (*labels != '\0' || extra != NULL)
+        g_string_append_printf (string, "{%s%s%s}", labels,
+                                *labels != '\0' && extra != NULL ? "," : "",
+                                extra != NULL ? extra : "");
+
+    g_string_append_printf (string, " %s\n", g_ascii_dtostr (number, sizeof (number), value));
+}
+
+static void
+append_metric (GString *string, UcadStatsMetric *metric)
+{
+    guint64 buckets[UCAD_STATS_NUM_BUCKETS];
+    guint64 cumulative = 0;
+    guint64 sum;
+    gint64 value;
+
+    get_values (metric, &value, buckets, &sum);
+
+    if (metric->kind != UCAD_STATS_HISTOGRAM) {
+        append_sample (string, metric->name, "", metric->labels, NULL, (gdouble) value);
+        return;
+    }
+
+    for (guint i = 0; i < UCAD_STATS_NUM_BUCKETS; i++) {
+        gchar number[G_ASCII_DTOSTR_BUF_SIZE];
+        gchar *le;
+
+        cumulative += buckets[i];
+
+        if (i < UCAD_STATS_NUM_BUCKETS - 1)
+            le = g_strdup_printf ("le=\"%s\"", g_ascii_dtostr (number, sizeof (number), get_bucket_bound (i)));
+        else
+            le = g_strdup ("le=\"+Inf\"");
+
+        append_sample (string, metric->name, "_bucket", metric->labels, le, (gdouble) cumulative);
+        g_free (le);
+    }
+
+    append_sample (string, metric->name, "_sum", metric->labels, NULL, sum / (gdouble) G_USEC_PER_SEC);
+    append_sample (string, metric->name, "_count", metric->labels, NULL, (gdouble) cumulative);
+}
+
+/**
+ * Export all metrics in the Prometheus text format, grouped by name.
+ */
+gchar *
+ucad_stats_to_prometheus (void)
+{
+    GString *string;
+    GHashTable *written;
+
+    string = g_string_new (NULL);
+    written = g_hash_table_new (g_str_hash, g_str_equal);
+    g_mutex_lock (&registry_lock);
+
+    for (guint i = 0; registry != NULL && i < registry->len; i++) {
+        UcadStatsMetric *first = g_ptr_array_index (registry, i);
+
+        if (g_hash_table_contains (written, first->name))
+            continue;
+
+        g_hash_table_add (written, first->name);
+        g_string_append_printf (string, "# HELP %s %s\n# TYPE %s %s\n",
+                                first->name, first->help, first->name, kind_names[first->kind]);
+
+        for (guint j = i; j < registry->len; j++) {
+            UcadStatsMetric *metric = g_ptr_array_index (registry, j);
+
+            if (!g_strcmp0 (metric->name, first->name))
+                append_metric (string, metric);
+        }
+    }
+
+    g_mutex_unlock (&registry_lock);
+    g_hash_table_destroy (written);
+
+    return g_string_free (string, FALSE);
+}
+
+/**
+ * Replace filename with the current metrics, atomically so that a collector
+ * never reads a partial file.
+ */
+gboolean
+ucad_stats_write_file (const gchar *filename, GError **error)
+{
+    gchar *contents;
+    gboolean success;
+
+    contents = ucad_stats_to_prometheus ();
+    success = g_file_set_contents (filename, contents, -1, error);
+    g_free (contents);
+
+    return success;
+}
+
+static void
+append_duration (GString *string, const gchar *what, gdouble seconds)
+{
+    if (seconds < 1e-3)
+        g_string_append_printf (string, ", %s %.1f us", what, seconds * 1e6);
+    else if (seconds < 1.0)
+        g_string_append_printf (string, ", %s %.2f ms", what, seconds * 1e3);
+    else
+        g_string_append_printf (string, ", %s %.2f s", what, seconds);
+}
+
+/* Upper bound of the bucket holding quantile q of the observations since the
+ * previous summary */
+static gdouble
+get_quantile (const guint64 *buckets, guint64 count, gdouble q)
+{
+    guint64 cumulative = 0;
+
+    for (guint i = 0; i < UCAD_STATS_NUM_BUCKETS - 1; i++) {
+        cumulative += buckets[i];
+
+        if (cumulative >= q * count)
+            return get_bucket_bound (i);
+    }
+
+    return get_bucket_bound (UCAD_STATS_NUM_BUCKETS - 1);
+}
+
+static void
+append_summary (GString *string, UcadStatsMetric *metric, gdouble interval)
+{
+    guint64 totals[UCAD_STATS_NUM_BUCKETS];
+    guint64 sum;
+    gint64 value;
+
+    get_values (metric, &value, totals, &sum);
+    g_string_append_printf (string, "\n  %s%s%s%s: ", metric->name,
+                            *metric->labels != '\0' ? "{" : "", metric->labels,
+                            *metric->labels != '\0' ? "}" : "");
+
+    if (metric->kind == UCAD_STATS_HISTOGRAM) {
+        guint64 buckets[UCAD_STATS_NUM_BUCKETS];
+        guint64 count = 0;
+
+        for (guint i = 0; i < UCAD_STATS_NUM_BUCKETS; i++) {
+            buckets[i] = totals[i] - metric->last_buckets[i];
+            metric->last_buckets[i] = totals[i];
+            count += buckets[i];
+        }
+
+        g_string_append_printf (string, "%" G_GUINT64_FORMAT " (%.1f/s)", count, count / interval);
+
+        if (count > 0) {
+            append_duration (string, "mean", (sum - metric->last_sum) / (gdouble) count / G_USEC_PER_SEC);
+            append_duration (string, "p50 <=", get_quantile (buckets, count, 0.5));
+            append_duration (string, "p99 <=", get_quantile (buckets, count, 0.99));
+        }
+
+        metric->last_sum = sum;
+    }
+    else {
+        g_string_append_printf (string, "%" G_GINT64_FORMAT, value);
+
+        if (metric->kind == UCAD_STATS_COUNTER)
+            g_string_append_printf (string, " (%.1f/s)", (value - metric->last_value) / interval);
+
+        metric->last_value = value;
+    }
+}
+
+/**
+ * Describe all metrics for the log, with rates and latencies since the
+ * previous summary.
+ */
+gchar *
+ucad_stats_get_summary (void)
+{
+    GString *string;
+    gint64 now = g_get_monotonic_time ();
+    gdouble interval;
+
+    string = g_string_new ("Statistics");
+    g_mutex_lock (&registry_lock);
+
+    interval = (now - (last_summary != 0 ? last_summary : now)) / (gdouble) G_USEC_PER_SEC;
+    g_string_append_printf (string, " of the last %.1f s:", interval);
+    interval = MAX (interval, 1e-3);
+    last_summary = now;
+
+    for (guint i = 0; registry != NULL && i < registry->len; i++)
+        append_summary (string, g_ptr_array_index (registry, i), interval);
+
+    g_mutex_unlock (&registry_lock);
+
+    return g_string_free (string, FALSE);
+}
@@ -0,0 +1,55 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#ifndef UCAD_STATS_H
+#define UCAD_STATS_H
+
+#include <glib.h>
+
+/*
+ * Counters, gauges and latency histograms, each with its own lock which is only
+ * held to update or copy its values, so that the grabbing and sending threads
+ * never wait for metrics being formatted or for other metrics. All metrics are
+ * registered globally and exported together in the Prometheus text format or
+ * as a summary for the log.
+ */
+typedef struct _UcadStatsMetric UcadStatsMetric;
+
+typedef enum {
+    UCAD_STATS_COUNTER,
+    UCAD_STATS_GAUGE,
+    UCAD_STATS_HISTOGRAM,   /* Durations in microseconds, exported in seconds */
+} UcadStatsKind;
+
+gchar           *ucad_stats_labels          (const gchar *first_key,
+                                             ...) G_GNUC_NULL_TERMINATED;
+UcadStatsMetric *ucad_stats_metric_new      (UcadStatsKind kind,
+                                             const gchar *name,
+                                             const gchar *help,
+                                             const gchar *labels);
+void             ucad_stats_metric_free     (UcadStatsMetric *metric);
+void             ucad_stats_add             (UcadStatsMetric *metric,
+                                             guint64 value);
+void             ucad_stats_set             (UcadStatsMetric *metric,
+                                             gint64 value);
+void             ucad_stats_observe         (UcadStatsMetric *metric,
+                                             gint64 duration);
+gchar           *ucad_stats_to_prometheus   (void);
+gboolean         ucad_stats_write_file      (const gchar *filename,
+                                             GError **error);
+gchar           *ucad_stats_get_summary     (void);
+
+#endif
@@ -0,0 +1,178 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#include <gio/gio.h>
+#include "ucad-trace.h"
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    const gchar *name;
+    gint64 start;
+    gint64 end;
+    guint64 thread;
+    guint64 frame;
+    guint64 size;
+} UcadTraceEvent;
+
+gint ucad_trace_recording = FALSE;
+
+#ifdef HAVE_SYS_SDT_H
+#define UCAD_PROBE_DEFINE_SEMAPHORE(name) \
+    __extension__ UCAD_PROBE_SEMAPHORE (name) __attribute__ ((unused)) __attribute__ ((section (".probes")))
+
+UCAD_PROBE_DEFINE_SEMAPHORE (acquire);
+UCAD_PROBE_DEFINE_SEMAPHORE (grab);
+UCAD_PROBE_DEFINE_SEMAPHORE (tcp_send);
+UCAD_PROBE_DEFINE_SEMAPHORE (push_grab);
+UCAD_PROBE_DEFINE_SEMAPHORE (push_frame);
+UCAD_PROBE_DEFINE_SEMAPHORE (wait_for_all);
+UCAD_PROBE_DEFINE_SEMAPHORE (push);
+UCAD_PROBE_DEFINE_SEMAPHORE (zmq_header);
+UCAD_PROBE_DEFINE_SEMAPHORE (zmq_send);
+UCAD_PROBE_DEFINE_SEMAPHORE (record);
+UCAD_PROBE_DEFINE_SEMAPHORE (request_wait);
+UCAD_PROBE_DEFINE_SEMAPHORE (request);
+#endif
+
+/* Each window gets its own events, which ucad_trace_stop frees once no thread
+ * records into them anymore */
+static UcadTraceEvent *events = NULL;
+static guint num_events = 0;
+static gint next_event = 0;
+static gint num_writers = 0;
+
+static guint64
+get_thread_id (void)
+{
+#if defined(__linux__) && defined(SYS_gettid)
+    /* Same ids as perf and bpftrace report */
+    return (guint64) syscall (SYS_gettid);
+#else
+    return (guint64) (gsize) g_thread_self ();
+#endif
+}
+
+/**
+ * Open a trace window holding up to max_events spans, later ones are
+ * dropped. Returns FALSE if a window is already open.
+ */
+gboolean
+ucad_trace_start (guint max_events)
+{
+    if (g_atomic_int_get (&ucad_trace_recording))
+        return FALSE;
+
+    num_events = MAX (max_events, 1);
+    events = g_new0 (UcadTraceEvent, num_events);
+    g_atomic_int_set (&next_event, 0);
+    g_atomic_int_set (&ucad_trace_recording, TRUE);
+
+    return TRUE;
+}
+
+/**
+ * Record a span from start to end in the open window. Spans are claimed with
+ * a single atomic increment, so that recording threads never wait for each
+ * other. Threads announce themselves before looking at the window, so that
+ * ucad_trace_stop can wait for those which saw it open.
+ */
+void
+ucad_trace_record (const gchar *name, gint64 start, gint64 end, guint64 frame, guint64 size)
+{
+    UcadTraceEvent *event;
+    guint index;
+
+    g_atomic_int_inc (&num_writers);
+
+    /* Unless the window closed since the caller checked */
+    if (g_atomic_int_get (&ucad_trace_recording)) {
+        index = (guint) g_atomic_int_add (&next_event, 1);
+
+        if (index < num_events) {
+            event = &events[index];
+            event->name = name;
+            event->start = start;
+            event->end = end;
+            event->thread = get_thread_id ();
+            event->frame = frame;
+            event->size = size;
+        }
+    }
+
+    g_atomic_int_add (&num_writers, -1);
+}
+
+/**
+ * Close the window and write its spans to filename in the Chrome trace event
+ * format, once the threads still recording into it are done.
+ */
+gboolean
+ucad_trace_stop (const gchar *filename, GError **error)
+{
+    GString *json;
+    guint num_recorded;
+    guint num_dropped;
+    guint pid = 0;
+    gboolean success;
+
+    if (!g_atomic_int_get (&ucad_trace_recording))
+        return TRUE;
+
+    g_atomic_int_set (&ucad_trace_recording, FALSE);
+
+    /* Threads which saw the window open finish their spans, later ones leave
+     * it alone */
+    while (g_atomic_int_get (&num_writers) > 0)
+        g_thread_yield ();
+
+    num_recorded = MIN ((guint) g_atomic_int_get (&next_event), num_events);
+    num_dropped = (guint) g_atomic_int_get (&next_event) - num_recorded;
+
+#ifdef __linux__
+    pid = (guint) getpid ();
+#endif
+
+    json = g_string_new ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    for (guint i = 0; i < num_recorded; i++) {
+        UcadTraceEvent *event = &events[i];
+
+        g_string_append_printf (json,
+                                "%s\n{\"name\":\"%s\",\"cat\":\"ucad\",\"ph\":\"X\",\"pid\":%u,"
+                                "\"tid\":%" G_GUINT64_FORMAT ",\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ","
+                                "\"args\":{\"frame\":%" G_GUINT64_FORMAT ",\"size\":%" G_GUINT64_FORMAT "}}",
+                                json->str[json->len - 1] == '[' ? "" : ",",
+                                event->name, pid, event->thread, event->start, event->end - event->start,
+                                event->frame, event->size);
+    }
+
+    g_string_append (json, "\n]}\n");
+    success = g_file_set_contents (filename, json->str, (gssize) json->len, error);
+
+    if (success)
+        g_message ("Wrote %u spans to `%s'%s", num_recorded, filename,
+                   num_dropped > 0 ? ", the window was full" : "");
+
+    g_string_free (json, TRUE);
+    g_free (events);
+    events = NULL;
+
+    return success;
+}
@@ -0,0 +1,89 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#ifndef UCAD_TRACE_H
+#define UCAD_TRACE_H
+
+#include <glib.h>
+#include "config.h"
+
+#ifdef HAVE_SYS_SDT_H
+/* Tracers increment the semaphore of a probe while attached to it */
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define UCAD_PROBE(name, frame, size, duration) DTRACE_PROBE3 (ucad, name, frame, size, duration)
+#define UCAD_PROBE_ENABLED(name) G_UNLIKELY (ucad_##name##_semaphore != 0)
+#define UCAD_PROBE_SEMAPHORE(name) volatile unsigned short ucad_##name##_semaphore
+
+/* Every probe needs its semaphore here and in ucad-trace.c */
+extern UCAD_PROBE_SEMAPHORE (acquire);
+extern UCAD_PROBE_SEMAPHORE (grab);
+extern UCAD_PROBE_SEMAPHORE (tcp_send);
+extern UCAD_PROBE_SEMAPHORE (push_grab);
+extern UCAD_PROBE_SEMAPHORE (push_frame);
+extern UCAD_PROBE_SEMAPHORE (wait_for_all);
+extern UCAD_PROBE_SEMAPHORE (push);
+extern UCAD_PROBE_SEMAPHORE (zmq_header);
+extern UCAD_PROBE_SEMAPHORE (zmq_send);
+extern UCAD_PROBE_SEMAPHORE (record);
+extern UCAD_PROBE_SEMAPHORE (request_wait);
+extern UCAD_PROBE_SEMAPHORE (request);
+#else
+#define UCAD_PROBE(name, frame, size, duration)
+#define UCAD_PROBE_ENABLED(name) FALSE
+#endif
+
+/*
+ * Spans of the frame path, each of which fires the static tracepoint
+ * ucad:name with the frame number, a size in bytes and the duration in
+ * microseconds as arguments, e.g. for
+ *
+ *   bpftrace -e 'usdt:/usr/bin/ucad:ucad:push_frame { @us = hist(arg2); }'
+ *
+ * Unless a tracer is attached or a trace window is open, a span costs no more
+ * than checking the semaphore and the recording flag, not even the clock is
+ * read. While a window is open, spans are recorded as well and written as a
+ * Chrome trace, which Perfetto and chrome://tracing open, once it closes.
+ */
+extern gint ucad_trace_recording;
+
+#define UCAD_TRACE(name, start, frame, size)                                        \
+    G_STMT_START {                                                                  \
+        gboolean _ucad_trace_recording = g_atomic_int_get (&ucad_trace_recording);  \
+                                                                                    \
+        if (UCAD_PROBE_ENABLED (name) || G_UNLIKELY (_ucad_trace_recording)) {      \
+            gint64 _ucad_trace_start = (start);                                     \
+            gint64 _ucad_trace_end = g_get_monotonic_time ();                       \
+            guint64 _ucad_trace_frame = (frame);                                    \
+            guint64 _ucad_trace_size = (size);                                      \
+            UCAD_PROBE (name, _ucad_trace_frame, _ucad_trace_size,                  \
+                        _ucad_trace_end - _ucad_trace_start);                       \
+            if (_ucad_trace_recording)                                              \
+                ucad_trace_record (#name, _ucad_trace_start, _ucad_trace_end,       \
+                                   _ucad_trace_frame, _ucad_trace_size);            \
+        }                                                                           \
+    } G_STMT_END
+
+gboolean    ucad_trace_start    (guint max_events);
+void        ucad_trace_record   (const gchar *name,
+                                 gint64 start,
+                                 gint64 end,
+                                 guint64 frame,
+                                 guint64 size);
+gboolean    ucad_trace_stop     (const gchar *filename,
+                                 GError **error);
+
+#endif
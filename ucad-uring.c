@@ -0,0 +1,317 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#include <string.h>
+#include "ucad-uring.h"
+#include "config.h"
+
+#ifdef HAVE_LIBURING
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <liburing.h>
+
+#define UCAD_URING_MAX_BUFFERS 4
+
+struct _UcadUring {
+    struct io_uring ring;
+    GMutex lock;
+    gboolean zerocopy;
+    struct iovec buffers[UCAD_URING_MAX_BUFFERS];
+    guint num_buffers;
+};
+
+UcadUring *
+ucad_uring_new (guint queue_depth, GError **error)
+{
+    UcadUring *ring;
+    struct io_uring_probe *probe;
+    gint result;
+
+    ring = g_new0 (UcadUring, 1);
+    result = io_uring_queue_init (queue_depth, &ring->ring, 0);
+
+    if (result < 0) {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (-result),
+                     "Could not set up io_uring: %s", g_strerror (-result));
+        g_free (ring);
+        return NULL;
+    }
+
+    probe = io_uring_get_probe_ring (&ring->ring);
+
+    if (probe != NULL) {
+        ring->zerocopy = io_uring_opcode_supported (probe, IORING_OP_SEND_ZC);
+        io_uring_free_probe (probe);
+    }
+
+    g_mutex_init (&ring->lock);
+
+    return ring;
+}
+
+void
+ucad_uring_free (UcadUring *ring)
+{
+    if (ring == NULL)
+        return;
+
+    io_uring_queue_exit (&ring->ring);
+    g_mutex_clear (&ring->lock);
+    g_free (ring);
+}
+
+gboolean
+ucad_uring_supports_zerocopy (UcadUring *ring)
+{
+    return ring->zerocopy;
+}
+
+/**
+ * Register the buffers frames are sent from, replacing the previously
+ * registered ones. Registration is skipped if the buffers did not change.
+ * Frames outside of registered buffers are still sent, only slower.
+ */
+void
+ucad_uring_register_buffers (UcadUring *ring, gpointer *buffers, gsize *sizes, guint num_buffers)
+{
+    struct iovec iov[UCAD_URING_MAX_BUFFERS];
+    guint n = 0;
+    gint result;
+
+    for (guint i = 0; i < num_buffers && n < UCAD_URING_MAX_BUFFERS; i++) {
+        if (buffers[i] != NULL) {
+            iov[n].iov_base = buffers[i];
+            iov[n].iov_len = sizes[i];
+            n++;
+        }
+    }
+
+    g_mutex_lock (&ring->lock);
+
+    if (n == ring->num_buffers && !memcmp (iov, ring->buffers, n * sizeof (struct iovec))) {
+        g_mutex_unlock (&ring->lock);
+        return;
+    }
+
+    if (ring->num_buffers > 0)
+        io_uring_unregister_buffers (&ring->ring);
+
+    ring->num_buffers = 0;
+
+    if (n > 0) {
+        result = io_uring_register_buffers (&ring->ring, iov, n);
+
+        if (result < 0) {
+            g_debug ("Could not register buffers: %s", g_strerror (-result));
+        }
+        else {
+            memcpy (ring->buffers, iov, n * sizeof (struct iovec));
+            ring->num_buffers = n;
+        }
+    }
+
+    g_mutex_unlock (&ring->lock);
+}
+
+static gint
+find_buffer (UcadUring *ring, gconstpointer data, gsize size)
+{
+    for (guint i = 0; i < ring->num_buffers; i++) {
+        const gchar *base = ring->buffers[i].iov_base;
+
+        if ((const gchar *) data >= base && (const gchar *) data + size <= base + ring->buffers[i].iov_len)
+            return (gint) i;
+    }
+
+    return -1;
+}
+
+/*
+ * Reap completions until the sends of this submission are complete. A
+ * zero-copy send completes twice, the second time once the kernel released
+ * the buffer, which must happen before it is overwritten by the next frame.
+ */
+static gint
+wait_completions (UcadUring *ring, guint num_sends, gssize *results)
+{
+    struct io_uring_cqe *cqe;
+    guint num_pending = num_sends;
+    guint num_notifications = 0;
+    gint result;
+
+    while (num_pending > 0 || num_notifications > 0) {
+        result = io_uring_wait_cqe (&ring->ring, &cqe);
+
+        if (result < 0)
+            return result;
+
+        if (cqe->flags & IORING_CQE_F_NOTIF) {
+            num_notifications--;
+        }
+        else {
+            results[cqe->user_data] = cqe->res;
+            num_pending--;
+
+            if (cqe->flags & IORING_CQE_F_MORE)
+                num_notifications++;
+        }
+
+        io_uring_cqe_seen (&ring->ring, cqe);
+    }
+
+    return 0;
+}
+
+static gboolean
+submit (UcadUring *ring, gint fd, gconstpointer header, gsize header_size,
+        gconstpointer data, gsize size, gboolean zerocopy, gssize *results, GError **error)
+{
+    struct io_uring_sqe *sqe;
+    guint num_sends = 0;
+    gint result;
+
+    if (header_size > 0) {
+        sqe = io_uring_get_sqe (&ring->ring);
+        io_uring_prep_send (sqe, fd, header, header_size, MSG_WAITALL);
+        sqe->user_data = num_sends++;
+
+        if (size > 0)
+            sqe->flags |= IOSQE_IO_LINK;
+    }
+
+    if (size > 0) {
+        gint index = find_buffer (ring, data, size);
+
+        sqe = io_uring_get_sqe (&ring->ring);
+
+        if (zerocopy && index >= 0)
+            io_uring_prep_send_zc_fixed (sqe, fd, data, size, MSG_WAITALL, 0, (guint) index);
+        else if (zerocopy)
+            io_uring_prep_send_zc (sqe, fd, data, size, MSG_WAITALL, 0);
+        else
+            io_uring_prep_send (sqe, fd, data, size, MSG_WAITALL);
+
+        sqe->user_data = num_sends++;
+    }
+
+    result = io_uring_submit (&ring->ring);
+
+    if (result >= 0)
+        result = wait_completions (ring, num_sends, results);
+
+    if (result < 0) {
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (-result),
+                     "io_uring submission failed: %s", g_strerror (-result));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Send header followed by data on connection with one submission. Short sends
+ * are completed with further submissions.
+ */
+gboolean
+ucad_uring_send (UcadUring *ring, GSocketConnection *connection, gconstpointer header, gsize header_size,
+                 gconstpointer data, gsize size, GError **error)
+{
+    gint fd;
+    gboolean success = TRUE;
+
+    fd = g_socket_get_fd (g_socket_connection_get_socket (connection));
+    g_mutex_lock (&ring->lock);
+
+    while (success && (header_size > 0 || size > 0)) {
+        gssize results[2] = { 0, 0 };
+        gssize sent_header, sent_data;
+
+        success = submit (ring, fd, header, header_size, data, size, ring->zerocopy, results, error);
+
+        if (!success)
+            break;
+
+        sent_header = header_size > 0 ? results[0] : 0;
+        sent_data = size > 0 ? results[header_size > 0 ? 1 : 0] : 0;
+
+        if (sent_data == -EOPNOTSUPP && ring->zerocopy) {
+            /* The socket does not support zero-copy, fall back to copying */
+            ring->zerocopy = FALSE;
+            sent_data = 0;
+        }
+        else if (sent_header < 0 || sent_data < 0) {
+            /* A short header send cancels the linked frame */
+            gint code = sent_header < 0 ? (gint) -sent_header : (gint) -sent_data;
+
+            if (code != ECANCELED) {
+                g_set_error (error, G_IO_ERROR, g_io_error_from_errno (code),
+                             "Sending failed: %s", g_strerror (code));
+                success = FALSE;
+                break;
+            }
+
+            sent_header = MAX (sent_header, 0);
+            sent_data = MAX (sent_data, 0);
+        }
+
+        header = (const gchar *) header + sent_header;
+        header_size -= (gsize) sent_header;
+        data = (const gchar *) data + sent_data;
+        size -= (gsize) sent_data;
+    }
+
+    g_mutex_unlock (&ring->lock);
+
+    return success;
+}
+
+#else
+
+UcadUring *
+ucad_uring_new (guint queue_depth, GError **error)
+{
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                         "ucad was built without io_uring support");
+    return NULL;
+}
+
+void
+ucad_uring_free (UcadUring *ring)
+{
+}
+
+gboolean
+ucad_uring_supports_zerocopy (UcadUring *ring)
+{
+    return FALSE;
+}
+
+void
+ucad_uring_register_buffers (UcadUring *ring, gpointer *buffers, gsize *sizes, guint num_buffers)
+{
+}
+
+gboolean
+ucad_uring_send (UcadUring *ring, GSocketConnection *connection, gconstpointer header, gsize header_size,
+                 gconstpointer data, gsize size, GError **error)
+{
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                         "ucad was built without io_uring support");
+    return FALSE;
+}
+
+#endif
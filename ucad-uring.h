@@ -0,0 +1,46 @@
+/* Copyright (C) 2026 Karlsruhe Institute of Technology
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by the
+   Free Software Foundation; either version 2.1 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+   details.
+
+   You should have received a copy of the GNU Lesser General Public License along
+   with this library; if not, write to the Free Software Foundation, Inc., 51
+   Franklin St, Fifth Floor, Boston, MA 02110, USA */
+
+#ifndef UCAD_URING_H
+#define UCAD_URING_H
+
+#include <gio/gio.h>
+
+/*
+ * io_uring based engine for sending a reply and the frame following it on a
+ * connection. Both are submitted together as linked requests, the frame with
+ * zero-copy send from registered buffers where the kernel supports it. A
+ * ring sends one frame at a time, each sending thread should have its own.
+ */
+typedef struct _UcadUring UcadUring;
+
+UcadUring  *ucad_uring_new                  (guint queue_depth,
+                                             GError **error);
+void        ucad_uring_free                 (UcadUring *ring);
+gboolean    ucad_uring_supports_zerocopy    (UcadUring *ring);
+void        ucad_uring_register_buffers     (UcadUring *ring,
+                                             gpointer *buffers,
+                                             gsize *sizes,
+                                             guint num_buffers);
+gboolean    ucad_uring_send                 (UcadUring *ring,
+                                             GSocketConnection *connection,
+                                             gconstpointer header,
+                                             gsize header_size,
+                                             gconstpointer data,
+                                             gsize size,
+                                             GError **error);
+
+#endif
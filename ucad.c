@@ -19,13 +19,28 @@
 #include <gio/gio.h>
 #include <string.h>
 #include <signal.h>
+#include <math.h>
 #include <uca/uca-camera.h>
 #include <uca/uca-plugin-manager.h>
 #include "uca-net-protocol.h"
+#include "uca-net-codec.h"
+#include "uca-net-pack.h"
+#include "ucad-uring.h"
+#include "ucad-affinity.h"
+#include "ucad-pool.h"
+#include "ucad-ring.h"
+#include "ucad-spill.h"
+#include "ucad-stats.h"
+#include "ucad-trace.h"
+#include "ucad-record.h"
+#include "ucad-replay.h"
 #include "config.h"
 
 #ifdef HAVE_UNIX
 #include <glib-unix.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sched.h>
 #endif
 
 #ifdef WITH_ZMQ_NETWORKING
@@ -34,10 +49,50 @@
 #endif
 
 static GMainLoop *loop;
-static GMutex access_lock;
-static gboolean stop_streaming_requested = FALSE;
-guint64 num_sent = 0;
-static GHashTable *zmq_endpoints = NULL;
+static GPtrArray *devices = NULL;
+static GHashTable *stripe_sets = NULL;
+static GMutex stripe_lock;
+static GCond stripe_cond;
+static gboolean use_uring = FALSE;
+static GThreadPool *workers = NULL;
+static gint max_workers = 16;
+static UcadAffinity *sender_cpus = NULL;
+static gint realtime_priority = 0;
+static gint zmq_io_threads = 0;
+static gint zmq_sndbuf = 0;
+static gboolean pool_hugepages = FALSE;
+static gboolean pool_mlock = FALSE;
+static gpointer zmq_context = NULL;
+static gchar *stats_file = NULL;
+static gint stats_interval = 10;
+static gchar *trace_file = NULL;
+static gint trace_seconds = 10;
+static gint trace_events = 1 << 18;
+static gchar *data_directory = NULL;
+static gchar **concurrent_properties = NULL;
+
+
+/* What a request may run concurrently with */
+typedef enum {
+    UCAD_ACCESS_QUERY,      /* Reads a property, also while frames are acquired */
+    UCAD_ACCESS_SETTER,     /* Sets a property, also while frames are acquired */
+    UCAD_ACCESS_EXCLUSIVE,  /* Runs alone among exclusive requests */
+    UCAD_ACCESS_FREE,       /* Must be able to arrive during exclusive requests */
+} UcadAccess;
+
+/* Properties which change the frames and can only be set by exclusive requests */
+static const gchar * const acquisition_properties[] = {
+    "roi-x", "roi-y", "roi-width", "roi-height",
+    "sensor-bitdepth", "sensor-horizontal-binning", "sensor-vertical-binning",
+    "buffered", "num-buffers",
+    NULL
+};
+
+/* Property change queued for the push loop */
+typedef struct {
+    GParamSpec *pspec;
+    gchar *value;
+} UcadPropertyChange;
 
 typedef void (*MessageHandler) (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error);
 typedef void (*CameraFunc) (UcaCamera *camera, GError **error);
@@ -55,23 +110,451 @@ typedef enum {
     UCAD_ERROR_ZMQ_BIND_FAILED,
     UCAD_ERROR_ZMQ_SENDING_FAILED,
     UCAD_ERROR_ZMQ_INVALID_ENDPOINT,
+    UCAD_ERROR_INVALID_REFERENCE,
+    UCAD_ERROR_STRIPE_TIMEOUT,
+    UCAD_ERROR_FRAME_SIZE_MISMATCH,
+    UCAD_ERROR_NO_HISTORY,
+    UCAD_ERROR_INVALID_BURST,
+    UCAD_ERROR_INVALID_PROPERTY,
+    UCAD_ERROR_UNKNOWN_CAMERA,
+    UCAD_ERROR_INVALID_STRIPE,
+    UCAD_ERROR_INVALID_REQUEST,
 } UcadError;
 
-/* ZMQ payload (metadata + image itself) which is pushed to UcadZmqNode.data_queue */
+/* Continuous acquisition into a ring which all consumers read from while the
+ * camera is recording. ring is only set and cleared with both access_lock and
+ * grab_lock held. */
+typedef struct {
+    UcadRing *ring;
+    UcadRing *history; /* Ring of the last acquisition after recording stopped */
+    GThread *thread;
+    UcaCamera *camera;
+    guint bitdepth;
+    gint running;
+} UcadAcquisition;
+
+/* Buffers of a grab request, reused as long as the frame size does not change */
+typedef struct {
+    gsize size;
+    gchar *buffer;
+    gchar *packed;
+    gchar *compressed;
+    gchar *scratch;
+    UcadUring *uring;       /* Sends from the buffers with --io-engine=uring */
+    gboolean uring_failed;
+} UcadGrabBuffers;
+
+/* Dark and flat field references. Consumers take a reference on the current
+ * set, updates replace it as a whole. */
+typedef struct {
+    gint ref_count;
+    guint width;
+    guint height;
+    gfloat *dark;
+    gfloat *flat;
+    gfloat *gain;
+} UcadReferences;
+
+/* Metrics of a camera, labeled with its name */
+typedef struct {
+    UcadStatsMetric *grabbed;       /* Frames grabbed for a request, also from the ring */
+    UcadStatsMetric *grab_time;
+    UcadStatsMetric *grab_errors;
+    UcadStatsMetric *acquired;      /* Frames acquired continuously into the ring */
+    UcadStatsMetric *dropped;
+    UcadStatsMetric *pushed;
+    UcadStatsMetric *pushed_bytes;
+    UcadStatsMetric *push_time;
+    UcadStatsMetric *push_errors;
+    UcadStatsMetric *tcp_frames;
+    UcadStatsMetric *tcp_bytes;
+    UcadStatsMetric *tcp_time;
+} UcadDeviceStats;
+
+/* Requests which run one after another in the worker that queued the first of
+ * them, so that requests waiting for their turn do not occupy workers */
+typedef struct {
+    GMutex lock;
+    GQueue requests;
+    gboolean running;
+} UcadSerialQueue;
+
+/* A camera served under a name with its own locks, acquisition ring and
+ * endpoints, so that requests for different cameras never wait for each
+ * other. Its threads are pinned to affinity if set. */
+typedef struct {
+    gchar *name;
+    UcaCamera *camera;
+    UcadAffinity *affinity;
+    UcadAffinity *acquisition_cpus;
+    UcadPool *pool;
+    GMutex access_lock;
+    GRWLock property_lock;
+    GMutex acquisition_lock;        /* Held during each grab from the camera */
+    GMutex acquisition_gate;        /* See ucad_acquisition_pause */
+    GMutex pending_lock;
+    GMutex generation_lock; /* Never held while waiting for another lock */
+    GMutex trigger_lock;
+    GMutex grab_lock;
+    GMutex history_lock;    /* Held while the history ring is read or replaced */
+    UcadSerialQueue exclusive_queue;
+    UcadSerialQueue ring_queue;     /* Grabs from the acquisition ring */
+    GQueue pending_changes;
+    guint64 config_generation;      /* Only accessed with generation_lock held */
+    gint push_running;
+    gboolean stop_streaming_requested;
+    guint64 num_sent;
+    guint64 num_grabbed;
+    GHashTable *zmq_endpoints;
+    UcadAcquisition acquisition;
+    /* Requests served from the ring run concurrently to those grabbing from
+     * the camera and need their own buffers */
+    UcadGrabBuffers camera_buffers;
+    UcadGrabBuffers ring_buffers;
+    GMutex references_lock;
+    UcadReferences *references;
+    UcadDeviceStats stats;
+} UcadDevice;
+
+/* A client connection, which may send any number of requests one after
+ * another to the camera it selected */
+typedef struct {
+    GSocketConnection *connection;
+    UcadDevice *device;
+} UcadSession;
+
+/* Request read from a session, which is watched again once it was handled */
+typedef struct {
+    UcadSession *session;
+    gchar *buffer;
+    UcadAccess access;
+} UcadRequest;
+
+static UcadDevice *
+ucad_device_get (UcaCamera *camera)
+{
+    return g_object_get_data (G_OBJECT (camera), "ucad-device");
+}
+
+/*
+ * Configuration generation of frames grabbed from the camera from now on.
+ */
+static guint64
+ucad_device_get_generation (UcadDevice *device)
+{
+    guint64 generation;
+
+    g_mutex_lock (&device->generation_lock);
+    generation = device->config_generation;
+    g_mutex_unlock (&device->generation_lock);
+
+    return generation;
+}
+
+/*
+ * Wait for the grab from the camera in progress, by the acquisition thread or
+ * a request, and keep the camera from grabbing again until
+ * ucad_acquisition_resume, so that properties which the plugin cannot change
+ * while acquiring are changed between grabs. Grabs pass the gate as well,
+ * which is held while waiting, so that back-to-back grabs never starve the
+ * caller.
+ */
+static void
+ucad_acquisition_pause (UcadDevice *device)
+{
+    g_mutex_lock (&device->acquisition_gate);
+    g_mutex_lock (&device->acquisition_lock);
+    g_mutex_unlock (&device->acquisition_gate);
+}
+
+static void
+ucad_acquisition_resume (UcadDevice *device)
+{
+    g_mutex_unlock (&device->acquisition_lock);
+}
+
+/*
+ * Grab the next frame from the camera unless acquisition is paused. The
+ * optional info is set to the configuration generation the frame is grabbed
+ * with and the times around the grab.
+ */
+static gboolean
+ucad_camera_grab (UcadDevice *device, gpointer buffer, UcadRingFrameInfo *info, GError **error)
+{
+    UcadRingFrameInfo unused;
+    gboolean success;
+
+    if (info == NULL)
+        info = &unused;
+
+    g_mutex_lock (&device->acquisition_gate);
+    g_mutex_lock (&device->acquisition_lock);
+    g_mutex_unlock (&device->acquisition_gate);
+
+    info->generation = ucad_device_get_generation (device);
+    info->grab_start = g_get_monotonic_time ();
+    success = uca_camera_grab (device->camera, buffer, error);
+    info->grab_end = g_get_monotonic_time ();
+    g_mutex_unlock (&device->acquisition_lock);
+
+    return success;
+}
+
+/**
+ * Pin the calling thread to cpus, or its CPU at index if that is not
+ * negative, with the real-time priority given on the command line. Threads
+ * of a pool must restore the returned state before they return to it.
+ */
+static UcadAffinityState *
+ucad_pin_thread (UcadAffinity *cpus, gint index, const gchar *role)
+{
+    UcadAffinityState *state;
+    GError *error = NULL;
+
+    if (cpus == NULL && realtime_priority <= 0)
+        return NULL;
+
+    state = ucad_affinity_pin_thread (cpus, index, realtime_priority, &error);
+
+    if (state == NULL) {
+        g_warning ("Running %s thread unpinned: %s", role, error->message);
+        g_error_free (error);
+    }
+
+    return state;
+}
+
+static UcadAffinityState *
+ucad_pin_acquisition_thread (UcadDevice *device)
+{
+    return ucad_pin_thread (device->acquisition_cpus != NULL ? device->acquisition_cpus : device->affinity,
+                            -1, "acquisition");
+}
+
+static void
+ucad_device_stats_init (UcadDeviceStats *stats, const gchar *name)
+{
+    gchar *labels = ucad_stats_labels ("camera", name, NULL);
+
+    stats->grabbed = ucad_stats_metric_new (UCAD_STATS_COUNTER, "ucad_grabbed_frames_total",
+                                            "Frames grabbed from the camera or read from a ring for a request", labels);
+    stats->grab_time = ucad_stats_metric_new (UCAD_STATS_HISTOGRAM, "ucad_grab_seconds",
+                                              "Time until a requested frame was grabbed", labels);
+    stats->grab_errors = ucad_stats_metric_new (UCAD_STATS_COUNTER, "ucad_grab_errors_total",
+                                                "Failed grabs", labels);
+    stats->acquired = ucad_stats_metric_new (UCAD_STATS_COUNTER, "ucad_acquired_frames_total",
+                                             "Frames acquired continuously into the ring", labels);
+    stats->dropped = ucad_stats_metric_new (UCAD_STATS_COUNTER, "ucad_dropped_frames_total",
+                                            "Frames overwritten in the ring before they were read", labels);
+    stats->pushed = ucad_stats_metric_new (UCAD_STATS_COUNTER, "ucad_pushed_frames_total",
+                                           "Frames handed to all ZMQ endpoints", labels);
+    stats->pushed_bytes = ucad_stats_metric_new (UCAD_STATS_COUNTER, "ucad_pushed_bytes_total",
+                                                 "Bytes of frames handed to all ZMQ endpoints", labels);
+    stats->push_time = ucad_stats_metric_new (UCAD_STATS_HISTOGRAM, "ucad_push_seconds",
+                                              "Time until endpoints sending in lockstep sent a frame", labels);
+    stats->push_errors = ucad_stats_metric_new (UCAD_STATS_COUNTER, "ucad_push_errors_total",
+                                                "Frames which could not be sent to all ZMQ endpoints", labels);
+    stats->tcp_frames = ucad_stats_metric_new (UCAD_STATS_COUNTER, "ucad_tcp_frames_total",
+                                               "Frames sent in reply to grab requests", labels);
+    stats->tcp_bytes = ucad_stats_metric_new (UCAD_STATS_COUNTER, "ucad_tcp_bytes_total",
+                                              "Bytes of frames sent in reply to grab requests", labels);
+    stats->tcp_time = ucad_stats_metric_new (UCAD_STATS_HISTOGRAM, "ucad_tcp_send_seconds",
+                                             "Time sending a grab reply and its frame", labels);
+    g_free (labels);
+}
+
+static void
+ucad_device_stats_clear (UcadDeviceStats *stats)
+{
+    ucad_stats_metric_free (stats->grabbed);
+    ucad_stats_metric_free (stats->grab_time);
+    ucad_stats_metric_free (stats->grab_errors);
+    ucad_stats_metric_free (stats->acquired);
+    ucad_stats_metric_free (stats->dropped);
+    ucad_stats_metric_free (stats->pushed);
+    ucad_stats_metric_free (stats->pushed_bytes);
+    ucad_stats_metric_free (stats->push_time);
+    ucad_stats_metric_free (stats->push_errors);
+    ucad_stats_metric_free (stats->tcp_frames);
+    ucad_stats_metric_free (stats->tcp_bytes);
+    ucad_stats_metric_free (stats->tcp_time);
+}
+
+/**
+ * Count a grab for a request which started at start.
+ */
+static void
+ucad_device_stats_grabbed (UcadDeviceStats *stats, gint64 start, gboolean success)
+{
+    ucad_stats_observe (stats->grab_time, g_get_monotonic_time () - start);
+    ucad_stats_add (success ? stats->grabbed : stats->grab_errors, 1);
+}
+
+static gint ring_size = 0;
+static gint64 ring_bytes = 0;
+static gboolean ring_hugepages = FALSE;
+
+/* Largest width and height of an uploaded dark or flat reference */
+#define UCAD_MAX_REFERENCE_SIZE 32768
+
+/* Time a striped grab waits for its additional connections */
+#define UCAD_STRIPE_TIMEOUT (5 * G_TIME_SPAN_SECOND)
+
+/* Seconds a client may take to send the rest of a request it started */
+#define UCAD_REQUEST_TIMEOUT 10
+
+/* Additional connections of a striped grab collected by their token */
+typedef struct {
+    GSocketConnection *connections[UCA_NET_MAX_STREAMS];
+    guint num_streams;  /* Set once the grab waits for the set, 0 before */
+    gint64 created;
+} UcadStripeSet;
+
+/* ZMQ payload (frame metadata + image itself) which is pushed to
+ * UcadZmqNode.data_queue. The header is created by each node because endpoints
+ * may send the frame in different representations. A buffer_size of 0 signals
+ * the end of the stream. */
 typedef struct {
     gchar *buffer;
-    gchar *header;
     gsize buffer_size;
-    gsize header_size;
+    guint width;
+    guint height;
+    guint pixel_size;
+    UcaNetDtype dtype;
+    guint bitdepth;
+    gboolean mirror;
+    guint rotate;
+    guint64 frame_number;
+    guint64 first_grab;
+    guint64 last_grab;
+    gint64 timestamp;
+    gboolean send_poison_pill;
+    guint64 config_generation;
+    gint64 grab_start;  /* Monotonic times, 0 if unknown */
+    gint64 grab_end;
+    gint64 enqueued;
 } UcadZmqPayload;
 
+/* Conversion of the payload into the data type requested by an endpoint */
+typedef struct {
+    UcaNetDtype dtype;
+    UcaNetWindow window;
+    gdouble window_min;
+    gdouble window_max;
+    gdouble gamma;
+    gboolean flat_correct;
+    gfloat flat_scale;
+    gboolean warned;
+    gboolean window_valid;
+    guint8 *lut;
+    guint lut_min;
+    guint lut_max;
+    gchar *buffer;
+    gsize buffer_size;
+} UcadZmqConversion;
+
+/* Row and column sums of a region of interest */
+typedef struct {
+    guint x;
+    guint y;
+    guint width;
+    guint height;
+    guint64 *sums;
+    gdouble *buffer;
+    gsize buffer_size;
+} UcadZmqProjection;
+
+/* Tiles of the current frame which differ from the last key frame */
+typedef struct {
+    guint size;
+    gdouble threshold;
+    guint keyframe_interval;
+    gchar *keyframe;
+    gsize keyframe_size;
+    guint64 keyframe_number;
+    guint since_keyframe;
+    GString *bitmap;
+    gchar *buffer;
+} UcadZmqTiles;
+
+/* Bit packing of unconverted frames sent to an endpoint */
+typedef struct {
+    gboolean enabled;
+    gchar *buffer;
+    gsize size;
+} UcadZmqPacking;
+
+/* Compression of the data sent to an endpoint */
+typedef struct {
+    UcaNetCodec codec;
+    gchar *buffer;
+    gchar *scratch;
+    gsize size;
+} UcadZmqCompression;
+
+/* Copy of a frame shared by the queues of all endpoints not sent in lockstep */
+typedef struct {
+    gint ref_count;
+    UcadPool *pool;
+    gchar *data;
+} UcadZmqFrame;
+
+/* Queued payload, whose buffer is NULL while the frame is spilled to disk */
+typedef struct {
+    UcadZmqPayload payload;
+    UcadZmqFrame *frame;
+    goffset offset;
+} UcadZmqQueueEntry;
+
+/* Frames waiting for an endpoint which may fall behind the others. Beyond depth
+ * frames in memory they are spilled to disk if there is a spill file, otherwise
+ * pushing waits for the endpoint. */
+typedef struct {
+    guint depth;
+    GMutex lock;
+    GCond cond;
+    GQueue entries;
+    guint num_in_memory;
+    guint num_on_disk;
+    gboolean stopped;
+    UcadSpill *spill;
+    gchar *buffer;
+    gsize buffer_size;
+    guint max_length;
+    guint64 num_spilled;
+    guint64 spilled_bytes;
+    UcadStatsMetric *length; /* Gauge of the queued entries */
+} UcadZmqQueue;
+
+typedef struct {
+    UcadStatsMetric *header_time;   /* Converting, compressing and describing a frame */
+    UcadStatsMetric *send_time;
+    UcadStatsMetric *sent_bytes;
+    UcadStatsMetric *errors;
+    UcadStatsMetric *queue_length;
+} UcadZmqNodeStats;
+
 /* A node in a GHashTable holding endpoint: node pairs. This is the structure passed
  * to a thread in a GThreadPool. */
 typedef struct {
+    UcadDevice *device;
+    guint index;
     gpointer socket;
+    UcadRecorder *recorder;
     gint zmq_retval;
     GAsyncQueue *data_queue;
     GAsyncQueue *feedback_queue;
+    UcadZmqQueue queue;
+    UcaNetEndpointMode mode;
+    UcadZmqConversion conversion;
+    UcadZmqProjection projection;
+    UcadZmqTiles tiles;
+    UcadZmqPacking packing;
+    UcadZmqCompression compression;
+    UcadZmqNodeStats stats;
+    gboolean timing;
+    gint64 last_sent; /* Monotonic time the previous frame was sent, 0 if none */
+    guint64 last_frame_number;
 } UcadZmqNode;
 
 /* Here we hold if we want the receiver that the frames should be mirrored and/or rotated.
@@ -94,901 +577,4588 @@ GQuark ucad_error_quark()
     return g_quark_from_static_string ("ucad-error-quark");
 }
 
-static gchar *
-get_camera_list (UcaPluginManager *manager)
-{
-    GList *types;
-    GString *str;
-
-    manager = uca_plugin_manager_new ();
-    types = uca_plugin_manager_get_available_cameras (manager);
-    str = g_string_new ("[ ");
+#define UCAD_MAX_PARALLEL_TASKS 64
 
-    if (types != NULL) {
-        for (GList *it = g_list_first (types); it != NULL; it = g_list_next (it)) {
-            gchar *name = (gchar *) it->data;
+/* A reply and a frame at a time */
+#define UCAD_URING_QUEUE_DEPTH 8
 
-            if (g_list_next (it) == NULL)
-                g_string_append_printf (str, "%s ]", name);
-            else
-                g_string_append_printf (str, "%s, ", name);
-        }
-    }
-    else {
-        g_string_append (str, "]");
-    }
+typedef void (*UcadRangeFunc) (gsize start, gsize end, gpointer user_data);
 
-    g_list_free_full (types, g_free);
-    g_object_unref (manager);
-    return g_string_free (str, FALSE);
-}
+typedef struct {
+    UcadRangeFunc func;
+    gpointer user_data;
+    GMutex lock;
+    GCond done;
+    guint remaining;
+} UcadParallelJob;
 
-static GOptionContext *
-uca_option_context_new (UcaPluginManager *manager)
-{
-    GOptionContext *context;
-    gchar *camera_list;
+typedef struct {
+    UcadParallelJob *job;
+    gsize start;
+    gsize end;
+} UcadParallelTask;
 
-    camera_list = get_camera_list (manager);
-    context = g_option_context_new (camera_list);
-    g_free (camera_list);
-    return context;
-}
+static GThreadPool *worker_pool = NULL;
+static GThreadPool *io_pool = NULL;
 
 static void
-send_reply (GSocketConnection *connection, gpointer data, gsize size, GError **error)
+ucad_parallel_run_task (UcadParallelTask *task, gpointer unused)
 {
-    GOutputStream *output;
+    UcadParallelJob *job = task->job;
 
-    output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+    job->func (task->start, task->end, job->user_data);
 
-    if (!g_output_stream_write_all (output, data, size, NULL, NULL, error))
-        return;
+    g_mutex_lock (&job->lock);
 
-    if (!g_output_stream_flush (output, NULL, error))
-        return;
+    if (--job->remaining == 0)
+        g_cond_signal (&job->done);
+
+    g_mutex_unlock (&job->lock);
 }
 
-static void
-prepare_error_reply (GError *error, UcaNetErrorReply *reply)
+static GThreadPool *
+ucad_get_worker_pool (void)
 {
-    if (error != NULL) {
-        reply->occurred = TRUE;
-        reply->code = error->code;
-        strncpy (reply->domain, g_quark_to_string (error->domain), sizeof (error->domain));
-        strncpy (reply->message, error->message, sizeof (reply->message));
-        g_error_free (error);
-    }
-    else {
-        reply->occurred = FALSE;
+    static gsize initialized = 0;
+
+    if (g_once_init_enter (&initialized)) {
+        worker_pool = g_thread_pool_new ((GFunc) ucad_parallel_run_task, NULL,
+                                         (gint) g_get_num_processors (), FALSE, NULL);
+        g_once_init_leave (&initialized, 1);
     }
+
+    return worker_pool;
 }
 
-static void
-serialize_param_spec (GParamSpec *pspec, UcaNetMessageProperty *prop)
+/*
+ * Unbounded pool for blocking writes, so that a client which stops reading
+ * ties up one of its threads and never a worker of the CPU kernels.
+ */
+static GThreadPool *
+ucad_get_io_pool (void)
 {
-    strncpy (prop->name, g_param_spec_get_name (pspec), sizeof (prop->name));
-    strncpy (prop->nick, g_param_spec_get_nick (pspec), sizeof (prop->nick));
-    strncpy (prop->blurb, g_param_spec_get_blurb (pspec), sizeof (prop->blurb));
-
-    prop->value_type = pspec->value_type;
-    prop->flags = pspec->flags;
-    prop->valid = TRUE;
+    static gsize initialized = 0;
 
-    if (g_type_is_a (pspec->value_type, G_TYPE_ENUM)) {
-        GEnumClass *enum_class;
+    if (g_once_init_enter (&initialized)) {
+        io_pool = g_thread_pool_new ((GFunc) ucad_parallel_run_task, NULL, -1, FALSE, NULL);
+        g_once_init_leave (&initialized, 1);
+    }
 
-        enum_class = ((GParamSpecEnum *) pspec)->enum_class;
-        prop->value_type = G_TYPE_ENUM;
-        prop->spec.genum.default_value = ((GParamSpecEnum *) pspec)->default_value;
-        prop->spec.genum.minimum = enum_class->minimum;
-        prop->spec.genum.maximum = enum_class->maximum;
-        prop->spec.genum.n_values = enum_class->n_values;
+    return io_pool;
+}
 
-        if (enum_class->n_values > UCA_NET_MAX_ENUM_LENGTH)
-            g_warning ("Cannot serialize all values of %s", prop->name);
+/*
+ * Split [0, n) into num_tasks chunks and process them on pool. The calling
+ * thread processes the first chunk itself and returns once all chunks are
+ * done.
+ */
+static void
+ucad_parallel_run (GThreadPool *pool, gsize num_tasks, UcadRangeFunc func, gsize n, gpointer user_data)
+{
+    UcadParallelJob job;
+    UcadParallelTask tasks[UCAD_MAX_PARALLEL_TASKS];
+    gsize chunk;
 
-        for (guint i = 0; i < MIN (enum_class->n_values, UCA_NET_MAX_ENUM_LENGTH); i++) {
-            prop->spec.genum.values[i] = enum_class->values[i].value;
+    num_tasks = MIN (num_tasks, UCAD_MAX_PARALLEL_TASKS);
 
-            if (strlen (enum_class->values[i].value_name) > UCA_NET_MAX_ENUM_NAME_LENGTH)
-                g_warning ("Enum value name too long, expect serious problems");
+    if (num_tasks <= 1 || pool == NULL) {
+        func (0, n, user_data);
+        return;
+    }
 
-            strncpy (prop->spec.genum.value_names[i], enum_class->values[i].value_name,
-                     UCA_NET_MAX_ENUM_NAME_LENGTH);
+    chunk = (n + num_tasks - 1) / num_tasks;
+    job.func = func;
+    job.user_data = user_data;
+    job.remaining = num_tasks - 1;
+    g_mutex_init (&job.lock);
+    g_cond_init (&job.done);
 
-            strncpy (prop->spec.genum.value_nicks[i], enum_class->values[i].value_nick,
-                     UCA_NET_MAX_ENUM_NAME_LENGTH);
-        }
+    for (gsize i = 1; i < num_tasks; i++) {
+        tasks[i].job = &job;
+        tasks[i].start = MIN (i * chunk, n);
+        tasks[i].end = MIN ((i + 1) * chunk, n);
 
-        return;
+        if (!g_thread_pool_push (pool, &tasks[i], NULL))
+            ucad_parallel_run_task (&tasks[i], NULL);
     }
 
-#define CASE_NUMERIC(type, storage, typeclass) \
-        case type: \
-            prop->spec.storage.minimum = ((typeclass *) pspec)->minimum; \
-            prop->spec.storage.maximum = ((typeclass *) pspec)->maximum; \
-            prop->spec.storage.default_value = ((typeclass *) pspec)->default_value;
+    func (0, MIN (chunk, n), user_data);
 
-    switch (pspec->value_type) {
-        case G_TYPE_BOOLEAN:
-            prop->spec.gboolean.default_value = ((GParamSpecBoolean *) pspec)->default_value;
-            break;
-        case G_TYPE_STRING:
-            strncpy (prop->spec.gstring.default_value, ((GParamSpecString *) pspec)->default_value,
-                     sizeof (prop->spec.gstring.default_value));
-            break;
-        CASE_NUMERIC (G_TYPE_INT, gint, GParamSpecInt)
-            break;
-        CASE_NUMERIC (G_TYPE_INT64, gint64, GParamSpecInt64)
-            break;
-        CASE_NUMERIC (G_TYPE_UINT, guint, GParamSpecUInt)
-            break;
-        CASE_NUMERIC (G_TYPE_UINT64, guint64, GParamSpecUInt64)
-            break;
-        CASE_NUMERIC (G_TYPE_FLOAT, gfloat, GParamSpecFloat)
-            break;
-        CASE_NUMERIC (G_TYPE_DOUBLE, gdouble, GParamSpecDouble)
-            break;
-        default:
-            g_warning ("Cannot serialize property %s", prop->name);
-            prop->valid = FALSE;
-            break;
-    }
+    g_mutex_lock (&job.lock);
 
-#undef CASE_NUMERIC
+    while (job.remaining > 0)
+        g_cond_wait (&job.done, &job.lock);
+
+    g_mutex_unlock (&job.lock);
+    g_mutex_clear (&job.lock);
+    g_cond_clear (&job.done);
 }
 
-#ifdef WITH_ZMQ_NETWORKING
 /**
- * Create header, if buffer is NULL then create a special header signalling
- * end-of-stream, otherwise make the standard header to be sent along with the
- * image itself.
+ * Split [0, n) into chunks of at least grain items and process them on the
+ * shared worker pool, which is only meant for CPU-bound work.
  */
-static char *
-ucad_zmq_create_image_header (gpointer buffer, guint width, guint height, guint pixel_size, gboolean mirror, guint rotate, guint64 num_sent, gsize *length,
-                              gboolean send_poison_pill)
+static void
+ucad_parallel_for (UcadRangeFunc func, gsize n, gsize grain, gpointer user_data)
 {
-    if (num_sent == G_MAXUINT64)  {
-        g_warning("Integer overflow would occur for upcoming frame, num_sent:%lu\n", num_sent);
-    }
-    json_object *tree = NULL;
-    json_object *detail = NULL;
-    const char *header;
-    char *result;
-    GDateTime *dt;
-    char *timestamp;
+    ucad_parallel_run (ucad_get_worker_pool (),
+                       MIN (n / MAX (grain, 1), g_get_num_processors ()),
+                       func, n, user_data);
+}
 
-    if (buffer == NULL && !send_poison_pill) {
-        /* Do not send poison pill, we don't need to generate any json structure */
-        *length = 0;
-        return NULL;
-    }
+typedef struct {
+    const gchar *src;
+    gsize size;
+    guint pixel_size;
+    gchar *dst;
+    gchar *scratch;
+} UcadCompression;
 
-    tree = json_object_new_object();
+static void
+ucad_compress_range (gsize start, gsize end, gpointer user_data)
+{
+    UcadCompression *compression = (UcadCompression *) user_data;
 
-    /* Frame number */
-    if (buffer != NULL) {
-        gchar *frame_number = g_strdup_printf("%lu", num_sent);
-        json_object_object_add(tree, "frame-number", json_object_new_string(frame_number));
-        g_free(frame_number);
-        /* Timestamp */
-        dt = g_date_time_new_now_local ();
-        timestamp = g_strdup_printf ("%ld.%d", g_date_time_to_unix (dt), g_date_time_get_microsecond (dt));
-        json_object_object_add(tree, "timestamp", json_object_new_string(timestamp));
-        g_free (timestamp);
-        g_date_time_unref (dt);
-
-        /* Data type, we assume all detectors having unsigned data types */
-        json_object_object_add(tree, "dtype", json_object_new_string(pixel_size == 1 ? "uint8" : "uint16"));
-
-        /* Image shape */
-        detail = json_object_new_array_ext(2);
-        json_object_array_add(detail, json_object_new_int((gint)height));
-        json_object_array_add(detail, json_object_new_int((gint)width));
-        json_object_object_add(tree, "shape", detail);
-
-        // Image transformations that the receiver should apply
-        json_object_object_add(tree, "mirror", json_object_new_boolean(mirror));
-        json_object_object_add(tree, "rotate", json_object_new_int(rotate));
-
-    } else {
-        json_object_object_add(tree, "end", json_object_new_boolean(TRUE));
-    }
-
-    /* Create JSON string */
-    header = json_object_to_json_string_length(tree, JSON_C_TO_STRING_PLAIN, length);
-    
-    /* The serialized JSON is owned by the json object, so we duplicate it here... */
-    result = strdup(header);
-
-    /* ...before dereferencing the json structure */
-    json_object_put(tree);
-
-    return result;
+    for (gsize i = start; i < end; i++)
+        uca_net_codec_compress_block (compression->src, compression->size, compression->pixel_size,
+                                      (guint) i, compression->dst, compression->scratch);
 }
 
 /**
- * Push images to all queues, i.e. feed all the sending threads with data.
+ * Compress size bytes of src block-parallel on the worker pool. dst must hold
+ * uca_net_codec_get_bound (size) and scratch size bytes. Returns the
+ * compressed size.
  */
-static void
-udad_zmq_push_to_all (UcadZmqPayload *payload)
+static gsize
+ucad_compress (const gchar *src, gsize size, guint pixel_size, gchar *dst, gchar *scratch)
 {
-    GHashTableIter iter;
-    UcadZmqNode *node;
+    UcadCompression compression = {
+        .src = src,
+        .size = size,
+        .pixel_size = pixel_size,
+        .dst = dst,
+        .scratch = scratch,
+    };
 
-    g_hash_table_iter_init (&iter, zmq_endpoints);
+    ucad_parallel_for (ucad_compress_range, uca_net_codec_get_num_blocks (size), 1, &compression);
+    return uca_net_codec_finish (dst, size, pixel_size);
+}
 
-    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &node)) {
-        g_async_queue_push (node->data_queue, payload);
-    }
+typedef struct {
+    const guint16 *src;
+    guint8 *dst;
+    guint bits;
+    guint group;
+} UcadPacking;
+
+static void
+ucad_pack_range (gsize start, gsize end, gpointer user_data)
+{
+    UcadPacking *packing = (UcadPacking *) user_data;
+    gsize first = start * packing->group;
+
+    uca_net_pack (packing->src + first, packing->dst + first * packing->bits / 8,
+                  (end - start) * packing->group, packing->bits);
 }
 
 /**
- * Wait for all sockets (and threads) to finish sending one image, i.e. we pop all queues.
+ * Pack num_pixels pixels of src with bits each into dst on the worker pool.
+ * Returns the packed size.
  */
-static gint
-udad_zmq_wait_for_all (void)
+static gsize
+ucad_pack (const guint16 *src, guint8 *dst, gsize num_pixels, guint bits)
 {
-    GHashTableIter iter;
-    UcadZmqNode *node;
-    gint zmq_retval_all = 0;
+    UcadPacking packing = {
+        .src = src,
+        .dst = dst,
+        .bits = bits,
+        .group = uca_net_pack_get_group_size (bits),
+    };
+    gsize num_groups = num_pixels / packing.group;
+    gsize remaining = num_pixels - num_groups * packing.group;
 
-    g_hash_table_iter_init (&iter, zmq_endpoints);
+    ucad_parallel_for (ucad_pack_range, num_groups, 16384, &packing);
 
-    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &node)) {
-        g_async_queue_pop (node->feedback_queue);
+    if (remaining > 0)
+        uca_net_pack (src + num_groups * packing.group, dst + num_groups * packing.group * bits / 8, remaining, bits);
 
-        if (node->zmq_retval < 0) {
-            if (zmq_retval_all < 0) {
-                g_warning ("Multiple streams error");
-            } else {
-                zmq_retval_all = node->zmq_retval;
-            }
-        }
+    return uca_net_pack_get_size (num_pixels, bits);
+}
+
+static void
+ucad_stripe_set_free (UcadStripeSet *set)
+{
+    for (guint i = 0; i < UCA_NET_MAX_STREAMS; i++) {
+        if (set->connections[i] != NULL)
+            g_object_unref (set->connections[i]);
     }
 
-    return zmq_retval_all;
+    g_free (set);
 }
 
 static gboolean
-ucad_zmq_node_init (UcadZmqNode *node, UcaNetMessageAddZmqEndpointRequest *request, gpointer context, GError **error)
+ucad_stripe_set_is_stale (gpointer key, UcadStripeSet *set, gint64 *now)
 {
-    gint sndhwm = request->sndhwm;
-    gsize size = sizeof (gint);
-    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-    node->socket = NULL;
+    /* Connections which arrived after their grab gave up */
+    return set->num_streams == 0 && *now - set->created > 2 * UCAD_STRIPE_TIMEOUT;
+}
 
-    if (sndhwm < 0 && request->socket_type == ZMQ_PUB) {
-        /* Live image needs to be the freshest, so do not queue at all */
-        sndhwm = 1;
-    }
+/* Must be called with stripe_lock held */
+static UcadStripeSet *
+ucad_stripe_set_lookup (guint32 token)
+{
+    UcadStripeSet *set;
+    gint64 now = g_get_monotonic_time ();
 
-    if ((node->socket = zmq_socket (context, request->socket_type)) == NULL) {
-        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_SOCKET_CREATION_FAILED,
-                     "zmq socket creation failed: %s\n", zmq_strerror (zmq_errno ()));
-        return FALSE;
-    }
-    if (sndhwm >= 0 && zmq_setsockopt (node->socket, ZMQ_SNDHWM, &sndhwm, sizeof (gint)) != 0) {
-        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_SOCKET_CREATION_FAILED,
-                     "zmq setting SNDHWM failed: %s\n", zmq_strerror (zmq_errno ()));
-        return FALSE;
-    }
-    if (zmq_getsockopt (node->socket, ZMQ_SNDHWM, &sndhwm, &size) != 0) {
-        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_SOCKET_CREATION_FAILED,
-                     "zmq getting SNDHWM failed: %s\n", zmq_strerror (zmq_errno ()));
-        return FALSE;
-    }
-    if (zmq_bind (node->socket, request->endpoint) != 0) {
-        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_BIND_FAILED,
-                     "zmq socket bind failed: %s\n", zmq_strerror (zmq_errno ()));
-        return FALSE;
-    }
-    g_debug ("Created socket `%s' of type=%d with SNDHWM=%d", request->endpoint, request->socket_type, sndhwm);
+    if (stripe_sets == NULL)
+        stripe_sets = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                             (GDestroyNotify) ucad_stripe_set_free);
 
-    node->zmq_retval = 0;
-    node->data_queue = g_async_queue_new ();
-    node->feedback_queue = g_async_queue_new ();
+    g_hash_table_foreach_remove (stripe_sets, (GHRFunc) ucad_stripe_set_is_stale, &now);
+    set = g_hash_table_lookup (stripe_sets, GUINT_TO_POINTER (token));
 
-    return TRUE;
+    if (set == NULL) {
+        set = g_new0 (UcadStripeSet, 1);
+        set->created = now;
+        g_hash_table_insert (stripe_sets, GUINT_TO_POINTER (token), set);
+    }
+
+    return set;
 }
 
-static void
-ucad_zmq_node_free (gpointer data)
+/* Number of the connections 1 to num_streams - 1 which arrived */
+static guint
+ucad_stripe_set_count (UcadStripeSet *set, guint num_streams)
 {
-    gchar endpoint[128];
-    gsize size = sizeof (endpoint);
-    UcadZmqNode *node = (UcadZmqNode *) data;
+    guint num_connected = 0;
 
-    if (zmq_getsockopt (node->socket, ZMQ_LAST_ENDPOINT, endpoint, &size)) {
-        g_warning ("zmq_getsockopt failed: %s\n", zmq_strerror (zmq_errno ()));
-    } else {
-        g_debug ("Freeing `%s'", endpoint);
+    for (guint i = 1; i < num_streams; i++) {
+        if (set->connections[i] != NULL)
+            num_connected++;
     }
 
-    if (zmq_close (node->socket)) {
-        g_warning ("zmq socket destruction failed: %s\n", zmq_strerror (zmq_errno ()));
-    }
-    node->socket = NULL;
-    g_async_queue_unref (node->data_queue);
-    g_async_queue_unref (node->feedback_queue);
-    node->data_queue = NULL;
-    node->feedback_queue = NULL;
+    return num_connected;
 }
 
 /**
- * Send images via a zmq socket and use two-queue synchronization, i.e. when a
- * payload is ready we pop it from a queue, send it and push a token to the
- * queue which signals the calling thread about the work being done. If the
- * image data size is 0 we just send the header, which contains an end-of-stream
- * indicator, which tells to the receiving end that we are done sending images.
- * This function is running in a thread pool.
+ * Wait until the connections 1 to num_streams - 1 announced by token arrived
+ * and store them in connections. Returns FALSE and releases the connections
+ * which did arrive on timeout.
  */
-static void
-ucad_zmq_send_images (UcadZmqNode *node, gpointer static_data)
+static gboolean
+ucad_stripe_set_wait (guint32 token, guint num_streams, GSocketConnection **connections, GError **error)
 {
-    UcadZmqPayload *payload;
-    gboolean stop = FALSE;
-
-    while (!stop) {
-        payload = (UcadZmqPayload *) g_async_queue_pop (node->data_queue);
-        if (payload->header_size) {
+    UcadStripeSet *set;
+    gint64 end_time;
+    guint num_connected;
+    gboolean complete;
+
+    end_time = g_get_monotonic_time () + UCAD_STRIPE_TIMEOUT;
+    g_mutex_lock (&stripe_lock);
+    set = ucad_stripe_set_lookup (token);
+    set->num_streams = num_streams;
+
+    while (ucad_stripe_set_count (set, num_streams) < num_streams - 1) {
+        if (!g_cond_wait_until (&stripe_cond, &stripe_lock, end_time))
+            break;
+    }
 
-            /* First send the header and then the actual payload */
-            node->zmq_retval = zmq_send (node->socket, payload->header, payload->header_size,
-                                         payload->buffer_size == 0 ? 0 : ZMQ_SNDMORE);
+    num_connected = ucad_stripe_set_count (set, num_streams);
+    complete = num_connected == num_streams - 1;
 
-            if (node->zmq_retval >= 0 && payload->buffer_size != 0) {
-                node->zmq_retval = zmq_send (node->socket, payload->buffer, payload->buffer_size, 0);
-            }
+    /* Handed out connections are taken from the set, the others are released
+     * with it */
+    for (guint i = 1; i < num_streams && complete; i++) {
+        connections[i] = set->connections[i];
+        set->connections[i] = NULL;
+    }
 
-            if (payload->buffer_size == 0 || node->zmq_retval < 0) {
-                stop = TRUE;
-            }
-        } else {
-            node->zmq_retval = 0;
-            stop = TRUE;
-        }
+    g_hash_table_remove (stripe_sets, GUINT_TO_POINTER (token));
+    g_mutex_unlock (&stripe_lock);
 
-        /* Control goes to main thread, no more access to payload after this! */
-        g_async_queue_push (node->feedback_queue, &node->zmq_retval);
-    }
+    if (!complete)
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_STRIPE_TIMEOUT,
+                     "Only %u of %u stripe connections arrived", num_connected + 1, num_streams);
 
-    g_debug ("Sending loop finished");
+    return complete;
 }
-#endif
+
+typedef struct {
+    GOutputStream *outputs[UCA_NET_MAX_STREAMS];
+    const gchar *data;
+    gsize size;
+    guint num_streams;
+    GMutex lock;
+    GError *error;
+} UcadStripes;
 
 static void
-handle_get_properties_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+ucad_send_stripes_range (gsize start, gsize end, gpointer user_data)
 {
-    UcaNetMessageGetPropertiesReply reply = { .type = UCA_NET_MESSAGE_GET_PROPERTIES };
-    GParamSpec **pspecs;
-    guint num_properties;
+    UcadStripes *stripes = (UcadStripes *) user_data;
 
-    pspecs = g_object_class_list_properties (G_OBJECT_GET_CLASS (camera), &num_properties);
-    reply.num_properties = num_properties - N_BASE_PROPERTIES + 1;
+    for (gsize i = start; i < end; i++) {
+        gsize first = stripes->size * i / stripes->num_streams;
+        gsize last = stripes->size * (i + 1) / stripes->num_streams;
+        GError *error = NULL;
 
-    send_reply (connection, &reply, sizeof (reply), error);
+        if (!g_output_stream_write_all (stripes->outputs[i], stripes->data + first, last - first, NULL, NULL, &error)) {
+            g_mutex_lock (&stripes->lock);
 
-    for (guint i = N_BASE_PROPERTIES - 1; i < num_properties; i++) {
-        UcaNetMessageProperty property;
+            if (stripes->error == NULL)
+                stripes->error = error;
+            else
+                g_error_free (error);
 
-        serialize_param_spec (pspecs[i], &property);
-        send_reply (connection, &property, sizeof (property), error);
+            g_mutex_unlock (&stripes->lock);
+        }
     }
-
-    g_free (pspecs);
 }
 
-static void
-handle_get_property_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+/**
+ * Send size bytes of data split into num_streams consecutive ranges, each
+ * written to the corresponding output by its own thread of the I/O pool.
+ */
+static gboolean
+ucad_send_stripes (GOutputStream **outputs, guint num_streams, const gchar *data, gsize size, GError **error)
 {
-    UcaNetMessageGetPropertyRequest *request;
-    UcaNetMessageGetPropertyReply reply;
-    GParamSpec *pspec;
-    GValue prop_value = {0};
-    GValue str_value = {0};
-
-    request = (UcaNetMessageGetPropertyRequest *) message;
-    pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (camera), request->property_name);
+    UcadStripes stripes = {
+        .data = data,
+        .size = size,
+        .num_streams = num_streams,
+        .error = NULL,
+    };
 
-    if (pspec == NULL)
-        return;
+    memcpy (stripes.outputs, outputs, num_streams * sizeof (GOutputStream *));
+    g_mutex_init (&stripes.lock);
+    ucad_parallel_run (ucad_get_io_pool (), num_streams, ucad_send_stripes_range, num_streams, &stripes);
+    g_mutex_clear (&stripes.lock);
 
-    g_value_init (&prop_value, g_type_is_a (pspec->value_type, G_TYPE_ENUM) ? G_TYPE_INT : pspec->value_type);
-    g_object_get_property (G_OBJECT (camera), request->property_name, &prop_value);
+    if (stripes.error != NULL) {
+        g_propagate_error (error, stripes.error);
+        return FALSE;
+    }
 
-    g_value_init (&str_value, G_TYPE_STRING);
-    g_value_transform (&prop_value, &str_value);
-    reply.type = request->type;
-    strncpy (reply.property_value, g_value_get_string (&str_value), sizeof (reply.property_value));
-    send_reply (connection, &reply, sizeof (reply), error);
-    g_debug ("Getting `%s'=`%s'", request->property_name, reply.property_value);
-    g_value_unset (&str_value);
+    return TRUE;
 }
 
-static void
-handle_set_property_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+static gpointer
+ucad_acquisition_run (UcadAcquisition *acq)
 {
-    UcaNetMessageSetPropertyRequest *request;
-    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_SET_PROPERTY };
-    GParamSpec *pspec;
-    GValue prop_value = {0};
-    GValue str_value = {0};
+    UcadDevice *device = ucad_device_get (acq->camera);
+    UcadDeviceStats *stats = &device->stats;
+    UcadAffinityState *state;
+    guint64 num_acquired = 0;
+    GError *error = NULL;
 
-    request = (UcaNetMessageSetPropertyRequest *) message;
-    pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (camera), request->property_name);
+    /* Slots are first written here, which places them on our NUMA node */
+    state = ucad_pin_acquisition_thread (device);
 
-    g_value_init (&prop_value, g_type_is_a (pspec->value_type, G_TYPE_ENUM) ? G_TYPE_INT : pspec->value_type);
-    g_value_init (&str_value, G_TYPE_STRING);
-    g_value_set_string (&str_value, request->property_value);
-    g_value_transform (&str_value, &prop_value);
+    while (g_atomic_int_get (&acq->running)) {
+        gpointer buffer = ucad_ring_begin_write (acq->ring);
+        UcadRingFrameInfo info = { 0, };
+        gint64 start = g_get_monotonic_time ();
+        gboolean success = ucad_camera_grab (device, buffer, &info, &error);
 
-    g_debug ("Setting `%s' to `%s'", request->property_name, request->property_value);
-    g_object_set_property (G_OBJECT (camera), request->property_name, &prop_value);
-    send_reply (connection, &reply, sizeof (reply), error);
-}
+        UCAD_TRACE (acquire, start, num_acquired, ucad_ring_get_frame_size (acq->ring));
+        ucad_ring_end_write (acq->ring, success, &info);
 
-static void
-handle_simple_request (GSocketConnection *connection, UcaCamera *camera,
-                       UcaNetMessageDefault *message, CameraFunc func, GError **stream_error)
-{
-    UcaNetDefaultReply reply = { .type = message->type };
-    GError *error = NULL;
+        if (!success) {
+            if (g_atomic_int_get (&acq->running)) {
+                g_warning ("Continuous acquisition stopped: %s", error->message);
+                ucad_stats_add (stats->grab_errors, 1);
+            }
 
-    func (camera, &error);
+            g_error_free (error);
+            break;
+        }
 
-    prepare_error_reply (error, &reply.error);
-    send_reply (connection, &reply, sizeof (reply), stream_error);
-}
+        ucad_stats_add (stats->acquired, 1);
+        num_acquired++;
+    }
 
-static void
-handle_start_recording_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
-{
-    handle_simple_request (connection, camera, message, uca_camera_start_recording, error);
+    ucad_ring_close (acq->ring);
+    ucad_affinity_restore_thread (state);
+    return NULL;
 }
 
-static void
-handle_stop_recording_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+static gboolean
+ucad_acquisition_is_running (UcadDevice *device)
 {
-    handle_simple_request (connection, camera, message, uca_camera_stop_recording, error);
+    return g_atomic_pointer_get (&device->acquisition.ring) != NULL;
 }
 
+/**
+ * Start recording and, if a ring size is set, a thread which grabs
+ * continuously into a ring of that many frames.
+ */
 static void
-handle_start_readout_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+ucad_start_recording (UcaCamera *camera, GError **error)
 {
-    handle_simple_request (connection, camera, message, uca_camera_start_readout, error);
-}
+    UcadDevice *device = ucad_device_get (camera);
+    UcadAcquisition *acquisition = &device->acquisition;
+    guint width, height, bitdepth, num_slots;
+    gsize frame_size;
+    UcadRing *ring;
+    GError *tmp_error = NULL;
 
-static void
-handle_stop_readout_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
-{
-    handle_simple_request (connection, camera, message, uca_camera_stop_readout, error);
-}
+    uca_camera_start_recording (camera, &tmp_error);
 
-static void
-handle_trigger_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
-{
-    handle_simple_request (connection, camera, message, uca_camera_trigger, error);
-}
+    if (tmp_error != NULL) {
+        g_propagate_error (error, tmp_error);
+        return;
+    }
 
-static void
-handle_grab_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
-{
-    GOutputStream *output;
-    UcaNetMessageGrabRequest *request;
-    gsize bytes_left;
-    GError *error = NULL;
-    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_GRAB };
-    static gsize size = 0;
-    static gchar *buffer = NULL;
+    if (ring_size == 0 && ring_bytes <= 0)
+        return;
 
-    request = (UcaNetMessageGrabRequest *) message;
-    output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+    g_object_get (camera, "roi-width", &width, "roi-height", &height, "sensor-bitdepth", &bitdepth, NULL);
+    frame_size = (gsize) width * height * (bitdepth <= 8 ? 1 : 2);
+    num_slots = ring_bytes > 0 ? (guint) MIN ((guint64) ring_bytes / MAX (frame_size, 1), G_MAXUINT) : (guint) ring_size;
 
-    if (buffer == NULL || size != request->size) {
-        buffer = g_realloc (buffer, request->size);
-        size = request->size;
-    }
+    g_mutex_lock (&device->history_lock);
+    ucad_ring_free (acquisition->history);
+    acquisition->history = NULL;
+    g_mutex_unlock (&device->history_lock);
+    ring = ucad_ring_new (MAX (num_slots, 2), frame_size, ring_hugepages);
 
-    uca_camera_grab (camera, buffer, &error);
-    prepare_error_reply (error, &reply.error);
-    send_reply (connection, &reply, sizeof (reply), stream_error);
+    if (ring == NULL) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_MEMORY_ALLOCATION_FAILURE,
+                     "Could not allocate ring of %u frames", MAX (num_slots, 2));
+        uca_camera_stop_recording (camera, NULL);
+        return;
+    }
 
-    /* send data if no error occured during grab */
-    if (!reply.error.occurred) {
-        bytes_left = size;
+    acquisition->camera = camera;
+    acquisition->bitdepth = bitdepth;
+    acquisition->running = TRUE;
 
-        while (bytes_left > 0) {
-            gssize written;
+    g_mutex_lock (&device->grab_lock);
+    g_atomic_pointer_set (&acquisition->ring, ring);
+    g_mutex_unlock (&device->grab_lock);
 
-            written = g_output_stream_write (output, &buffer[size - bytes_left], bytes_left, NULL, stream_error);
+    acquisition->thread = g_thread_new ("acquisition", (GThreadFunc) ucad_acquisition_run, acquisition);
+    g_debug ("Acquiring `%s' continuously into %u frames", device->name, ucad_ring_get_num_slots (ring));
+}
 
-            if (written < 0)
-                return;
+static void
+ucad_stop_recording (UcaCamera *camera, GError **error)
+{
+    UcadDevice *device = ucad_device_get (camera);
+    UcadAcquisition *acquisition = &device->acquisition;
+    UcadRing *ring = acquisition->ring;
 
-            bytes_left -= written;
-        }
+    if (ring == NULL) {
+        uca_camera_stop_recording (camera, error);
+        return;
     }
+
+    /* The thread ends with the grab in progress, the camera is only stopped
+     * once no other thread uses it anymore */
+    g_atomic_int_set (&acquisition->running, FALSE);
+    g_thread_join (acquisition->thread);
+    acquisition->thread = NULL;
+    uca_camera_stop_recording (camera, error);
+
+    /* Wait for grab requests reading from the ring */
+    g_mutex_lock (&device->grab_lock);
+    g_atomic_pointer_set (&acquisition->ring, NULL);
+    g_mutex_unlock (&device->grab_lock);
+
+    /* Keep the frames for READ_HISTORY until recording starts again */
+    g_mutex_lock (&device->history_lock);
+    acquisition->history = ring;
+    g_mutex_unlock (&device->history_lock);
 }
 
-static void
-handle_push_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+/**
+ * Grab the next frame into buffer, from ring at position relative to cursor
+ * or from the camera if ring is NULL. Waiting for the ring ends when the
+ * optional cancelled flag is set. The optional frame_info is set to the
+ * configuration generation the frame was acquired with and the times it was
+ * grabbed from the camera, which for frames from a ring are those when it was
+ * written there.
+ */
+static gboolean
+ucad_grab_frame (UcaCamera *camera, UcadRing *ring, UcadRingCursor *cursor, UcadRingPosition position,
+                 gpointer buffer, gsize size, const gint *cancelled, UcadRingFrameInfo *frame_info, GError **error)
 {
-    /* Clear flag if called when not streaming */
-    stop_streaming_requested = FALSE;
+    UcadDevice *device = ucad_device_get (camera);
+    UcadRingFrameInfo info = { 0, };
+    gint64 start = g_get_monotonic_time ();
+    gboolean success;
 
-#ifdef WITH_ZMQ_NETWORKING
-    GError* error = NULL;
-    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_PUSH };
-    UcaNetMessagePushRequest *request;
-    gsize current_frame_size;
-    guint pixel_size, width, height, bitdepth, rotate;
-    gboolean mirror;
-    gint zmq_retval = 0;
-    guint num_endpoints = g_hash_table_size (zmq_endpoints);
-    UcadZmqNode *node;
-    gint64 i;
-    gboolean send_poison_pill;
-    UcadZmqPayload *payload;
-    GHashTableIter iter;
-    GThreadPool *pool = g_thread_pool_new (
-            (GFunc) ucad_zmq_send_images,
-            NULL,
-            (gint) num_endpoints,
-            FALSE,
-            &error
-    );
+    if (ring == NULL) {
+        success = ucad_camera_grab (device, buffer, &info, error);
+    }
+    else if (ucad_ring_get_frame_size (ring) != size) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_FRAME_SIZE_MISMATCH,
+                     "Expected %" G_GSIZE_FORMAT " bytes but frames have %" G_GSIZE_FORMAT,
+                     size, ucad_ring_get_frame_size (ring));
+        success = FALSE;
+    }
+    else {
+        success = ucad_ring_read (ring, cursor, position, buffer, &info, cancelled, error);
+    }
 
-    payload = g_new (UcadZmqPayload, 1);
-    payload->buffer = NULL;
-    payload->header = NULL;
-    payload->buffer_size = 0;
-    payload->header_size = 0;
+    if (success && frame_info != NULL)
+        *frame_info = info;
 
-    if (error != NULL) {
-        goto send_error_reply;
-    }
+    ucad_device_stats_grabbed (&device->stats, start, success);
 
-    request = (UcaNetMessagePushRequest *) message;
+    return success;
+}
 
-    send_poison_pill = request->end;
+static gchar *
+get_camera_list (UcaPluginManager *manager)
+{
+    GList *types;
+    GString *str;
 
-    if (request->num_frames == 0) {
-        goto send_error_reply;
-    }
+    manager = uca_plugin_manager_new ();
+    types = uca_plugin_manager_get_available_cameras (manager);
+    str = g_string_new ("[ ");
 
-    g_hash_table_iter_init (&iter, zmq_endpoints);
+    if (types != NULL) {
+        for (GList *it = g_list_first (types); it != NULL; it = g_list_next (it)) {
+            gchar *name = (gchar *) it->data;
 
-    /* Start threads */
-    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &node)) {
-        if (!g_thread_pool_push (pool, node, &error)) {
-            goto send_error_reply;
+            if (g_list_next (it) == NULL)
+                g_string_append_printf (str, "%s ]", name);
+            else
+                g_string_append_printf (str, "%s, ", name);
         }
     }
+    else {
+        g_string_append (str, "]");
+    }
 
-    g_object_get (camera, "roi-width", &width, "roi-height", &height, "sensor-bitdepth", &bitdepth, "mirror", &mirror, "rotate", &rotate, NULL);
-    pixel_size = bitdepth <= 8 ? 1 : 2;
-    current_frame_size = width * height * pixel_size;
-    g_debug ("Push request for %ld frames of size (%u x %u) and %u bytes per pixel",
-             request->num_frames, width, height, pixel_size);
+    g_list_free_full (types, g_free);
+    g_object_unref (manager);
+    return g_string_free (str, FALSE);
+}
 
-    if (payload->buffer == NULL || payload->buffer_size != current_frame_size) {
-        if ((payload->buffer = g_realloc (payload->buffer, current_frame_size)) == NULL) {
-            g_set_error (&error, UCAD_ERROR, UCAD_ERROR_MEMORY_ALLOCATION_FAILURE,
-                         "Memory allocation failed");
-            goto send_error_reply;
+static GOptionContext *
+uca_option_context_new (UcaPluginManager *manager)
+{
+    GOptionContext *context;
+    gchar *camera_list;
+
+    camera_list = get_camera_list (manager);
+    context = g_option_context_new (camera_list);
+    g_free (camera_list);
+    return context;
+}
+
+static void
+send_reply (GSocketConnection *connection, gpointer data, gsize size, GError **error)
+{
+    GOutputStream *output;
+
+    output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+
+    if (!g_output_stream_write_all (output, data, size, NULL, NULL, error))
+        return;
+
+    if (!g_output_stream_flush (output, NULL, error))
+        return;
+}
+
+/**
+ * Read and discard size bytes that follow a rejected request.
+ */
+static gboolean
+skip_payload (GSocketConnection *connection, gsize size, GError **error)
+{
+    GInputStream *input;
+
+    input = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+
+    while (size > 0) {
+        gssize skipped;
+
+        skipped = g_input_stream_skip (input, MIN (size, G_MAXSSIZE), NULL, error);
+
+        if (skipped < 0)
+            return FALSE;
+
+        if (skipped == 0) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_CLOSED, "Connection closed by client");
+            return FALSE;
         }
-        payload->buffer_size = current_frame_size;
+
+        size -= skipped;
     }
 
-    i = request->num_frames;
-    while (TRUE) {
-        if (request->num_frames >= 0) {
-            /* If the number of requested frames is negative, stream until stop
-             * is requested via UCA_NET_MESSAGE_STOP_PUSH => do not decrement i. */
-            i--;
-        }
-        if (stop_streaming_requested) {
-            /* Whatever number of images was sent, stop immediately */
-            i = 0;
-            send_poison_pill = TRUE;
-            stop_streaming_requested = FALSE;
-            g_debug ("Stop stream upon request");
-        }
-        if (!uca_camera_grab (camera, payload->buffer, &error)) {
-            break;
+    return TRUE;
+}
+
+static void
+prepare_error_reply (GError *error, UcaNetErrorReply *reply)
+{
+    if (error != NULL) {
+        reply->occurred = TRUE;
+        reply->code = error->code;
+        strncpy (reply->domain, g_quark_to_string (error->domain), sizeof (error->domain));
+        strncpy (reply->message, error->message, sizeof (reply->message));
+        g_error_free (error);
+    }
+    else {
+        reply->occurred = FALSE;
+    }
+}
+
+static void
+serialize_param_spec (GParamSpec *pspec, UcaNetMessageProperty *prop)
+{
+    strncpy (prop->name, g_param_spec_get_name (pspec), sizeof (prop->name));
+    strncpy (prop->nick, g_param_spec_get_nick (pspec), sizeof (prop->nick));
+    strncpy (prop->blurb, g_param_spec_get_blurb (pspec), sizeof (prop->blurb));
+
+    prop->value_type = pspec->value_type;
+    prop->flags = pspec->flags;
+    prop->valid = TRUE;
+
+    if (g_type_is_a (pspec->value_type, G_TYPE_ENUM)) {
+        GEnumClass *enum_class;
+
+        enum_class = ((GParamSpecEnum *) pspec)->enum_class;
+        prop->value_type = G_TYPE_ENUM;
+        prop->spec.genum.default_value = ((GParamSpecEnum *) pspec)->default_value;
+        prop->spec.genum.minimum = enum_class->minimum;
+        prop->spec.genum.maximum = enum_class->maximum;
+        prop->spec.genum.n_values = enum_class->n_values;
+
+        if (enum_class->n_values > UCA_NET_MAX_ENUM_LENGTH)
+            g_warning ("Cannot serialize all values of %s", prop->name);
+
+        for (guint i = 0; i < MIN (enum_class->n_values, UCA_NET_MAX_ENUM_LENGTH); i++) {
+            prop->spec.genum.values[i] = enum_class->values[i].value;
+
+            if (strlen (enum_class->values[i].value_name) > UCA_NET_MAX_ENUM_NAME_LENGTH)
+                g_warning ("Enum value name too long, expect serious problems");
+
+            strncpy (prop->spec.genum.value_names[i], enum_class->values[i].value_name,
+                     UCA_NET_MAX_ENUM_NAME_LENGTH);
+
+            strncpy (prop->spec.genum.value_nicks[i], enum_class->values[i].value_nick,
+                     UCA_NET_MAX_ENUM_NAME_LENGTH);
         }
 
-        /* Make new header, update data structures and send request */
-        payload->header = ucad_zmq_create_image_header (payload->buffer, width, height, pixel_size, mirror, rotate, num_sent,
-                                                        &payload->header_size, send_poison_pill);
-        udad_zmq_push_to_all (payload);
+        return;
+    }
 
-        /* Get status from all senders */
-        zmq_retval = udad_zmq_wait_for_all ();
-        free (payload->header);
-        if (zmq_retval < 0) {
-            /* If even only one failed we stop sending, stop the threads without
-             * end of stream and return */
-            g_set_error (&error, UCAD_ERROR, UCAD_ERROR_ZMQ_SENDING_FAILED,
-                         "sending image failed: %s\n", zmq_strerror (zmq_retval));
+#define CASE_NUMERIC(type, storage, typeclass) \
+        case type: \
+            prop->spec.storage.minimum = ((typeclass *) pspec)->minimum; \
+            prop->spec.storage.maximum = ((typeclass *) pspec)->maximum; \
+            prop->spec.storage.default_value = ((typeclass *) pspec)->default_value;
+
+    switch (pspec->value_type) {
+        case G_TYPE_BOOLEAN:
+            prop->spec.gboolean.default_value = ((GParamSpecBoolean *) pspec)->default_value;
             break;
-        } else {
-            num_sent++;
+        case G_TYPE_STRING:
+            strncpy (prop->spec.gstring.default_value, ((GParamSpecString *) pspec)->default_value,
+                     sizeof (prop->spec.gstring.default_value));
+            break;
+        CASE_NUMERIC (G_TYPE_INT, gint, GParamSpecInt)
+            break;
+        CASE_NUMERIC (G_TYPE_INT64, gint64, GParamSpecInt64)
+            break;
+        CASE_NUMERIC (G_TYPE_UINT, guint, GParamSpecUInt)
+            break;
+        CASE_NUMERIC (G_TYPE_UINT64, guint64, GParamSpecUInt64)
+            break;
+        CASE_NUMERIC (G_TYPE_FLOAT, gfloat, GParamSpecFloat)
+            break;
+        CASE_NUMERIC (G_TYPE_DOUBLE, gdouble, GParamSpecDouble)
+            break;
+        default:
+            g_warning ("Cannot serialize property %s", prop->name);
+            prop->valid = FALSE;
+            break;
+    }
+
+#undef CASE_NUMERIC
+}
+
+static const gchar *
+ucad_dtype_to_string (UcaNetDtype dtype)
+{
+    switch (dtype) {
+        case UCA_NET_DTYPE_UINT8:
+            return "uint8";
+        case UCA_NET_DTYPE_UINT16:
+            return "uint16";
+        case UCA_NET_DTYPE_FLOAT32:
+            return "float32";
+        case UCA_NET_DTYPE_UINT32:
+            return "uint32";
+        default:
+            return NULL;
+    }
+}
+
+static gsize
+ucad_dtype_size (UcaNetDtype dtype)
+{
+    switch (dtype) {
+        case UCA_NET_DTYPE_UINT8:
+            return 1;
+        case UCA_NET_DTYPE_UINT16:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+static UcadReferences *
+ucad_references_ref (UcadReferences *refs)
+{
+    g_atomic_int_inc (&refs->ref_count);
+    return refs;
+}
+
+static void
+ucad_references_unref (UcadReferences *refs)
+{
+    if (g_atomic_int_dec_and_test (&refs->ref_count)) {
+        g_free (refs->dark);
+        g_free (refs->flat);
+        g_free (refs->gain);
+        g_free (refs);
+    }
+}
+
+static UcadReferences *
+ucad_references_get (UcadDevice *device)
+{
+    UcadReferences *refs = NULL;
+
+    g_mutex_lock (&device->references_lock);
+
+    if (device->references != NULL)
+        refs = ucad_references_ref (device->references);
+
+    g_mutex_unlock (&device->references_lock);
+    return refs;
+}
+
+/**
+ * Replace the dark or flat reference with data, which is consumed. The other
+ * reference is kept if it has the same dimensions.
+ */
+static void
+ucad_references_update (UcadDevice *device, UcaNetReference which, guint width, guint height, gfloat *data)
+{
+    UcadReferences *refs;
+    UcadReferences *old;
+    gsize n = (gsize) width * height;
+
+    refs = g_new0 (UcadReferences, 1);
+    refs->ref_count = 1;
+    refs->width = width;
+    refs->height = height;
+    refs->gain = g_new (gfloat, n);
+
+    g_mutex_lock (&device->references_lock);
+    old = device->references;
+
+    if (which == UCA_NET_REFERENCE_DARK)
+        refs->dark = data;
+    else
+        refs->flat = data;
+
+    if (old != NULL && old->width == width && old->height == height) {
+        if (refs->dark == NULL && old->dark != NULL) {
+            refs->dark = g_new (gfloat, n);
+            memcpy (refs->dark, old->dark, n * sizeof (gfloat));
         }
 
-        if (i == 0) {
-            /* Send end of stream indicator and stop */
-            payload->buffer_size = 0;
-            payload->header = ucad_zmq_create_image_header (NULL, 0, 0, 0, 0, 0,0, &payload->header_size, send_poison_pill);
-            udad_zmq_push_to_all (payload);
-            zmq_retval = udad_zmq_wait_for_all ();
-            free (payload->header);
-            if (zmq_retval < 0) {
-                g_warning ("sending end of stream failed: %s\n", zmq_strerror (zmq_retval));
-            }
-            break;
+        if (refs->flat == NULL && old->flat != NULL) {
+            refs->flat = g_new (gfloat, n);
+            memcpy (refs->flat, old->flat, n * sizeof (gfloat));
         }
     }
 
-  send_error_reply:
-    g_debug("Pushed %lu frames, poison pill: %d", num_sent, send_poison_pill);
-    if (send_poison_pill) {
-      num_sent = 0;
+    if (refs->dark == NULL)
+        refs->dark = g_new0 (gfloat, n);
+
+    /* Without a flat field we only subtract the dark field */
+    for (gsize i = 0; i < n; i++) {
+        gfloat range = refs->flat != NULL ? refs->flat[i] - refs->dark[i] : 1.0f;
+        refs->gain[i] = range > 0.0f ? 1.0f / range : 0.0f;
+    }
+
+    device->references = refs;
+    g_mutex_unlock (&device->references_lock);
+
+    if (old != NULL)
+        ucad_references_unref (old);
+
+    g_debug ("Updated %s reference (%u x %u)", which == UCA_NET_REFERENCE_DARK ? "dark" : "flat", width, height);
+}
+
+static UcadDevice *
+ucad_device_new (const gchar *name, UcaCamera *camera, UcadAffinity *affinity)
+{
+    UcadDevice *device;
+
+    device = g_new0 (UcadDevice, 1);
+    device->name = g_strdup (name);
+    device->camera = camera;
+    device->affinity = affinity;
+    device->pool = ucad_pool_new (pool_hugepages, pool_mlock);
+    g_mutex_init (&device->access_lock);
+    g_rw_lock_init (&device->property_lock);
+    g_mutex_init (&device->acquisition_lock);
+    g_mutex_init (&device->acquisition_gate);
+    g_mutex_init (&device->pending_lock);
+    g_mutex_init (&device->generation_lock);
+    g_mutex_init (&device->trigger_lock);
+    g_mutex_init (&device->grab_lock);
+    g_mutex_init (&device->history_lock);
+    g_mutex_init (&device->references_lock);
+    g_mutex_init (&device->exclusive_queue.lock);
+    g_queue_init (&device->exclusive_queue.requests);
+    g_mutex_init (&device->ring_queue.lock);
+    g_queue_init (&device->ring_queue.requests);
+    g_queue_init (&device->pending_changes);
+    ucad_device_stats_init (&device->stats, name);
+    g_object_set_data (G_OBJECT (camera), "ucad-device", device);
+
+    return device;
+}
+
+static void
+ucad_grab_buffers_clear (UcadGrabBuffers *buffers)
+{
+    /* The frame itself is freed with the pool */
+    g_free (buffers->packed);
+    g_free (buffers->compressed);
+    g_free (buffers->scratch);
+    ucad_uring_free (buffers->uring);
+}
+
+/*
+ * io_uring of the requests using buffers, which run one after another. Each
+ * set of buffers has its own, so that grabs of different cameras and from the
+ * ring are sent concurrently and the buffers stay registered.
+ */
+static UcadUring *
+ucad_grab_buffers_get_uring (UcadGrabBuffers *buffers)
+{
+    GError *error = NULL;
+
+    if (!use_uring || buffers->uring != NULL || buffers->uring_failed)
+        return buffers->uring;
+
+    buffers->uring = ucad_uring_new (UCAD_URING_QUEUE_DEPTH, &error);
+
+    if (buffers->uring == NULL) {
+        g_warning ("Sending grabs with GIO: %s", error->message);
+        g_error_free (error);
+        buffers->uring_failed = TRUE;
+    }
+
+    return buffers->uring;
+}
+
+static void
+ucad_device_free (UcadDevice *device)
+{
+    if (device->zmq_endpoints != NULL)
+        g_hash_table_destroy (device->zmq_endpoints);
+
+    if (device->references != NULL)
+        ucad_references_unref (device->references);
+
+    ucad_ring_free (device->acquisition.history);
+    ucad_grab_buffers_clear (&device->camera_buffers);
+    ucad_grab_buffers_clear (&device->ring_buffers);
+    ucad_pool_free (device->pool);
+    ucad_device_stats_clear (&device->stats);
+    g_object_set_data (G_OBJECT (device->camera), "ucad-device", NULL);
+    g_object_unref (device->camera);
+    ucad_affinity_free (device->affinity);
+    ucad_affinity_free (device->acquisition_cpus);
+    g_mutex_clear (&device->access_lock);
+    g_rw_lock_clear (&device->property_lock);
+    g_mutex_clear (&device->acquisition_lock);
+    g_mutex_clear (&device->acquisition_gate);
+    g_mutex_clear (&device->pending_lock);
+    g_mutex_clear (&device->generation_lock);
+    g_mutex_clear (&device->trigger_lock);
+    g_mutex_clear (&device->grab_lock);
+    g_mutex_clear (&device->history_lock);
+    g_mutex_clear (&device->references_lock);
+    g_mutex_clear (&device->exclusive_queue.lock);
+    g_mutex_clear (&device->ring_queue.lock);
+    g_free (device->name);
+    g_free (device);
+}
+
+/**
+ * Have frames of the current geometry ready in the pool, so that the first
+ * grab or push does not wait for page faults.
+ */
+static void
+ucad_device_prepare_pool (UcadDevice *device)
+{
+    guint width, height, bitdepth;
+
+    g_object_get (device->camera, "roi-width", &width, "roi-height", &height, "sensor-bitdepth", &bitdepth, NULL);
+    ucad_pool_set_frame_size (device->pool, (gsize) width * height * (bitdepth <= 8 ? 1 : 2), 2);
+}
+
+static UcadDevice *
+ucad_device_lookup (const gchar *name)
+{
+    for (guint i = 0; i < devices->len; i++) {
+        UcadDevice *device = g_ptr_array_index (devices, i);
+
+        if (!g_strcmp0 (device->name, name))
+            return device;
+    }
+
+    return NULL;
+}
+
+#define DEFINE_FLAT_CORRECT(name, in_type, out_type, expr) \
+static void \
+name (const in_type *restrict in, const gfloat *restrict dark, const gfloat *restrict gain, \
+      out_type *restrict out, gsize n, gfloat scale) \
+{ \
+    for (gsize i = 0; i < n; i++) { \
+        gfloat v = ((gfloat) in[i] - dark[i]) * gain[i]; \
+        out[i] = expr; \
+    } \
+}
+
+#define SCALE_TO_U16(v) ((guint16) (CLAMP ((v) * scale, 0.0f, 65535.0f) + 0.5f))
+
+DEFINE_FLAT_CORRECT (ucad_flat_correct_u8_f32, guint8, gfloat, v)
+DEFINE_FLAT_CORRECT (ucad_flat_correct_u16_f32, guint16, gfloat, v)
+DEFINE_FLAT_CORRECT (ucad_flat_correct_u8_u16, guint8, guint16, SCALE_TO_U16 (v))
+DEFINE_FLAT_CORRECT (ucad_flat_correct_u16_u16, guint16, guint16, SCALE_TO_U16 (v))
+
+#undef SCALE_TO_U16
+#undef DEFINE_FLAT_CORRECT
+
+typedef struct {
+    const gchar *input;
+    guint pixel_size;
+    gchar *output;
+    UcaNetDtype dtype;
+    gfloat scale;
+    UcadReferences *refs;
+} UcadFlatCorrection;
+
+static void
+ucad_flat_correct_range (gsize start, gsize end, gpointer user_data)
+{
+    UcadFlatCorrection *fc = (UcadFlatCorrection *) user_data;
+    const gfloat *dark = fc->refs->dark + start;
+    const gfloat *gain = fc->refs->gain + start;
+    const gchar *in = fc->input + start * fc->pixel_size;
+    gsize n = end - start;
+
+    if (fc->dtype == UCA_NET_DTYPE_FLOAT32) {
+        gfloat *out = ((gfloat *) fc->output) + start;
+
+        if (fc->pixel_size == 1)
+            ucad_flat_correct_u8_f32 ((const guint8 *) in, dark, gain, out, n, fc->scale);
+        else
+            ucad_flat_correct_u16_f32 ((const guint16 *) in, dark, gain, out, n, fc->scale);
+    }
+    else {
+        guint16 *out = ((guint16 *) fc->output) + start;
+
+        if (fc->pixel_size == 1)
+            ucad_flat_correct_u8_u16 ((const guint8 *) in, dark, gain, out, n, fc->scale);
+        else
+            ucad_flat_correct_u16_u16 ((const guint16 *) in, dark, gain, out, n, fc->scale);
+    }
+}
+
+/**
+ * Flat field correct a full frame into output, which must hold width * height
+ * pixels of dtype (float32 or uint16). Work is split across the worker pool.
+ */
+static void
+ucad_flat_correct (UcadReferences *refs, const gchar *input, guint pixel_size,
+                   gchar *output, UcaNetDtype dtype, gfloat scale)
+{
+    UcadFlatCorrection fc = {
+        .input = input,
+        .pixel_size = pixel_size,
+        .output = output,
+        .dtype = dtype,
+        .scale = scale,
+        .refs = refs,
+    };
+
+    ucad_parallel_for (ucad_flat_correct_range, (gsize) refs->width * refs->height, 1 << 16, &fc);
+}
+
+#ifdef WITH_ZMQ_NETWORKING
+/**
+ * Create header, if the payload buffer is empty then create a special header
+ * signalling end-of-stream, otherwise make the standard header to be sent along
+ * with the image itself. Returns NULL if nothing needs to be sent.
+ */
+static json_object *
+ucad_zmq_create_image_header (UcadZmqPayload *payload)
+{
+    json_object *tree = NULL;
+    json_object *detail = NULL;
+    char *timestamp;
+
+    if (payload->buffer_size == 0 && !payload->send_poison_pill) {
+        /* Do not send poison pill, we don't need to generate any json structure */
+        return NULL;
+    }
+
+    tree = json_object_new_object();
+
+    /* Frame number */
+    if (payload->buffer_size != 0) {
+        if (payload->frame_number == G_MAXUINT64)  {
+            g_warning("Integer overflow would occur for upcoming frame, num_sent:%lu\n", payload->frame_number);
+        }
+        gchar *frame_number = g_strdup_printf("%lu", payload->frame_number);
+        json_object_object_add(tree, "frame-number", json_object_new_string(frame_number));
+        g_free(frame_number);
+        /* Timestamp */
+        timestamp = g_strdup_printf ("%ld.%d", payload->timestamp / G_USEC_PER_SEC,
+                                     (gint) (payload->timestamp % G_USEC_PER_SEC));
+        json_object_object_add(tree, "timestamp", json_object_new_string(timestamp));
+        g_free (timestamp);
+
+        /* Data type, we assume all detectors having unsigned data types */
+        json_object_object_add(tree, "dtype", json_object_new_string(ucad_dtype_to_string (payload->dtype)));
+
+        /* Image shape */
+        detail = json_object_new_array_ext(2);
+        json_object_array_add(detail, json_object_new_int((gint)payload->height));
+        json_object_array_add(detail, json_object_new_int((gint)payload->width));
+        json_object_object_add(tree, "shape", detail);
+
+        /* Number of property changes applied during the push so far */
+        json_object_object_add(tree, "config-generation", json_object_new_int64((gint64)payload->config_generation));
+
+        // Image transformations that the receiver should apply
+        json_object_object_add(tree, "mirror", json_object_new_boolean(payload->mirror));
+        json_object_object_add(tree, "rotate", json_object_new_int(payload->rotate));
+
+        /* Grabbed frames which were accumulated into this one */
+        if (payload->last_grab > payload->first_grab) {
+            detail = json_object_new_array_ext(2);
+            json_object_array_add(detail, json_object_new_int64((gint64)payload->first_grab));
+            json_object_array_add(detail, json_object_new_int64((gint64)payload->last_grab));
+            json_object_object_add(tree, "frame-range", detail);
+        }
+
+    } else {
+        json_object_object_add(tree, "end", json_object_new_boolean(TRUE));
+    }
+
+    return tree;
+}
+
+static char *
+ucad_zmq_header_to_string (json_object *tree, gsize *length)
+{
+    const char *header;
+    char *result;
+
+    /* Create JSON string */
+    header = json_object_to_json_string_length(tree, JSON_C_TO_STRING_PLAIN, length);
+
+    /* The serialized JSON is owned by the json object, so we duplicate it here... */
+    result = strdup(header);
+
+    /* ...before dereferencing the json structure */
+    json_object_put(tree);
+
+    return result;
+}
+
+/**
+ * Map [offset, offset + 255 / scale] linearly to [0, 255]. Kept free of
+ * branches and aliasing so that the compiler vectorizes it.
+ */
+static void
+ucad_window_u16_to_u8 (const guint16 *restrict in, guint8 *restrict out, gsize n, gfloat offset, gfloat scale)
+{
+    for (gsize i = 0; i < n; i++) {
+        gfloat v = ((gfloat) in[i] - offset) * scale;
+
+        v = v < 0.0f ? 0.0f : v;
+        v = v > 255.0f ? 255.0f : v;
+        out[i] = (guint8) (v + 0.5f);
+    }
+}
+
+static void
+ucad_lut_u16_to_u8 (const guint16 *restrict in, guint8 *restrict out, gsize n, const guint8 *restrict lut)
+{
+    for (gsize i = 0; i < n; i++)
+        out[i] = lut[in[i]];
+}
+
+static void
+ucad_minmax_u16 (const guint16 *restrict in, gsize n, guint *minimum, guint *maximum)
+{
+    guint16 lo = G_MAXUINT16;
+    guint16 hi = 0;
+
+    for (gsize i = 0; i < n; i++) {
+        lo = in[i] < lo ? in[i] : lo;
+        hi = in[i] > hi ? in[i] : hi;
+    }
+
+    *minimum = lo;
+    *maximum = hi;
+}
+
+static void
+ucad_zmq_conversion_update_window (UcadZmqConversion *conversion, UcadZmqPayload *payload)
+{
+    guint lo, hi;
+
+    switch (conversion->window) {
+        case UCA_NET_WINDOW_MANUAL:
+            if (!isfinite (conversion->window_min) || !isfinite (conversion->window_max)) {
+                conversion->window_min = 0;
+                conversion->window_max = G_MAXUINT16;
+            }
+
+            conversion->window_valid = TRUE;
+            break;
+        case UCA_NET_WINDOW_AUTO:
+            ucad_minmax_u16 ((const guint16 *) payload->buffer, payload->width * payload->height, &lo, &hi);
+
+            if (conversion->window_valid) {
+                /* Smooth over a couple of frames to avoid flickering */
+                conversion->window_min = 0.8 * conversion->window_min + 0.2 * lo;
+                conversion->window_max = 0.8 * conversion->window_max + 0.2 * hi;
+            }
+            else {
+                conversion->window_min = lo;
+                conversion->window_max = hi;
+                conversion->window_valid = TRUE;
+            }
+            break;
+        default:
+            conversion->window_min = 0;
+            conversion->window_max = (1 << MIN (payload->bitdepth, 16)) - 1;
+            conversion->window_valid = TRUE;
+            break;
+    }
+
+    if (conversion->window_max <= conversion->window_min)
+        conversion->window_max = conversion->window_min + 1;
+}
+
+static void
+ucad_zmq_conversion_update_lut (UcadZmqConversion *conversion)
+{
+    guint lo;
+    guint hi;
+
+    /* Manual windows come straight from the client and may lie anywhere */
+    lo = (guint) CLAMP (conversion->window_min, 0.0, (gdouble) G_MAXUINT16);
+    hi = (guint) CLAMP (conversion->window_max, 0.0, (gdouble) G_MAXUINT16);
+
+    if (conversion->lut != NULL && conversion->lut_min == lo && conversion->lut_max == hi)
+        return;
+
+    if (conversion->lut == NULL)
+        conversion->lut = g_malloc (G_MAXUINT16 + 1);
+
+    for (guint i = 0; i <= G_MAXUINT16; i++) {
+        gdouble x;
+
+        if (hi <= lo) {
+            /* Empty window, threshold at its lower end */
+            conversion->lut[i] = i < lo ? 0 : 255;
+            continue;
+        }
+
+        x = CLAMP (((gdouble) i - lo) / (gdouble) (hi - lo), 0.0, 1.0);
+        conversion->lut[i] = (guint8) CLAMP (255.0 * pow (x, conversion->gamma) + 0.5, 0.0, 255.0);
+    }
+
+    conversion->lut_min = lo;
+    conversion->lut_max = hi;
+}
+
+static void
+ucad_zmq_conversion_flat_correct (UcadZmqConversion *conversion, UcadDevice *device, UcadZmqPayload *payload,
+                                  gchar **data, gsize *size, UcaNetDtype *data_dtype, json_object *header)
+{
+    UcadReferences *refs;
+    UcaNetDtype dtype;
+    gsize num_pixels = payload->width * payload->height;
+
+    refs = ucad_references_get (device);
+
+    if (refs == NULL || refs->width != payload->width || refs->height != payload->height) {
+        if (!conversion->warned)
+            g_warning ("No matching dark and flat references, sending raw frames");
+
+        conversion->warned = TRUE;
+
+        if (refs != NULL)
+            ucad_references_unref (refs);
+
+        return;
+    }
+
+    conversion->warned = FALSE;
+    dtype = conversion->dtype == UCA_NET_DTYPE_UINT16 ? UCA_NET_DTYPE_UINT16 : UCA_NET_DTYPE_FLOAT32;
+
+    if (conversion->buffer_size != num_pixels * ucad_dtype_size (dtype)) {
+        conversion->buffer_size = num_pixels * ucad_dtype_size (dtype);
+        conversion->buffer = g_realloc (conversion->buffer, conversion->buffer_size);
+    }
+
+    ucad_flat_correct (refs, payload->buffer, payload->pixel_size, conversion->buffer, dtype, conversion->flat_scale);
+    ucad_references_unref (refs);
+
+    json_object_object_add (header, "dtype", json_object_new_string (ucad_dtype_to_string (dtype)));
+    json_object_object_add (header, "flat-corrected", json_object_new_boolean (TRUE));
+
+    if (dtype == UCA_NET_DTYPE_UINT16)
+        json_object_object_add (header, "scale", json_object_new_double (conversion->flat_scale));
+
+    *data = conversion->buffer;
+    *size = conversion->buffer_size;
+    *data_dtype = dtype;
+}
+
+static void
+ucad_zmq_conversion_cast (UcadZmqConversion *conversion, UcadZmqPayload *payload,
+                          gchar **data, gsize *size, UcaNetDtype *data_dtype, json_object *header)
+{
+    gsize num_pixels = payload->width * payload->height;
+
+    if (conversion->buffer_size != num_pixels * ucad_dtype_size (conversion->dtype)) {
+        conversion->buffer_size = num_pixels * ucad_dtype_size (conversion->dtype);
+        conversion->buffer = g_realloc (conversion->buffer, conversion->buffer_size);
+    }
+
+#define CAST_LOOP(in_type, out_type) \
+    { \
+        const in_type *restrict in = (const in_type *) payload->buffer; \
+        out_type *restrict out = (out_type *) conversion->buffer; \
+        for (gsize i = 0; i < num_pixels; i++) \
+            out[i] = (out_type) in[i]; \
+    }
+
+    if (conversion->dtype == UCA_NET_DTYPE_UINT16)
+        CAST_LOOP (guint8, guint16)
+    else if (payload->pixel_size == 1)
+        CAST_LOOP (guint8, gfloat)
+    else
+        CAST_LOOP (guint16, gfloat)
+
+#undef CAST_LOOP
+
+    json_object_object_add (header, "dtype", json_object_new_string (ucad_dtype_to_string (conversion->dtype)));
+    *data = conversion->buffer;
+    *size = conversion->buffer_size;
+    *data_dtype = conversion->dtype;
+}
+
+/**
+ * Convert the payload into the representation requested by the endpoint. On
+ * return, data, size and data_dtype describe either the original or the
+ * converted buffer.
+ */
+static void
+ucad_zmq_conversion_apply (UcadZmqConversion *conversion, UcadDevice *device, UcadZmqPayload *payload,
+                           gchar **data, gsize *size, UcaNetDtype *data_dtype, json_object *header)
+{
+    gsize num_pixels = payload->width * payload->height;
+    json_object *window;
+
+    if (payload->dtype != UCA_NET_DTYPE_UINT8 && payload->dtype != UCA_NET_DTYPE_UINT16) {
+        /* Accumulated frames are sent as they are */
+        return;
+    }
+
+    if (conversion->flat_correct) {
+        ucad_zmq_conversion_flat_correct (conversion, device, payload, data, size, data_dtype, header);
+        return;
+    }
+
+    if ((conversion->dtype == UCA_NET_DTYPE_UINT16 && payload->pixel_size == 1) ||
+        conversion->dtype == UCA_NET_DTYPE_FLOAT32) {
+        ucad_zmq_conversion_cast (conversion, payload, data, size, data_dtype, header);
+        return;
+    }
+
+    if (conversion->dtype != UCA_NET_DTYPE_UINT8 || payload->pixel_size != 2)
+        return;
+
+    if (conversion->buffer_size != num_pixels) {
+        conversion->buffer = g_realloc (conversion->buffer, num_pixels);
+        conversion->buffer_size = num_pixels;
+    }
+
+    ucad_zmq_conversion_update_window (conversion, payload);
+
+    if (conversion->gamma > 0.0 && conversion->gamma != 1.0) {
+        ucad_zmq_conversion_update_lut (conversion);
+        ucad_lut_u16_to_u8 ((const guint16 *) payload->buffer, (guint8 *) conversion->buffer,
+                            num_pixels, conversion->lut);
+    }
+    else {
+        ucad_window_u16_to_u8 ((const guint16 *) payload->buffer, (guint8 *) conversion->buffer, num_pixels,
+                               (gfloat) conversion->window_min,
+                               (gfloat) (255.0 / (conversion->window_max - conversion->window_min)));
+    }
+
+    window = json_object_new_array_ext (2);
+    json_object_array_add (window, json_object_new_double (conversion->window_min));
+    json_object_array_add (window, json_object_new_double (conversion->window_max));
+    json_object_object_add (header, "dtype", json_object_new_string ("uint8"));
+    json_object_object_add (header, "window", window);
+
+    *data = conversion->buffer;
+    *size = num_pixels;
+    *data_dtype = UCA_NET_DTYPE_UINT8;
+}
+
+#define DEFINE_PROJECT(name, in_type, acc_type) \
+static void \
+name (const gchar *data, gsize stride, guint x, guint y, guint width, guint height, \
+      acc_type *restrict rows, acc_type *restrict columns) \
+{ \
+    for (guint j = 0; j < width; j++) \
+        columns[j] = 0; \
+\
+    for (guint i = 0; i < height; i++) { \
+        const in_type *restrict line = ((const in_type *) data) + (y + i) * stride + x; \
+        acc_type sum = 0; \
+\
+        for (guint j = 0; j < width; j++) { \
+            sum += line[j]; \
+            columns[j] += line[j]; \
+        } \
+\
+        rows[i] = sum; \
+    } \
+}
+
+DEFINE_PROJECT (ucad_project_u8, guint8, guint64)
+DEFINE_PROJECT (ucad_project_u16, guint16, guint64)
+DEFINE_PROJECT (ucad_project_u32, guint32, guint64)
+DEFINE_PROJECT (ucad_project_f32, gfloat, gdouble)
+
+#undef DEFINE_PROJECT
+
+#define DEFINE_TILE_CHANGED(name, type) \
+static gboolean \
+name (const gchar *current, const gchar *key, gsize stride, guint width, guint height, gdouble threshold) \
+{ \
+    for (guint i = 0; i < height; i++) { \
+        const type *restrict a = ((const type *) current) + i * stride; \
+        const type *restrict b = ((const type *) key) + i * stride; \
+        gdouble max_diff = 0.0; \
+\
+        for (guint j = 0; j < width; j++) { \
+            gdouble diff = a[j] > b[j] ? (gdouble) a[j] - b[j] : (gdouble) b[j] - a[j]; \
+            max_diff = diff > max_diff ? diff : max_diff; \
+        } \
+\
+        if (max_diff > threshold) \
+            return TRUE; \
+    } \
+\
+    return FALSE; \
+}
+
+DEFINE_TILE_CHANGED (ucad_tile_changed_u8, guint8)
+DEFINE_TILE_CHANGED (ucad_tile_changed_u16, guint16)
+DEFINE_TILE_CHANGED (ucad_tile_changed_u32, guint32)
+DEFINE_TILE_CHANGED (ucad_tile_changed_f32, gfloat)
+
+#undef DEFINE_TILE_CHANGED
+
+static gboolean
+ucad_tile_changed (const gchar *current, const gchar *key, gsize stride, gsize pixel_size,
+                   guint width, guint height, UcaNetDtype dtype, gdouble threshold)
+{
+    if (threshold <= 0.0) {
+        /* Lossless, exact comparison is enough */
+        for (guint i = 0; i < height; i++) {
+            if (memcmp (current + i * stride * pixel_size, key + i * stride * pixel_size, width * pixel_size))
+                return TRUE;
+        }
+
+        return FALSE;
+    }
+
+    switch (dtype) {
+        case UCA_NET_DTYPE_UINT8:
+            return ucad_tile_changed_u8 (current, key, stride, width, height, threshold);
+        case UCA_NET_DTYPE_UINT16:
+            return ucad_tile_changed_u16 (current, key, stride, width, height, threshold);
+        case UCA_NET_DTYPE_UINT32:
+            return ucad_tile_changed_u32 (current, key, stride, width, height, threshold);
+        default:
+            return ucad_tile_changed_f32 (current, key, stride, width, height, threshold);
+    }
+}
+
+/**
+ * Replace data by the tiles which changed with respect to the last key frame or
+ * make this frame the new key frame. Changed tiles are concatenated in row-major
+ * tile order, each tile stored row by row and clipped at the frame border. The
+ * header carries a hex encoded bitmap with one bit per tile (LSB first).
+ */
+static void
+ucad_zmq_tiles_apply (UcadZmqTiles *tiles, UcadZmqPayload *payload,
+                      gchar **data, gsize *size, UcaNetDtype dtype, json_object *header)
+{
+    json_object *detail;
+    guint num_x, num_y, num_changed = 0;
+    gsize pixel_size, offset = 0;
+    guint8 bits = 0;
+
+    detail = json_object_new_object ();
+    json_object_object_add (detail, "size", json_object_new_int ((gint) tiles->size));
+    json_object_object_add (header, "tiles", detail);
+
+    if (tiles->keyframe == NULL || tiles->keyframe_size != *size ||
+        tiles->since_keyframe + 1 >= tiles->keyframe_interval) {
+        tiles->keyframe = g_realloc (tiles->keyframe, *size);
+        tiles->buffer = g_realloc (tiles->buffer, *size);
+        tiles->keyframe_size = *size;
+        tiles->keyframe_number = payload->frame_number;
+        tiles->since_keyframe = 0;
+        memcpy (tiles->keyframe, *data, *size);
+        json_object_object_add (detail, "keyframe", json_object_new_boolean (TRUE));
+        return;
+    }
+
+    tiles->since_keyframe++;
+    pixel_size = *size / ((gsize) payload->width * payload->height);
+    num_x = (payload->width + tiles->size - 1) / tiles->size;
+    num_y = (payload->height + tiles->size - 1) / tiles->size;
+    g_string_truncate (tiles->bitmap, 0);
+
+    for (guint ty = 0; ty < num_y; ty++) {
+        for (guint tx = 0; tx < num_x; tx++) {
+            guint index = ty * num_x + tx;
+            guint x = tx * tiles->size;
+            guint y = ty * tiles->size;
+            guint width = MIN (tiles->size, payload->width - x);
+            guint height = MIN (tiles->size, payload->height - y);
+            gsize start = ((gsize) y * payload->width + x) * pixel_size;
+
+            if (ucad_tile_changed (*data + start, tiles->keyframe + start, payload->width, pixel_size,
+                                   width, height, dtype, tiles->threshold)) {
+                for (guint i = 0; i < height; i++) {
+                    memcpy (tiles->buffer + offset, *data + start + (gsize) i * payload->width * pixel_size,
+                            width * pixel_size);
+                    offset += width * pixel_size;
+                }
+
+                bits |= 1 << (index % 8);
+                num_changed++;
+            }
+
+            if (index % 8 == 7 || index == num_x * num_y - 1) {
+                g_string_append_printf (tiles->bitmap, "%02x", bits);
+                bits = 0;
+            }
+        }
+    }
+
+    json_object_object_add (detail, "keyframe", json_object_new_boolean (FALSE));
+    json_object_object_add (detail, "keyframe-number", json_object_new_int64 ((gint64) tiles->keyframe_number));
+    json_object_object_add (detail, "count", json_object_new_int ((gint) num_changed));
+    json_object_object_add (detail, "bitmap", json_object_new_string (tiles->bitmap->str));
+
+    *data = tiles->buffer;
+    *size = offset;
+}
+
+static void
+ucad_zmq_packing_apply (UcadZmqPacking *packing, UcadZmqPayload *payload, gchar **data, gsize *size,
+                        json_object *header)
+{
+    if (packing->size != *size) {
+        packing->buffer = g_realloc (packing->buffer, *size);
+        packing->size = *size;
+    }
+
+    *size = ucad_pack ((const guint16 *) *data, (guint8 *) packing->buffer, *size / 2, payload->bitdepth);
+    *data = packing->buffer;
+
+    json_object_object_add (header, "packed-bits", json_object_new_int (payload->bitdepth));
+}
+
+static void
+ucad_zmq_compression_apply (UcadZmqCompression *compression, gchar **data, gsize *size,
+                            gsize pixel_size, json_object *header)
+{
+    if (compression->size != *size) {
+        compression->buffer = g_realloc (compression->buffer, uca_net_codec_get_bound (*size));
+        compression->scratch = g_realloc (compression->scratch, *size);
+        compression->size = *size;
+    }
+
+    json_object_object_add (header, "codec", json_object_new_string (uca_net_codec_get_name (compression->codec)));
+    json_object_object_add (header, "size", json_object_new_int64 ((gint64) *size));
+
+    *size = ucad_compress (*data, *size, (guint) pixel_size, compression->buffer, compression->scratch);
+    *data = compression->buffer;
+
+    json_object_object_add (header, "compressed-size", json_object_new_int64 ((gint64) *size));
+}
+
+/**
+ * Replace data by the row sums followed by the column sums (float64) of the
+ * projection region.
+ */
+static void
+ucad_zmq_projection_apply (UcadZmqProjection *projection, UcadZmqPayload *payload,
+                           gchar **data, gsize *size, UcaNetDtype dtype, json_object *header)
+{
+    guint x, y, width, height;
+    gsize num_sums;
+    json_object *roi;
+
+    x = MIN (projection->x, payload->width - 1);
+    y = MIN (projection->y, payload->height - 1);
+    width = projection->width == 0 ? payload->width - x : MIN (projection->width, payload->width - x);
+    height = projection->height == 0 ? payload->height - y : MIN (projection->height, payload->height - y);
+    num_sums = (gsize) width + height;
+
+    if (projection->buffer_size != num_sums * sizeof (gdouble)) {
+        projection->buffer_size = num_sums * sizeof (gdouble);
+        projection->buffer = g_realloc (projection->buffer, projection->buffer_size);
+        projection->sums = g_realloc (projection->sums, num_sums * sizeof (guint64));
+    }
+
+    switch (dtype) {
+        case UCA_NET_DTYPE_FLOAT32:
+            ucad_project_f32 (*data, payload->width, x, y, width, height,
+                              projection->buffer, projection->buffer + height);
+            break;
+        default:
+            if (dtype == UCA_NET_DTYPE_UINT8)
+                ucad_project_u8 (*data, payload->width, x, y, width, height,
+                                 projection->sums, projection->sums + height);
+            else if (dtype == UCA_NET_DTYPE_UINT16)
+                ucad_project_u16 (*data, payload->width, x, y, width, height,
+                                  projection->sums, projection->sums + height);
+            else
+                ucad_project_u32 (*data, payload->width, x, y, width, height,
+                                  projection->sums, projection->sums + height);
+
+            for (gsize i = 0; i < num_sums; i++)
+                projection->buffer[i] = (gdouble) projection->sums[i];
+
+            break;
+    }
+
+    roi = json_object_new_array_ext (4);
+    json_object_array_add (roi, json_object_new_int ((gint) x));
+    json_object_array_add (roi, json_object_new_int ((gint) y));
+    json_object_array_add (roi, json_object_new_int ((gint) width));
+    json_object_array_add (roi, json_object_new_int ((gint) height));
+    json_object_object_del (header, "shape");
+    json_object_object_add (header, "mode", json_object_new_string ("projections"));
+    json_object_object_add (header, "roi", roi);
+    json_object_object_add (header, "rows", json_object_new_int ((gint) height));
+    json_object_object_add (header, "columns", json_object_new_int ((gint) width));
+    json_object_object_add (header, "dtype", json_object_new_string ("float64"));
+
+    *data = (gchar *) projection->buffer;
+    *size = projection->buffer_size;
+}
+
+static UcadZmqFrame *
+ucad_zmq_frame_new (UcadPool *pool, UcadZmqPayload *payload)
+{
+    UcadZmqFrame *frame = g_new (UcadZmqFrame, 1);
+
+    frame->ref_count = 1;
+    frame->pool = pool;
+    frame->data = ucad_pool_acquire (pool, payload->buffer_size);
+    memcpy (frame->data, payload->buffer, payload->buffer_size);
+
+    return frame;
+}
+
+static UcadZmqFrame *
+ucad_zmq_frame_ref (UcadZmqFrame *frame)
+{
+    g_atomic_int_inc (&frame->ref_count);
+    return frame;
+}
+
+static void
+ucad_zmq_frame_unref (UcadZmqFrame *frame)
+{
+    if (frame != NULL && g_atomic_int_dec_and_test (&frame->ref_count)) {
+        ucad_pool_release (frame->pool, frame->data);
+        g_free (frame);
+    }
+}
+
+/**
+ * Queue a copy of the payload. Frames beyond the queue depth go to the spill
+ * file, or if there is none or it fails, we wait until the endpoint catches up.
+ * Once the sender stopped, payloads are dropped.
+ */
+static void
+ucad_zmq_queue_push (UcadZmqQueue *queue, UcadZmqPayload *payload, UcadZmqFrame *frame)
+{
+    UcadZmqQueueEntry *entry;
+    gboolean spilled = FALSE;
+    GError *error = NULL;
+
+    entry = g_new0 (UcadZmqQueueEntry, 1);
+    entry->payload = *payload;
+    entry->payload.buffer = NULL;
+
+    g_mutex_lock (&queue->lock);
+
+    if (frame != NULL && queue->num_in_memory >= queue->depth && queue->spill != NULL && !queue->stopped) {
+        spilled = ucad_spill_write (queue->spill, payload->buffer, payload->buffer_size, &entry->offset, &error);
+
+        if (spilled) {
+            queue->num_on_disk++;
+            queue->num_spilled++;
+            queue->spilled_bytes += payload->buffer_size;
+        }
+        else {
+            g_warning ("%s, waiting for endpoint", error->message);
+            g_error_free (error);
+        }
+    }
+
+    if (frame != NULL && !spilled) {
+        while (queue->num_in_memory >= queue->depth && !queue->stopped)
+            g_cond_wait (&queue->cond, &queue->lock);
+
+        entry->frame = ucad_zmq_frame_ref (frame);
+        entry->payload.buffer = frame->data;
+        queue->num_in_memory++;
+    }
+
+    if (queue->stopped) {
+        ucad_zmq_frame_unref (entry->frame);
+        g_free (entry);
+    }
+    else {
+        g_queue_push_tail (&queue->entries, entry);
+        queue->max_length = MAX (queue->max_length, g_queue_get_length (&queue->entries));
+        ucad_stats_set (queue->length, g_queue_get_length (&queue->entries));
+        g_cond_broadcast (&queue->cond);
+    }
+
+    g_mutex_unlock (&queue->lock);
+}
+
+/**
+ * Take the next payload in order, reading it back if it was spilled. Returns
+ * FALSE if reading failed.
+ */
+static gboolean
+ucad_zmq_queue_pop (UcadZmqQueue *queue, UcadZmqQueueEntry **entry)
+{
+    UcadZmqPayload *payload;
+    GError *error = NULL;
+
+    g_mutex_lock (&queue->lock);
+
+    while (g_queue_is_empty (&queue->entries))
+        g_cond_wait (&queue->cond, &queue->lock);
+
+    *entry = g_queue_pop_head (&queue->entries);
+    ucad_stats_set (queue->length, g_queue_get_length (&queue->entries));
+    g_mutex_unlock (&queue->lock);
+
+    payload = &(*entry)->payload;
+
+    if ((*entry)->frame != NULL || payload->buffer_size == 0)
+        return TRUE;
+
+    if (queue->buffer_size < payload->buffer_size) {
+        g_free (queue->buffer);
+        queue->buffer = g_malloc (payload->buffer_size);
+        queue->buffer_size = payload->buffer_size;
+    }
+
+    if (!ucad_spill_read (queue->spill, (*entry)->offset, queue->buffer, payload->buffer_size, &error)) {
+        g_warning ("%s", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    payload->buffer = queue->buffer;
+
+    return TRUE;
+}
+
+/**
+ * Release a sent entry and let a waiting producer continue. The spill file is
+ * rewound as soon as no spilled frame is pending.
+ */
+static void
+ucad_zmq_queue_release (UcadZmqQueue *queue, UcadZmqQueueEntry *entry)
+{
+    g_mutex_lock (&queue->lock);
+
+    if (entry->frame != NULL)
+        queue->num_in_memory--;
+    else if (entry->payload.buffer_size != 0 && --queue->num_on_disk == 0)
+        ucad_spill_reset (queue->spill);
+
+    ucad_zmq_frame_unref (entry->frame);
+    g_free (entry);
+    g_cond_broadcast (&queue->cond);
+    g_mutex_unlock (&queue->lock);
+}
+
+/**
+ * Drop everything the sender did not get to and stop accepting payloads.
+ */
+static void
+ucad_zmq_queue_stop (UcadZmqQueue *queue)
+{
+    UcadZmqQueueEntry *entry;
+
+    g_mutex_lock (&queue->lock);
+    queue->stopped = TRUE;
+
+    while ((entry = g_queue_pop_head (&queue->entries)) != NULL) {
+        ucad_zmq_frame_unref (entry->frame);
+        g_free (entry);
+    }
+
+    if (queue->num_on_disk > 0)
+        ucad_spill_reset (queue->spill);
+
+    queue->num_in_memory = 0;
+    queue->num_on_disk = 0;
+    g_cond_broadcast (&queue->cond);
+    g_mutex_unlock (&queue->lock);
+}
+
+/**
+ * Push images to all queues, i.e. feed all the sending threads with data.
+ * Queued endpoints get a copy, which they share among themselves.
+ */
+static void
+udad_zmq_push_to_all (GHashTable *endpoints, UcadZmqPayload *payload)
+{
+    GHashTableIter iter;
+    UcadZmqNode *node;
+    UcadZmqFrame *frame = NULL;
+
+    g_hash_table_iter_init (&iter, endpoints);
+
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &node)) {
+        if (node->queue.depth == 0) {
+            g_async_queue_push (node->data_queue, payload);
+            continue;
+        }
+
+        if (frame == NULL && payload->buffer_size != 0)
+            frame = ucad_zmq_frame_new (node->device->pool, payload);
+
+        ucad_zmq_queue_push (&node->queue, payload, frame);
+    }
+
+    ucad_zmq_frame_unref (frame);
+}
+
+/**
+ * Wait for all sockets (and threads) to finish sending one image, i.e. we pop all queues.
+ * Queued endpoints are not waited for, only their last error is checked.
+ */
+static gint
+udad_zmq_wait_for_all (GHashTable *endpoints)
+{
+    GHashTableIter iter;
+    UcadZmqNode *node;
+    gint zmq_retval_all = 0;
+    gint zmq_retval;
+
+    g_hash_table_iter_init (&iter, endpoints);
+
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &node)) {
+        if (node->queue.depth == 0)
+            g_async_queue_pop (node->feedback_queue);
+
+        zmq_retval = g_atomic_int_get (&node->zmq_retval);
+
+        if (zmq_retval < 0) {
+            if (zmq_retval_all < 0) {
+                g_warning ("Multiple streams error");
+            } else {
+                zmq_retval_all = zmq_retval;
+            }
+        }
+    }
+
+    return zmq_retval_all;
+}
+
+/**
+ * Hand one frame to all endpoints of device and wait for those sending in
+ * lockstep. Returns the error of a failed endpoint, if any.
+ */
+static gint
+ucad_zmq_push_frame (UcadDevice *device, UcadZmqPayload *payload)
+{
+    gint64 start = g_get_monotonic_time ();
+    gint64 wait_start;
+    gint zmq_retval;
+
+    payload->enqueued = start;
+    udad_zmq_push_to_all (device->zmq_endpoints, payload);
+    wait_start = g_get_monotonic_time ();
+    zmq_retval = udad_zmq_wait_for_all (device->zmq_endpoints);
+    UCAD_TRACE (wait_for_all, wait_start, payload->frame_number, payload->buffer_size);
+    UCAD_TRACE (push_frame, start, payload->frame_number, payload->buffer_size);
+    ucad_stats_observe (device->stats.push_time, g_get_monotonic_time () - start);
+
+    if (zmq_retval < 0) {
+        ucad_stats_add (device->stats.push_errors, 1);
+    }
+    else {
+        ucad_stats_add (device->stats.pushed, 1);
+        ucad_stats_add (device->stats.pushed_bytes, payload->buffer_size);
+    }
+
+    return zmq_retval;
+}
+
+/**
+ * Hand all endpoints to the sending threads, resetting their queues first.
+ */
+static gboolean
+ucad_zmq_start_senders (GHashTable *endpoints, GThreadPool *pool, GError **error)
+{
+    GHashTableIter iter;
+    UcadZmqNode *node;
+    guint index = 0;
+
+    g_hash_table_iter_init (&iter, endpoints);
+
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &node)) {
+        node->index = index++;
+        node->zmq_retval = 0;
+        node->queue.stopped = FALSE;
+        node->queue.max_length = 0;
+        node->queue.num_spilled = 0;
+        node->queue.spilled_bytes = 0;
+        node->last_sent = 0;
+
+        if (!g_thread_pool_push (pool, node, error))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Log and sum up how far queued endpoints fell behind.
+ */
+static void
+ucad_zmq_report_queues (GHashTable *endpoints, guint *max_depth, guint64 *num_spilled, guint64 *spilled_bytes)
+{
+    GHashTableIter iter;
+    const gchar *endpoint;
+    UcadZmqNode *node;
+
+    g_hash_table_iter_init (&iter, endpoints);
+
+    while (g_hash_table_iter_next (&iter, (gpointer *) &endpoint, (gpointer *) &node)) {
+        if (node->queue.depth == 0)
+            continue;
+
+        g_debug ("Endpoint `%s' queued up to %u frames, spilled %" G_GUINT64_FORMAT " frames (%" G_GUINT64_FORMAT " bytes)",
+                 endpoint, node->queue.max_length, node->queue.num_spilled, node->queue.spilled_bytes);
+
+        *max_depth = MAX (*max_depth, node->queue.max_length);
+        *num_spilled += node->queue.num_spilled;
+        *spilled_bytes += node->queue.spilled_bytes;
+    }
+}
+
+static gboolean
+ucad_zmq_node_open_socket (UcadZmqNode *node, UcaNetMessageAddZmqEndpointRequest *request, gpointer context, GError **error)
+{
+    gint sndhwm = request->sndhwm;
+    gsize size = sizeof (gint);
+
+    if (sndhwm < 0 && request->socket_type == ZMQ_PUB) {
+        /* Live image needs to be the freshest, so do not queue at all */
+        sndhwm = 1;
+    }
+
+    if ((node->socket = zmq_socket (context, request->socket_type)) == NULL) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_SOCKET_CREATION_FAILED,
+                     "zmq socket creation failed: %s\n", zmq_strerror (zmq_errno ()));
+        return FALSE;
+    }
+    if (sndhwm >= 0 && zmq_setsockopt (node->socket, ZMQ_SNDHWM, &sndhwm, sizeof (gint)) != 0) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_SOCKET_CREATION_FAILED,
+                     "zmq setting SNDHWM failed: %s\n", zmq_strerror (zmq_errno ()));
+        return FALSE;
+    }
+    if (zmq_sndbuf > 0 && zmq_setsockopt (node->socket, ZMQ_SNDBUF, &zmq_sndbuf, sizeof (gint)) != 0) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_SOCKET_CREATION_FAILED,
+                     "zmq setting SNDBUF failed: %s\n", zmq_strerror (zmq_errno ()));
+        return FALSE;
+    }
+    if (zmq_getsockopt (node->socket, ZMQ_SNDHWM, &sndhwm, &size) != 0) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_SOCKET_CREATION_FAILED,
+                     "zmq getting SNDHWM failed: %s\n", zmq_strerror (zmq_errno ()));
+        return FALSE;
+    }
+    if (zmq_bind (node->socket, request->endpoint) != 0) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_BIND_FAILED,
+                     "zmq socket bind failed: %s\n", zmq_strerror (zmq_errno ()));
+        return FALSE;
+    }
+    g_debug ("Created socket `%s' of type=%d with SNDHWM=%d", request->endpoint, request->socket_type, sndhwm);
+
+    return TRUE;
+}
+
+static void
+ucad_zmq_node_stats_init (UcadZmqNodeStats *stats, const gchar *camera, const gchar *endpoint)
+{
+    gchar *labels = ucad_stats_labels ("camera", camera, "endpoint", endpoint, NULL);
+
+    stats->header_time = ucad_stats_metric_new (UCAD_STATS_HISTOGRAM, "ucad_endpoint_header_seconds",
+                                                "Time converting a frame and creating its header", labels);
+    stats->send_time = ucad_stats_metric_new (UCAD_STATS_HISTOGRAM, "ucad_endpoint_send_seconds",
+                                              "Time sending or recording header and frame", labels);
+    stats->sent_bytes = ucad_stats_metric_new (UCAD_STATS_COUNTER, "ucad_endpoint_sent_bytes_total",
+                                               "Bytes of headers and frames sent", labels);
+    stats->errors = ucad_stats_metric_new (UCAD_STATS_COUNTER, "ucad_endpoint_errors_total",
+                                           "Frames which could not be sent", labels);
+    stats->queue_length = ucad_stats_metric_new (UCAD_STATS_GAUGE, "ucad_endpoint_queued_frames",
+                                                 "Frames waiting in the queue of the endpoint", labels);
+    g_free (labels);
+}
+
+static void
+ucad_zmq_node_stats_clear (UcadZmqNodeStats *stats)
+{
+    ucad_stats_metric_free (stats->header_time);
+    ucad_stats_metric_free (stats->send_time);
+    ucad_stats_metric_free (stats->sent_bytes);
+    ucad_stats_metric_free (stats->errors);
+    ucad_stats_metric_free (stats->queue_length);
+}
+
+/*
+ * Resolve a path requested by a client below --data-directory. Absolute paths
+ * and parent references are rejected, so that clients cannot create or
+ * truncate files anywhere else the server may write.
+ */
+static gchar *
+ucad_get_data_path (const gchar *path, GError **error)
+{
+    gchar **components;
+    gboolean below = !g_path_is_absolute (path);
+
+    if (data_directory == NULL) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_INVALID_ENDPOINT,
+                     "writing `%s' requires ucad to run with --data-directory\n", path);
+        return NULL;
+    }
+
+    components = g_strsplit_set (path, "/\\", -1);
+
+    for (guint i = 0; below && components[i] != NULL; i++)
+        below = g_strcmp0 (components[i], "..") != 0;
+
+    g_strfreev (components);
+
+    if (!below) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_INVALID_ENDPOINT,
+                     "`%s' is not below the data directory\n", path);
+        return NULL;
+    }
+
+    return g_build_filename (data_directory, path, NULL);
+}
+
+static gboolean
+ucad_zmq_node_init (UcadZmqNode *node, UcadDevice *device, UcaNetMessageAddZmqEndpointRequest *request,
+                    gpointer context, GError **error)
+{
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+    node->device = device;
+    node->socket = NULL;
+    ucad_zmq_node_stats_init (&node->stats, device->name, request->endpoint);
+
+    if (request->dtype < UCA_NET_DTYPE_NATIVE || request->dtype > UCA_NET_DTYPE_FLOAT32) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_INVALID_ENDPOINT,
+                     "unknown data type %d\n", request->dtype);
+        return FALSE;
+    }
+
+    if (request->mode < UCA_NET_ENDPOINT_FRAMES || request->mode > UCA_NET_ENDPOINT_TILES) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_INVALID_ENDPOINT,
+                     "unknown endpoint mode %d\n", request->mode);
+        return FALSE;
+    }
+
+    if (!uca_net_codec_is_available (request->codec)) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_INVALID_ENDPOINT,
+                     "codec %d not available\n", request->codec);
+        return FALSE;
+    }
+
+    if (request->flat_correct && request->dtype == UCA_NET_DTYPE_UINT8) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_INVALID_ENDPOINT,
+                     "flat field corrected frames can only be sent as float32 or uint16\n");
+        return FALSE;
+    }
+
+    request->spill_directory[sizeof (request->spill_directory) - 1] = '\0';
+
+    if (request->spill_directory[0] != '\0' && request->queue_depth == 0) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_INVALID_ENDPOINT,
+                     "spilling frames requires a queue depth\n");
+        return FALSE;
+    }
+
+    node->recorder = NULL;
+
+    if (g_str_has_prefix (request->endpoint, UCAD_RECORD_SCHEME)) {
+        gchar *prefix;
+
+        if ((prefix = ucad_get_data_path (request->endpoint + strlen (UCAD_RECORD_SCHEME), error)) == NULL)
+            return FALSE;
+
+        node->recorder = ucad_recorder_new (prefix, request->max_file_size, error);
+        g_free (prefix);
+
+        if (node->recorder == NULL)
+            return FALSE;
+    }
+    else if (!ucad_zmq_node_open_socket (node, request, context, error)) {
+        return FALSE;
+    }
+
+    node->conversion.dtype = request->dtype;
+    node->conversion.window = request->window;
+    node->conversion.window_min = request->window_min;
+    node->conversion.window_max = request->window_max;
+    node->conversion.gamma = request->gamma;
+    node->conversion.flat_correct = request->flat_correct;
+    node->conversion.flat_scale = request->flat_scale > 0.0 ? request->flat_scale : 16384.0;
+    node->conversion.warned = FALSE;
+
+    node->mode = request->mode;
+    node->projection.x = request->roi_x;
+    node->projection.y = request->roi_y;
+    node->projection.width = request->roi_width;
+    node->projection.height = request->roi_height;
+    node->projection.sums = NULL;
+    node->projection.buffer = NULL;
+    node->projection.buffer_size = 0;
+
+    node->tiles.size = request->tile_size > 0 ? request->tile_size : 64;
+    node->tiles.threshold = request->tile_threshold;
+    node->tiles.keyframe_interval = request->keyframe_interval > 0 ? request->keyframe_interval : 100;
+    node->tiles.keyframe = NULL;
+    node->tiles.keyframe_size = 0;
+    node->tiles.buffer = NULL;
+    node->tiles.bitmap = g_string_new (NULL);
+
+    node->packing.enabled = request->pack;
+    node->packing.buffer = NULL;
+    node->packing.size = 0;
+
+    node->timing = request->timing;
+    node->last_sent = 0;
+
+    node->compression.codec = request->codec;
+    node->compression.buffer = NULL;
+    node->compression.scratch = NULL;
+    node->compression.size = 0;
+    node->conversion.window_valid = FALSE;
+    node->conversion.lut = NULL;
+    node->conversion.buffer = NULL;
+    node->conversion.buffer_size = 0;
+
+    node->zmq_retval = 0;
+    node->data_queue = g_async_queue_new ();
+    node->feedback_queue = g_async_queue_new ();
+
+    node->queue.depth = request->queue_depth;
+    g_mutex_init (&node->queue.lock);
+    g_cond_init (&node->queue.cond);
+    g_queue_init (&node->queue.entries);
+    node->queue.num_in_memory = 0;
+    node->queue.num_on_disk = 0;
+    node->queue.stopped = FALSE;
+    node->queue.spill = NULL;
+    node->queue.buffer = NULL;
+    node->queue.buffer_size = 0;
+    node->queue.length = node->stats.queue_length;
+
+    if (request->spill_directory[0] != '\0') {
+        gchar *directory;
+
+        if ((directory = ucad_get_data_path (request->spill_directory, error)) == NULL)
+            return FALSE;
+
+        node->queue.spill = ucad_spill_new (directory, error);
+
+        if (node->queue.spill != NULL)
+            g_debug ("Spilling frames beyond %u queued ones to `%s'", request->queue_depth, directory);
+
+        g_free (directory);
+
+        if (node->queue.spill == NULL)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+ucad_zmq_node_free (gpointer data)
+{
+    gchar endpoint[128];
+    gsize size = sizeof (endpoint);
+    UcadZmqNode *node = (UcadZmqNode *) data;
+
+    if (node->recorder != NULL) {
+        g_debug ("Closing recording of %" G_GUINT64_FORMAT " frames",
+                 ucad_recorder_get_num_frames (node->recorder));
+        ucad_recorder_free (node->recorder);
+        node->recorder = NULL;
+    } else {
+        if (zmq_getsockopt (node->socket, ZMQ_LAST_ENDPOINT, endpoint, &size)) {
+            g_warning ("zmq_getsockopt failed: %s\n", zmq_strerror (zmq_errno ()));
+        } else {
+            g_debug ("Freeing `%s'", endpoint);
+        }
+
+        if (zmq_close (node->socket)) {
+            g_warning ("zmq socket destruction failed: %s\n", zmq_strerror (zmq_errno ()));
+        }
+        node->socket = NULL;
+    }
+
+    g_async_queue_unref (node->data_queue);
+    g_async_queue_unref (node->feedback_queue);
+    node->data_queue = NULL;
+    node->feedback_queue = NULL;
+    g_free (node->conversion.lut);
+    g_free (node->conversion.buffer);
+    g_free (node->projection.sums);
+    g_free (node->projection.buffer);
+    g_free (node->tiles.keyframe);
+    g_free (node->tiles.buffer);
+    g_string_free (node->tiles.bitmap, TRUE);
+    g_free (node->packing.buffer);
+    g_free (node->compression.buffer);
+    g_free (node->compression.scratch);
+    ucad_spill_free (node->queue.spill);
+    g_free (node->queue.buffer);
+    g_mutex_clear (&node->queue.lock);
+    g_cond_clear (&node->queue.cond);
+    ucad_zmq_node_stats_clear (&node->stats);
+}
+
+/**
+ * Count what was sent since start, unless sending failed.
+ */
+static void
+ucad_zmq_node_stats_sent (UcadZmqNode *node, gint64 start, gsize size)
+{
+    ucad_stats_observe (node->stats.send_time, g_get_monotonic_time () - start);
+
+    if (node->zmq_retval < 0)
+        ucad_stats_add (node->stats.errors, 1);
+    else
+        ucad_stats_add (node->stats.sent_bytes, size);
+}
+
+/**
+ * Describe when the frame was grabbed and handed to the endpoint and when the
+ * endpoint finished sending the previous frame, which is only known now.
+ */
+static void
+ucad_zmq_node_add_timing (UcadZmqNode *node, UcadZmqPayload *payload, json_object *tree)
+{
+    json_object *timing = json_object_new_object ();
+
+    if (payload->grab_start != 0) {
+        json_object_object_add (timing, "grab-start", json_object_new_int64 (payload->grab_start));
+        json_object_object_add (timing, "grab-end", json_object_new_int64 (payload->grab_end));
+    }
+
+    json_object_object_add (timing, "enqueued", json_object_new_int64 (payload->enqueued));
+
+    if (node->last_sent != 0) {
+        json_object_object_add (timing, "previous-frame-number", json_object_new_int64 ((gint64) node->last_frame_number));
+        json_object_object_add (timing, "previous-sent", json_object_new_int64 (node->last_sent));
+    }
+
+    json_object_object_add (tree, "timing", timing);
+}
+
+/**
+ * Append one payload to the recording, or flush it at the end of the stream,
+ * which an image data size of 0 indicates. Returns TRUE if the sender should
+ * stop.
+ */
+static gboolean
+ucad_zmq_record_payload (UcadZmqNode *node, UcadZmqPayload *payload)
+{
+    UcadRecordEntry entry = { 0, };
+    GError *error = NULL;
+    gboolean success;
+
+    if (payload->buffer_size == 0) {
+        success = ucad_recorder_flush (node->recorder, &error);
+    } else {
+        entry.frame_number = payload->frame_number;
+        entry.sequence = payload->first_grab;
+        entry.timestamp = payload->timestamp;
+        entry.size = payload->buffer_size;
+        entry.width = payload->width;
+        entry.height = payload->height;
+        entry.pixel_size = payload->pixel_size;
+        entry.bitdepth = payload->bitdepth;
+        entry.dtype = payload->dtype;
+        success = ucad_recorder_write (node->recorder, &entry, payload->buffer, &error);
+    }
+
+    if (!success) {
+        g_warning ("Recording failed: %s", error->message);
+        g_error_free (error);
+    }
+
+    node->zmq_retval = success ? 0 : -1;
+
+    return payload->buffer_size == 0 || !success;
+}
+
+/**
+ * Convert, compress and send one payload. If the image data size is 0 we just
+ * send the header, which contains an end-of-stream indicator, which tells to the
+ * receiving end that we are done sending images. Returns TRUE if the sender
+ * should stop.
+ */
+static gboolean
+ucad_zmq_send_payload (UcadZmqNode *node, UcadZmqPayload *payload)
+{
+    json_object *tree;
+    gchar *header;
+    gsize header_size;
+    gchar *data;
+    gsize size;
+    UcaNetDtype dtype;
+    gboolean packed;
+    gboolean stop;
+    gint64 start = g_get_monotonic_time ();
+
+    if (node->recorder != NULL) {
+        stop = ucad_zmq_record_payload (node, payload);
+        UCAD_TRACE (record, start, payload->frame_number, payload->buffer_size);
+        ucad_zmq_node_stats_sent (node, start, payload->buffer_size);
+        return stop;
+    }
+
+    tree = ucad_zmq_create_image_header (payload);
+
+    if (tree == NULL) {
+        node->zmq_retval = 0;
+        return TRUE;
+    }
+
+    if (node->timing && payload->buffer_size != 0)
+        ucad_zmq_node_add_timing (node, payload, tree);
+
+    data = payload->buffer;
+    size = payload->buffer_size;
+    dtype = payload->dtype;
+
+    if (size != 0) {
+        ucad_zmq_conversion_apply (&node->conversion, node->device, payload, &data, &size, &dtype, tree);
+
+        if (node->mode == UCA_NET_ENDPOINT_PROJECTIONS)
+            ucad_zmq_projection_apply (&node->projection, payload, &data, &size, dtype, tree);
+        else if (node->mode == UCA_NET_ENDPOINT_TILES)
+            ucad_zmq_tiles_apply (&node->tiles, payload, &data, &size, dtype, tree);
+
+        /* Only frames which passed the conversion unchanged are packed */
+        packed = node->packing.enabled && node->mode == UCA_NET_ENDPOINT_FRAMES &&
+                 data == payload->buffer && dtype == UCA_NET_DTYPE_UINT16 &&
+                 uca_net_pack_is_supported (payload->bitdepth);
+
+        if (packed)
+            ucad_zmq_packing_apply (&node->packing, payload, &data, &size, tree);
+
+        if (node->compression.codec != UCA_NET_CODEC_NONE)
+            ucad_zmq_compression_apply (&node->compression, &data, &size,
+                                        packed ? 1 :
+                                        node->mode == UCA_NET_ENDPOINT_PROJECTIONS ?
+                                        sizeof (gdouble) : ucad_dtype_size (dtype), tree);
+    }
+
+    header = ucad_zmq_header_to_string (tree, &header_size);
+    UCAD_TRACE (zmq_header, start, payload->frame_number, size);
+    ucad_stats_observe (node->stats.header_time, g_get_monotonic_time () - start);
+    start = g_get_monotonic_time ();
+
+    /* First send the header and then the actual payload, which may
+     * be empty if no tile changed */
+    node->zmq_retval = zmq_send (node->socket, header, header_size,
+                                 payload->buffer_size == 0 ? 0 : ZMQ_SNDMORE);
+
+    if (node->zmq_retval >= 0 && payload->buffer_size != 0) {
+        node->zmq_retval = zmq_send (node->socket, data, size, 0);
+    }
+
+    free (header);
+    UCAD_TRACE (zmq_send, start, payload->frame_number, header_size + (payload->buffer_size != 0 ? size : 0));
+    ucad_zmq_node_stats_sent (node, start, header_size + (payload->buffer_size != 0 ? size : 0));
+
+    if (node->zmq_retval >= 0 && payload->buffer_size != 0) {
+        node->last_sent = g_get_monotonic_time ();
+        node->last_frame_number = payload->frame_number;
+    }
+
+    return payload->buffer_size == 0 || node->zmq_retval < 0;
+}
+
+/**
+ * Send queued images in order until the end of the stream or an error, without
+ * holding up the calling thread.
+ */
+static void
+ucad_zmq_send_queued (UcadZmqNode *node)
+{
+    UcadZmqQueueEntry *entry;
+    gboolean stop = FALSE;
+
+    while (!stop) {
+        if (ucad_zmq_queue_pop (&node->queue, &entry)) {
+            stop = ucad_zmq_send_payload (node, &entry->payload);
+        }
+        else {
+            g_atomic_int_set (&node->zmq_retval, -1);
+            stop = TRUE;
+        }
+
+        ucad_zmq_queue_release (&node->queue, entry);
+    }
+
+    ucad_zmq_queue_stop (&node->queue);
+    g_debug ("Sending loop finished");
+}
+
+/**
+ * Send images via a zmq socket and use two-queue synchronization, i.e. when a
+ * payload is ready we pop it from a queue, send it and push a token to the
+ * queue which signals the calling thread about the work being done. Endpoints
+ * with a queue depth are sent from their own queue instead. This function is
+ * running in a thread pool.
+ */
+static void
+ucad_zmq_send_images (UcadZmqNode *node, gpointer static_data)
+{
+    UcadZmqPayload *payload;
+    UcadAffinityState *state;
+    gboolean stop = FALSE;
+
+    /* Each sender gets a CPU of its own if there are enough */
+    if (sender_cpus != NULL)
+        state = ucad_pin_thread (sender_cpus, (gint) node->index, "sending");
+    else
+        state = ucad_pin_thread (node->device->affinity, -1, "sending");
+
+    if (node->queue.depth > 0) {
+        ucad_zmq_send_queued (node);
+        ucad_affinity_restore_thread (state);
+        return;
+    }
+
+    while (!stop) {
+        payload = (UcadZmqPayload *) g_async_queue_pop (node->data_queue);
+        stop = ucad_zmq_send_payload (node, payload);
+
+        /* Control goes to main thread, no more access to payload after this! */
+        g_async_queue_push (node->feedback_queue, &node->zmq_retval);
+    }
+
+    ucad_affinity_restore_thread (state);
+    g_debug ("Sending loop finished");
+}
+
+/* Combines several grabbed frames into one wider frame for the push loop */
+typedef struct {
+    guint count;
+    UcaNetAccumulation mode;
+    guint pixel_size;
+    gsize num_pixels;
+    gchar *frame;
+    guint32 *sum;
+} UcadAccumulator;
+
+static void
+ucad_accumulate_u8 (const guint8 *restrict in, guint32 *restrict sum, gsize n)
+{
+    for (gsize i = 0; i < n; i++)
+        sum[i] += in[i];
+}
+
+static void
+ucad_accumulate_u16 (const guint16 *restrict in, guint32 *restrict sum, gsize n)
+{
+    for (gsize i = 0; i < n; i++)
+        sum[i] += in[i];
+}
+
+static void
+ucad_average_u32 (const guint32 *restrict sum, gfloat *restrict out, gsize n, gfloat scale)
+{
+    for (gsize i = 0; i < n; i++)
+        out[i] = (gfloat) sum[i] * scale;
+}
+
+static void
+ucad_accumulator_init (UcadAccumulator *acc, guint count, UcaNetAccumulation mode, gsize num_pixels, guint pixel_size)
+{
+    acc->count = count;
+    acc->mode = mode;
+    acc->pixel_size = pixel_size;
+    acc->num_pixels = num_pixels;
+    acc->frame = g_malloc (num_pixels * pixel_size);
+    /* Sums are accumulated directly in the payload unless we need to average */
+    acc->sum = mode == UCA_NET_ACCUMULATE_AVERAGE ? g_new (guint32, num_pixels) : NULL;
+}
+
+static void
+ucad_accumulator_clear (UcadAccumulator *acc)
+{
+    g_free (acc->frame);
+    g_free (acc->sum);
+    acc->frame = NULL;
+    acc->sum = NULL;
+}
+
+/* Frames of a burst push, captured at camera speed into memory before or
+ * while they are sent */
+typedef struct {
+    UcadRing *ring;
+    UcaCamera *camera;
+    gsize frame_size;
+    guint64 num_frames;
+    guint64 num_captured;
+    gint stopped;       /* Set to end the capture early */
+    gint64 start_time;
+    gint64 end_time;
+    GError *error;
+} UcadBurst;
+
+static gboolean
+ucad_burst_start (UcadBurst *burst, UcaCamera *camera, UcaNetMessagePushRequest *request,
+                  gsize frame_size, GError **error)
+{
+    burst->num_frames = (guint64) request->num_frames * MAX (request->accumulate, 1);
+
+    if (request->num_frames < 0 || burst->num_frames > G_MAXUINT - 2) {
+        g_set_error_literal (error, UCAD_ERROR, UCAD_ERROR_INVALID_BURST,
+                             "Burst needs a limited number of frames");
+        return FALSE;
+    }
+
+    /* The ring never wraps, so that no frame is overwritten before it is sent */
+    burst->ring = ucad_ring_new ((guint) burst->num_frames + 2, frame_size, ring_hugepages);
+
+    if (burst->ring == NULL) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_MEMORY_ALLOCATION_FAILURE,
+                     "Could not allocate %" G_GUINT64_FORMAT " frames for burst", burst->num_frames);
+        return FALSE;
+    }
+
+    burst->camera = camera;
+    burst->frame_size = frame_size;
+    burst->num_captured = 0;
+    burst->stopped = FALSE;
+    burst->error = NULL;
+    g_debug ("Capturing burst of %" G_GUINT64_FORMAT " frames", burst->num_frames);
+
+    return TRUE;
+}
+
+static gpointer
+ucad_burst_capture (UcadBurst *burst)
+{
+    UcadDevice *device = ucad_device_get (burst->camera);
+    UcadAffinityState *state;
+    UcadRingCursor cursor = { 0, };
+
+    state = ucad_pin_acquisition_thread (device);
+
+    burst->start_time = g_get_monotonic_time ();
+
+    while (burst->num_captured < burst->num_frames && !g_atomic_int_get (&burst->stopped)) {
+        gpointer buffer = ucad_ring_begin_write (burst->ring);
+        UcadRingFrameInfo info = { 0, };
+        gboolean success = ucad_grab_frame (burst->camera, device->acquisition.ring, &cursor, UCAD_RING_NEXT,
+                                            buffer, burst->frame_size, &burst->stopped, &info,
+                                            &burst->error);
+
+        /* Keeps the times of the grab from the camera, also for frames from
+         * the acquisition ring */
+        ucad_ring_end_write (burst->ring, success, &info);
+
+        if (!success)
+            break;
+
+        burst->num_captured++;
+    }
+
+    burst->end_time = g_get_monotonic_time ();
+    ucad_ring_close (burst->ring);
+    ucad_affinity_restore_thread (state);
+
+    return NULL;
+}
+
+/**
+ * Report the capture rate of the finished burst and release it. A capture
+ * error replaces the error of sending, which it caused.
+ */
+static void
+ucad_burst_finish (UcadBurst *burst, UcaNetMessagePushReply *reply, GError **error)
+{
+    gdouble capture_time = (burst->end_time - burst->start_time) / (gdouble) G_TIME_SPAN_SECOND;
+
+    reply->num_captured = burst->num_captured;
+    reply->capture_rate = capture_time > 0 ? burst->num_captured / capture_time : 0;
+    g_debug ("Captured %" G_GUINT64_FORMAT " frames at %.1f frames/s, drained in %.3f s",
+             burst->num_captured, reply->capture_rate, reply->drain_time);
+
+    if (burst->error != NULL) {
+        g_clear_error (error);
+        g_propagate_error (error, burst->error);
+    }
+
+    ucad_ring_free (burst->ring);
+    burst->ring = NULL;
+}
+
+/**
+ * Grab acc->count frames and store their sum (uint32) or average (float32) in
+ * the payload buffer.
+ */
+static gboolean
+ucad_accumulator_grab (UcadAccumulator *acc, UcaCamera *camera, UcadRing *ring, UcadRingCursor *cursor,
+                       UcadRingPosition position, UcadZmqPayload *payload, GError **error)
+{
+    UcadDevice *device = ucad_device_get (camera);
+    guint32 *sum = acc->sum != NULL ? acc->sum : (guint32 *) payload->buffer;
+    gsize frame_size = acc->num_pixels * acc->pixel_size;
+
+    memset (sum, 0, acc->num_pixels * sizeof (guint32));
+    payload->first_grab = device->num_grabbed;
+
+    for (guint i = 0; i < acc->count; i++) {
+        UcadRingFrameInfo info;
+
+        if (!ucad_grab_frame (camera, ring, cursor, position, acc->frame, frame_size,
+                              &device->stop_streaming_requested, &info, error))
+            return FALSE;
+
+        /* A change between the accumulated frames applies from the next sum */
+        if (i == 0) {
+            payload->config_generation = info.generation;
+            payload->grab_start = info.grab_start;
+        }
+
+        payload->grab_end = info.grab_end;
+
+        if (acc->pixel_size == 1)
+            ucad_accumulate_u8 ((const guint8 *) acc->frame, sum, acc->num_pixels);
+        else
+            ucad_accumulate_u16 ((const guint16 *) acc->frame, sum, acc->num_pixels);
+
+        device->num_grabbed++;
+    }
+
+    payload->last_grab = device->num_grabbed - 1;
+
+    if (acc->mode == UCA_NET_ACCUMULATE_AVERAGE)
+        ucad_average_u32 (sum, (gfloat *) payload->buffer, acc->num_pixels, 1.0f / acc->count);
+
+    return TRUE;
+}
+#endif
+
+static void
+handle_get_properties_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+{
+    UcaNetMessageGetPropertiesReply reply = { .type = UCA_NET_MESSAGE_GET_PROPERTIES };
+    GParamSpec **pspecs;
+    guint num_properties;
+
+    pspecs = g_object_class_list_properties (G_OBJECT_GET_CLASS (camera), &num_properties);
+    reply.num_properties = num_properties - N_BASE_PROPERTIES + 1;
+
+    send_reply (connection, &reply, sizeof (reply), error);
+
+    for (guint i = N_BASE_PROPERTIES - 1; i < num_properties; i++) {
+        UcaNetMessageProperty property;
+
+        serialize_param_spec (pspecs[i], &property);
+        send_reply (connection, &property, sizeof (property), error);
+    }
+
+    g_free (pspecs);
+}
+
+static void
+handle_get_property_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+{
+    UcaNetMessageGetPropertyRequest *request;
+    UcaNetMessageGetPropertyReply reply;
+    GParamSpec *pspec;
+    GValue prop_value = {0};
+    GValue str_value = {0};
+
+    request = (UcaNetMessageGetPropertyRequest *) message;
+    pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (camera), request->property_name);
+
+    if (pspec == NULL)
+        return;
+
+    g_value_init (&prop_value, g_type_is_a (pspec->value_type, G_TYPE_ENUM) ? G_TYPE_INT : pspec->value_type);
+    g_object_get_property (G_OBJECT (camera), request->property_name, &prop_value);
+
+    g_value_init (&str_value, G_TYPE_STRING);
+    g_value_transform (&prop_value, &str_value);
+    reply.type = request->type;
+    strncpy (reply.property_value, g_value_get_string (&str_value), sizeof (reply.property_value));
+    send_reply (connection, &reply, sizeof (reply), error);
+    g_debug ("Getting `%s'=`%s'", request->property_name, reply.property_value);
+    g_value_unset (&str_value);
+}
+
+static gboolean
+is_acquisition_property (const gchar *name)
+{
+    for (guint i = 0; acquisition_properties[i] != NULL; i++) {
+        if (!g_strcmp0 (acquisition_properties[i], name))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Whether the property was named with --concurrent-properties, which the
+ * plugin must allow to be read and set while it acquires frames.
+ */
+static gboolean
+is_concurrent_property (const gchar *name)
+{
+    if (concurrent_properties == NULL || is_acquisition_property (name))
+        return FALSE;
+
+    for (guint i = 0; concurrent_properties[i] != NULL; i++) {
+        if (!g_strcmp0 (concurrent_properties[i], name))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Whether an exclusive request only acquires frames. Others also exclude
+ * properties being set concurrently.
+ */
+static gboolean
+is_frame_request (UcaNetMessageType type)
+{
+    switch (type) {
+        case UCA_NET_MESSAGE_GRAB:
+        case UCA_NET_MESSAGE_PUSH:
+        case UCA_NET_MESSAGE_READ_HISTORY:
+        case UCA_NET_MESSAGE_ACQUIRE_REFERENCE:
+        case UCA_NET_MESSAGE_TIMED_TRIGGER:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/*
+ * Whether an exclusive request calls into the plugin, which therefore must
+ * not grab at the same time, not even in the acquisition thread.
+ */
+static gboolean
+is_plugin_request (UcaNetMessageType type)
+{
+    switch (type) {
+        case UCA_NET_MESSAGE_GET_PROPERTY:
+        case UCA_NET_MESSAGE_SET_PROPERTY:
+        case UCA_NET_MESSAGE_START_READOUT:
+        case UCA_NET_MESSAGE_STOP_READOUT:
+        case UCA_NET_MESSAGE_WRITE:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+static void
+set_property_from_string (UcaCamera *camera, GParamSpec *pspec, const gchar *value)
+{
+    GValue prop_value = {0};
+    GValue str_value = {0};
+
+    g_value_init (&prop_value, g_type_is_a (pspec->value_type, G_TYPE_ENUM) ? G_TYPE_INT : pspec->value_type);
+    g_value_init (&str_value, G_TYPE_STRING);
+    g_value_set_string (&str_value, value);
+    g_value_transform (&str_value, &prop_value);
+
+    g_debug ("Setting `%s' to `%s'", pspec->name, value);
+    g_object_set_property (G_OBJECT (camera), pspec->name, &prop_value);
+    g_value_unset (&str_value);
+    g_value_unset (&prop_value);
+}
+
+static void
+handle_set_property_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+{
+    UcaNetMessageSetPropertyRequest *request;
+    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_SET_PROPERTY };
+    GParamSpec *pspec;
+
+    request = (UcaNetMessageSetPropertyRequest *) message;
+    pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (camera), request->property_name);
+
+    set_property_from_string (camera, pspec, request->property_value);
+    send_reply (connection, &reply, sizeof (reply), error);
+
+    if (is_acquisition_property (request->property_name))
+        ucad_device_prepare_pool (ucad_device_get (camera));
+}
+
+/**
+ * Apply all queued property changes at once and start a new configuration
+ * generation for frames grabbed from now on.
+ */
+static void
+ucad_apply_property_changes (UcaCamera *camera)
+{
+    UcadDevice *device = ucad_device_get (camera);
+    UcadPropertyChange *change;
+
+    g_mutex_lock (&device->pending_lock);
+
+    if (!g_queue_is_empty (&device->pending_changes)) {
+        gboolean pausing = FALSE;
+
+        /* Only concurrent properties may change while the camera grabs */
+        for (GList *it = device->pending_changes.head; it != NULL; it = g_list_next (it))
+            pausing |= !is_concurrent_property (((UcadPropertyChange *) it->data)->pspec->name);
+
+        g_rw_lock_writer_lock (&device->property_lock);
+
+        if (pausing)
+            ucad_acquisition_pause (device);
+
+        while ((change = g_queue_pop_head (&device->pending_changes)) != NULL) {
+            set_property_from_string (camera, change->pspec, change->value);
+            g_free (change->value);
+            g_free (change);
+        }
+
+        /* Before grabbing resumes, which stamps frames with it */
+        g_mutex_lock (&device->generation_lock);
+        device->config_generation++;
+        g_mutex_unlock (&device->generation_lock);
+
+        if (pausing)
+            ucad_acquisition_resume (device);
+
+        g_rw_lock_writer_unlock (&device->property_lock);
+        g_debug ("Configuration generation of `%s' %" G_GUINT64_FORMAT, device->name, ucad_device_get_generation (device));
+    }
+
+    g_mutex_unlock (&device->pending_lock);
+}
+
+static void
+handle_queue_property_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+{
+    UcaNetMessageQueuePropertyRequest *request;
+    UcaNetMessageQueuePropertyReply reply = { .type = UCA_NET_MESSAGE_QUEUE_PROPERTY };
+    UcadDevice *device = ucad_device_get (camera);
+    UcadPropertyChange *change;
+    GParamSpec *pspec;
+    GError *error = NULL;
+
+    request = (UcaNetMessageQueuePropertyRequest *) message;
+    request->property_name[sizeof (request->property_name) - 1] = '\0';
+    request->property_value[sizeof (request->property_value) - 1] = '\0';
+    pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (camera), request->property_name);
+
+    if (pspec == NULL || !(pspec->flags & G_PARAM_WRITABLE)) {
+        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_INVALID_PROPERTY,
+                     "`%s' cannot be set", request->property_name);
+    }
+    else if (is_acquisition_property (request->property_name)) {
+        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_INVALID_PROPERTY,
+                     "`%s' changes the frames and cannot be set between them", request->property_name);
+    }
+    else {
+        change = g_new (UcadPropertyChange, 1);
+        change->pspec = pspec;
+        change->value = g_strdup (request->property_value);
+
+        g_mutex_lock (&device->pending_lock);
+        g_queue_push_tail (&device->pending_changes, change);
+        reply.generation = ucad_device_get_generation (device) + 1;
+        g_mutex_unlock (&device->pending_lock);
+
+        /* Without a push there is no frame boundary to wait for */
+        if (!g_atomic_int_get (&device->push_running))
+            ucad_apply_property_changes (camera);
+    }
+
+    prepare_error_reply (error, &reply.error);
+    send_reply (connection, &reply, sizeof (reply), stream_error);
+}
+
+static void
+handle_simple_request (GSocketConnection *connection, UcaCamera *camera,
+                       UcaNetMessageDefault *message, CameraFunc func, GError **stream_error)
+{
+    UcaNetDefaultReply reply = { .type = message->type };
+    GError *error = NULL;
+
+    func (camera, &error);
+
+    prepare_error_reply (error, &reply.error);
+    send_reply (connection, &reply, sizeof (reply), stream_error);
+}
+
+static void
+handle_start_recording_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+{
+    handle_simple_request (connection, camera, message, (CameraFunc) ucad_start_recording, error);
+}
+
+static void
+handle_stop_recording_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+{
+    handle_simple_request (connection, camera, message, (CameraFunc) ucad_stop_recording, error);
+}
+
+static void
+handle_start_readout_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+{
+    handle_simple_request (connection, camera, message, uca_camera_start_readout, error);
+}
+
+static void
+handle_stop_readout_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+{
+    handle_simple_request (connection, camera, message, uca_camera_stop_readout, error);
+}
+
+/* Triggers do not wait for other requests, but for each other */
+static void
+trigger_camera (UcaCamera *camera, GError **error)
+{
+    UcadDevice *device = ucad_device_get (camera);
+
+    g_mutex_lock (&device->trigger_lock);
+    uca_camera_trigger (camera, error);
+    g_mutex_unlock (&device->trigger_lock);
+}
+
+static void
+handle_trigger_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+{
+    handle_simple_request (connection, camera, message, trigger_camera, error);
+}
+
+/**
+ * Count a grab reply and its frame, which were sent since start.
+ */
+static void
+ucad_device_stats_sent (UcadDeviceStats *stats, gint64 start, UcaNetMessageGrabReply *reply, gboolean success)
+{
+    if (!success || reply->error.occurred)
+        return;
+
+    ucad_stats_observe (stats->tcp_time, g_get_monotonic_time () - start);
+    ucad_stats_add (stats->tcp_frames, 1);
+    ucad_stats_add (stats->tcp_bytes, reply->size);
+}
+
+static void
+handle_grab_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+{
+    GOutputStream *outputs[UCA_NET_MAX_STREAMS];
+    GSocketConnection *stripes[UCA_NET_MAX_STREAMS] = { NULL, };
+    UcaNetMessageGrabRequest *request;
+    guint num_streams;
+    GError *error = NULL;
+    UcaNetMessageGrabReply reply = { .type = UCA_NET_MESSAGE_GRAB, .codec = UCA_NET_CODEC_NONE };
+    UcadDevice *device = ucad_device_get (camera);
+    UcadGrabBuffers *buffers;
+    UcadUring *uring;
+    UcadRing *ring;
+    UcadRingCursor cursor = { 0, };
+    UcadRingFrameInfo info = { 0, };
+    gchar *data;
+    guint bitdepth;
+    gsize reply_size = sizeof (reply);
+    gint64 start;
+
+    request = (UcaNetMessageGrabRequest *) message;
+
+    /* Clients of the original request read only the original reply */
+    if (!(request->type & UCA_NET_MESSAGE_EXTENDED)) {
+        memset ((gchar *) request + sizeof (UcaNetMessageOriginalGrabRequest), 0,
+                sizeof (UcaNetMessageGrabRequest) - sizeof (UcaNetMessageOriginalGrabRequest));
+        reply_size = sizeof (UcaNetDefaultReply);
+    }
+
+    num_streams = CLAMP (request->num_streams, 1, UCA_NET_MAX_STREAMS);
+    ring = device->acquisition.ring;
+    buffers = ring != NULL ? &device->ring_buffers : &device->camera_buffers;
+
+    if (buffers->buffer == NULL || buffers->size != request->size) {
+        ucad_pool_release (device->pool, buffers->buffer);
+        buffers->buffer = ucad_pool_acquire (device->pool, request->size);
+        buffers->size = request->size;
+        g_free (buffers->compressed);
+        g_free (buffers->scratch);
+        g_free (buffers->packed);
+        buffers->compressed = NULL;
+        buffers->scratch = NULL;
+        buffers->packed = NULL;
+    }
+
+    start = g_get_monotonic_time ();
+
+    if (ring != NULL) {
+        cursor.next = request->sequence;
+
+        if (ucad_ring_get_frame_size (ring) != request->size)
+            g_set_error (&error, UCAD_ERROR, UCAD_ERROR_FRAME_SIZE_MISMATCH,
+                         "Requested %" G_GSIZE_FORMAT " bytes but frames have %" G_GSIZE_FORMAT,
+                         request->size, ucad_ring_get_frame_size (ring));
+        else
+            ucad_ring_read (ring, &cursor, (UcadRingPosition) request->position, buffers->buffer, &info, NULL, &error);
+    }
+    else {
+        ucad_camera_grab (device, buffers->buffer, NULL, &error);
+    }
+
+    UCAD_TRACE (grab, start, info.sequence, request->size);
+    ucad_device_stats_grabbed (&device->stats, start, error == NULL);
+    ucad_stats_add (device->stats.dropped, cursor.dropped);
+    data = buffers->buffer;
+    reply.size = buffers->size;
+    reply.packed_bits = 0;
+    reply.sequence = info.sequence;
+    reply.dropped = cursor.dropped;
+
+    if (ring != NULL)
+        bitdepth = device->acquisition.bitdepth;
+    else if (error == NULL && (request->pack || request->codec != UCA_NET_CODEC_NONE))
+        g_object_get (camera, "sensor-bitdepth", &bitdepth, NULL);
+
+    if (error == NULL && request->pack && uca_net_pack_is_supported (bitdepth)) {
+        if (buffers->packed == NULL)
+            buffers->packed = g_malloc (buffers->size);
+
+        reply.size = ucad_pack ((const guint16 *) buffers->buffer, (guint8 *) buffers->packed, buffers->size / 2, bitdepth);
+        reply.packed_bits = bitdepth;
+        data = buffers->packed;
+    }
+
+    if (error == NULL && request->codec != UCA_NET_CODEC_NONE && uca_net_codec_is_available (request->codec)) {
+        if (buffers->compressed == NULL) {
+            buffers->compressed = g_malloc (uca_net_codec_get_bound (buffers->size));
+            buffers->scratch = g_malloc (buffers->size);
+        }
+
+        reply.size = ucad_compress (data, reply.size, reply.packed_bits || bitdepth <= 8 ? 1 : 2,
+                                    buffers->compressed, buffers->scratch);
+        reply.codec = request->codec;
+        data = buffers->compressed;
+    }
+
+    /* The stripe connections are collected even if the grab failed, so that
+     * they are released */
+    if (num_streams > 1 && !ucad_stripe_set_wait (request->token, num_streams, stripes, error == NULL ? &error : NULL))
+        num_streams = 1;
+
+    prepare_error_reply (error, &reply.error);
+    start = g_get_monotonic_time ();
+
+    if (num_streams == 1 && (uring = ucad_grab_buffers_get_uring (buffers)) != NULL) {
+        gpointer registered[] = { buffers->buffer, buffers->packed, buffers->compressed };
+        gsize sizes[] = { buffers->size, buffers->size,
+                          buffers->compressed != NULL ? uca_net_codec_get_bound (buffers->size) : 0 };
+
+        /* Reply and frame go out with a single submission */
+        ucad_uring_register_buffers (uring, registered, sizes, G_N_ELEMENTS (registered));
+        ucad_uring_send (uring, connection, &reply, reply_size,
+                         data, reply.error.occurred ? 0 : reply.size, stream_error);
+        UCAD_TRACE (tcp_send, start, reply.sequence, reply.size);
+        ucad_device_stats_sent (&device->stats, start, &reply, *stream_error == NULL);
+        return;
+    }
+
+    send_reply (connection, &reply, reply_size, stream_error);
+
+    /* send data if no error occured during grab */
+    if (!reply.error.occurred) {
+        outputs[0] = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+
+        for (guint i = 1; i < num_streams; i++)
+            outputs[i] = g_io_stream_get_output_stream (G_IO_STREAM (stripes[i]));
+
+        ucad_send_stripes (outputs, num_streams, data, reply.size, stream_error);
+    }
+
+    UCAD_TRACE (tcp_send, start, reply.sequence, reply.size);
+    ucad_device_stats_sent (&device->stats, start, &reply, *stream_error == NULL);
+
+    for (guint i = 1; i < num_streams; i++)
+        g_object_unref (stripes[i]);
+}
+
+/*
+ * Resolve the requested range within the frozen range [oldest, newest] of the
+ * history.
+ */
+static gboolean
+ucad_history_select (UcaNetMessageReadHistoryRequest *request, guint64 oldest, guint64 newest,
+                     guint64 *first, guint64 *count, GError **error)
+{
+    gint64 start;
+
+    if (request->first < 0)
+        start = MAX ((gint64) newest + 1 + request->first, (gint64) oldest);
+    else if (request->first == 0)
+        start = (gint64) oldest;
+    else
+        start = request->first;
+
+    if (newest == 0 || start < (gint64) oldest || start > (gint64) newest) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_NO_HISTORY,
+                     "Frames %" G_GUINT64_FORMAT " to %" G_GUINT64_FORMAT " available, requested %" G_GINT64_FORMAT,
+                     oldest, newest, start);
+        return FALSE;
+    }
+
+    *first = (guint64) start;
+    *count = newest - *first + 1;
+
+    if (request->count > 0)
+        *count = MIN (*count, request->count);
+
+    return TRUE;
+}
+
+#ifdef WITH_ZMQ_NETWORKING
+static gboolean
+ucad_history_push (UcaCamera *camera, UcadRing *ring, guint64 first, guint64 count, gboolean end, GError **error)
+{
+    UcadDevice *device = ucad_device_get (camera);
+    UcadZmqPayload *payload;
+    UcadRingFrameInfo info;
+    GThreadPool *pool;
+    guint width, height, bitdepth, rotate;
+    gboolean mirror;
+    gint zmq_retval = 0;
+    gboolean success = TRUE;
+    guint max_depth = 0;
+    guint64 num_spilled = 0, spilled_bytes = 0;
+
+    if (device->zmq_endpoints == NULL || g_hash_table_size (device->zmq_endpoints) == 0) {
+        g_set_error_literal (error, UCAD_ERROR, UCAD_ERROR_ZMQ_INVALID_ENDPOINT, "No ZMQ endpoints");
+        return FALSE;
+    }
+
+    pool = g_thread_pool_new ((GFunc) ucad_zmq_send_images, NULL,
+                              (gint) g_hash_table_size (device->zmq_endpoints), FALSE, error);
+
+    if (pool == NULL)
+        return FALSE;
+
+    g_object_get (camera, "roi-width", &width, "roi-height", &height, "sensor-bitdepth", &bitdepth,
+                  "mirror", &mirror, "rotate", &rotate, NULL);
+
+    payload = g_new0 (UcadZmqPayload, 1);
+    payload->width = width;
+    payload->height = height;
+    payload->pixel_size = bitdepth <= 8 ? 1 : 2;
+    payload->dtype = bitdepth <= 8 ? UCA_NET_DTYPE_UINT8 : UCA_NET_DTYPE_UINT16;
+    payload->bitdepth = bitdepth;
+    payload->mirror = mirror;
+    payload->rotate = rotate;
+    payload->buffer_size = ucad_ring_get_frame_size (ring);
+    payload->buffer = ucad_pool_acquire (device->pool, payload->buffer_size);
+
+    ucad_zmq_start_senders (device->zmq_endpoints, pool, NULL);
+
+    for (guint64 i = 0; i < count && success; i++) {
+        success = ucad_ring_read_sequence (ring, first + i, payload->buffer, &info, error);
+
+        if (!success)
+            break;
+
+        payload->frame_number = i;
+        payload->first_grab = payload->last_grab = info.sequence;
+        payload->timestamp = info.timestamp;
+        payload->config_generation = info.generation;
+        payload->grab_start = info.grab_start;
+        payload->grab_end = info.grab_end;
+        payload->send_poison_pill = end;
+        zmq_retval = ucad_zmq_push_frame (device, payload);
+
+        if (zmq_retval < 0) {
+            g_set_error (error, UCAD_ERROR, UCAD_ERROR_ZMQ_SENDING_FAILED,
+                         "sending image failed: %s\n", zmq_strerror (zmq_retval));
+            success = FALSE;
+        }
+    }
+
+    /* Stop the senders, which have already stopped on a sending error */
+    if (zmq_retval >= 0) {
+        payload->buffer_size = 0;
+        payload->send_poison_pill = end;
+        udad_zmq_push_to_all (device->zmq_endpoints, payload);
+        udad_zmq_wait_for_all (device->zmq_endpoints);
+    }
+
+    g_thread_pool_free (pool, FALSE, TRUE);
+    ucad_zmq_report_queues (device->zmq_endpoints, &max_depth, &num_spilled, &spilled_bytes);
+    ucad_pool_release (device->pool, payload->buffer);
+    g_free (payload);
+
+    return success;
+}
+#endif
+
+static void
+handle_read_history_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+{
+    UcaNetMessageReadHistoryRequest *request;
+    UcaNetMessageReadHistoryReply reply = { .type = UCA_NET_MESSAGE_READ_HISTORY };
+    UcadDevice *device = ucad_device_get (camera);
+    UcadRing *ring;
+    guint64 oldest, newest;
+    GError *error = NULL;
+
+    request = (UcaNetMessageReadHistoryRequest *) message;
+
+    /* Runs alongside other requests, the history must not be replaced
+     * meanwhile */
+    g_mutex_lock (&device->history_lock);
+    ring = g_atomic_pointer_get (&device->acquisition.ring);
+    ring = ring != NULL ? ring : device->acquisition.history;
+
+    if (ring == NULL) {
+        g_set_error_literal (&error, UCAD_ERROR, UCAD_ERROR_NO_HISTORY,
+                             "No frame history, start ucad with --ring-size or --ring-bytes");
+    }
+    else if (request->target == UCA_NET_HISTORY_RELEASE) {
+        ucad_ring_thaw (ring);
+        g_debug ("Released frame history");
+    }
+    else {
+        ucad_ring_freeze (ring, &oldest, &newest);
+        reply.frame_size = ucad_ring_get_frame_size (ring);
+
+        if (ucad_history_select (request, oldest, newest, &reply.first, &reply.count, &error))
+            g_debug ("Sending history frames %" G_GUINT64_FORMAT " to %" G_GUINT64_FORMAT,
+                     reply.first, reply.first + reply.count - 1);
+    }
+
+    if (error == NULL && request->target == UCA_NET_HISTORY_ZMQ) {
+#ifdef WITH_ZMQ_NETWORKING
+        ucad_history_push (camera, ring, reply.first, reply.count, request->end, &error);
+#else
+        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_ZMQ_NOT_AVAILABLE, "ZMQ not enabled");
+#endif
+        if (error != NULL)
+            reply.count = 0;
+    }
+
+    prepare_error_reply (error, &reply.error);
+    send_reply (connection, &reply, sizeof (reply), stream_error);
+
+    if (error == NULL && request->target == UCA_NET_HISTORY_TCP) {
+        GOutputStream *output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+        gchar *frame = ucad_pool_acquire (device->pool, reply.frame_size);
+
+        /* The range is frozen, so reading can only fail if the frame was
+         * discarded before the freeze took effect */
+        for (guint64 i = 0; i < reply.count; i++) {
+            if (!ucad_ring_read_sequence (ring, reply.first + i, frame, NULL, stream_error) ||
+                !g_output_stream_write_all (output, frame, reply.frame_size, NULL, NULL, stream_error))
+                break;
+        }
+
+        ucad_pool_release (device->pool, frame);
+    }
+
+    if (ring != NULL && request->release && ring == g_atomic_pointer_get (&device->acquisition.ring))
+        ucad_ring_thaw (ring);
+
+    g_mutex_unlock (&device->history_lock);
+}
+
+static void
+handle_timed_trigger_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+{
+    UcaNetMessageTimedTriggerRequest *request;
+    UcaNetMessageTimedTriggerReply reply = { .type = UCA_NET_MESSAGE_TIMED_TRIGGER };
+    UcaNetMessageGrabRequest grab = { .type = UCA_NET_MESSAGE_GRAB | UCA_NET_MESSAGE_EXTENDED };
+    UcadDevice *device = ucad_device_get (camera);
+    gboolean triggered;
+    GError *error = NULL;
+
+    request = (UcaNetMessageTimedTriggerRequest *) message;
+    reply.id = request->id;
+
+    g_mutex_lock (&device->trigger_lock);
+    reply.issued = g_get_monotonic_time ();
+    uca_camera_trigger (camera, &error);
+    reply.completed = g_get_monotonic_time ();
+    g_mutex_unlock (&device->trigger_lock);
+
+    triggered = error == NULL;
+    prepare_error_reply (error, &reply.error);
+    send_reply (connection, &reply, sizeof (reply), stream_error);
+
+    if (!triggered || !request->grab || (stream_error != NULL && *stream_error != NULL))
+        return;
+
+    /* Continue like a plain grab request of the triggered frame */
+    grab.size = request->size;
+    grab.num_streams = 1;
+
+    g_mutex_lock (&device->grab_lock);
+    handle_grab_request (connection, camera, &grab, stream_error);
+    g_mutex_unlock (&device->grab_lock);
+}
+
+static void
+handle_grab_stripe_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **error)
+{
+    UcaNetMessageGrabStripeRequest *request;
+    UcadStripeSet *set;
+
+    request = (UcaNetMessageGrabStripeRequest *) message;
+
+    if (request->index == 0 || request->index >= UCA_NET_MAX_STREAMS) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_INVALID_STRIPE, "Invalid stripe index %u", request->index);
+        return;
+    }
+
+    /* The connection is kept open until the grab request sends its stripe */
+    g_mutex_lock (&stripe_lock);
+    set = ucad_stripe_set_lookup (request->token);
+
+    if (set->num_streams != 0 && request->index >= set->num_streams) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_INVALID_STRIPE,
+                     "Stripe index %u beyond the %u streams of the grab", request->index, set->num_streams);
+    }
+    else if (set->connections[request->index] == NULL) {
+        set->connections[request->index] = g_object_ref (connection);
+        g_cond_broadcast (&stripe_cond);
+    }
+
+    g_mutex_unlock (&stripe_lock);
+}
+
+static void
+handle_push_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+{
+    UcadDevice *device = ucad_device_get (camera);
+
+    /* Clear flag if called when not streaming */
+    device->stop_streaming_requested = FALSE;
+
+#ifdef WITH_ZMQ_NETWORKING
+    GError* error = NULL;
+    UcaNetMessagePushReply reply = { .type = UCA_NET_MESSAGE_PUSH };
+    gboolean extended = (((UcaNetMessageDefault *) message)->type & UCA_NET_MESSAGE_EXTENDED) != 0;
+    UcaNetMessagePushRequest *request;
+    gsize current_frame_size;
+    guint pixel_size, width, height, bitdepth, rotate;
+    gboolean mirror;
+    gint zmq_retval = 0;
+    guint num_endpoints = g_hash_table_size (device->zmq_endpoints);
+    gint64 i;
+    gboolean send_poison_pill;
+    UcadZmqPayload *payload;
+    UcadAccumulator accumulator = { .count = 1 };
+    UcadRingCursor cursor = { 0, };
+    UcadRingFrameInfo info = { 0, };
+    gint64 grab_start;
+    UcadBurst burst = { NULL, };
+    GThread *capture_thread = NULL;
+    UcadRing *source;
+    UcadAffinityState *state = NULL;
+    gint64 drain_start;
+    GThreadPool *pool = g_thread_pool_new (
+            (GFunc) ucad_zmq_send_images,
+            NULL,
+            (gint) num_endpoints,
+            FALSE,
+            &error
+    );
+
+    payload = g_new0 (UcadZmqPayload, 1);
+
+    if (error != NULL) {
+        goto send_error_reply;
+    }
+
+    request = (UcaNetMessagePushRequest *) message;
+
+    send_poison_pill = request->end;
+
+    if (request->num_frames == 0) {
+        goto send_error_reply;
+    }
+
+    /* Start threads */
+    if (!ucad_zmq_start_senders (device->zmq_endpoints, pool, &error)) {
+        goto send_error_reply;
+    }
+
+    g_object_get (camera, "roi-width", &width, "roi-height", &height, "sensor-bitdepth", &bitdepth, "mirror", &mirror, "rotate", &rotate, NULL);
+    pixel_size = bitdepth <= 8 ? 1 : 2;
+    payload->width = width;
+    payload->height = height;
+    payload->pixel_size = pixel_size;
+    payload->dtype = pixel_size == 1 ? UCA_NET_DTYPE_UINT8 : UCA_NET_DTYPE_UINT16;
+    payload->bitdepth = bitdepth;
+    payload->mirror = mirror;
+    payload->rotate = rotate;
+    g_debug ("Push request for %ld frames of size (%u x %u) and %u bytes per pixel",
+             request->num_frames, width, height, pixel_size);
+
+    /* Sums are sent as uint32, which must hold even saturated pixels */
+    if (request->accumulate > G_MAXUINT32 / (pixel_size == 1 ? G_MAXUINT8 : G_MAXUINT16)) {
+        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_INVALID_REQUEST,
+                     "Cannot accumulate more than %u frames of %u bytes per pixel",
+                     G_MAXUINT32 / (pixel_size == 1 ? G_MAXUINT8 : G_MAXUINT16), pixel_size);
+        goto send_error_reply;
+    }
+
+    if (request->accumulate > 1) {
+        ucad_accumulator_init (&accumulator, request->accumulate, request->accumulate_mode,
+                               (gsize) width * height, pixel_size);
+        payload->pixel_size = 4;
+        payload->dtype = request->accumulate_mode == UCA_NET_ACCUMULATE_AVERAGE ?
+                         UCA_NET_DTYPE_FLOAT32 : UCA_NET_DTYPE_UINT32;
+        g_debug ("Accumulating %u frames into one", accumulator.count);
+    }
+
+    current_frame_size = (gsize) width * height * payload->pixel_size;
+    payload->buffer = ucad_pool_acquire (device->pool, current_frame_size);
+    payload->buffer_size = current_frame_size;
+
+    source = device->acquisition.ring;
+
+    if (request->burst) {
+        if (!ucad_burst_start (&burst, camera, request, (gsize) width * height * pixel_size, &error))
+            goto send_error_reply;
+
+        capture_thread = g_thread_new ("burst", (GThreadFunc) ucad_burst_capture, &burst);
+
+        if (!request->drain_during_capture) {
+            g_thread_join (capture_thread);
+            capture_thread = NULL;
+        }
+
+        /* Drain all captured frames in order */
+        source = burst.ring;
+        cursor.next = 1;
+    }
+
+    /* The grab loop borrows this worker, which gets its settings back below */
+    state = ucad_pin_acquisition_thread (device);
+    drain_start = g_get_monotonic_time ();
+    g_atomic_int_set (&device->push_running, TRUE);
+
+    i = request->num_frames;
+    while (TRUE) {
+        if (request->num_frames >= 0) {
+            /* If the number of requested frames is negative, stream until stop
+             * is requested via UCA_NET_MESSAGE_STOP_PUSH => do not decrement i. */
+            i--;
+        }
+        if (device->stop_streaming_requested) {
+            /* Whatever number of images was sent, stop immediately */
+            i = 0;
+            send_poison_pill = TRUE;
+            device->stop_streaming_requested = FALSE;
+            g_debug ("Stop stream upon request");
+        }
+
+        /* Settings changed since the last frame apply to the next one grabbed
+         * from the camera, frames read from a ring keep the generation they
+         * were acquired with */
+        ucad_apply_property_changes (camera);
+        grab_start = g_get_monotonic_time ();
+
+        if (accumulator.count > 1) {
+            if (!ucad_accumulator_grab (&accumulator, camera, source, &cursor, (UcadRingPosition) request->position,
+                                        payload, &error)) {
+                break;
+            }
+        } else {
+            if (!ucad_grab_frame (camera, source, &cursor, (UcadRingPosition) request->position,
+                                  payload->buffer, payload->buffer_size, &device->stop_streaming_requested,
+                                  &info, &error)) {
+                break;
+            }
+            payload->first_grab = payload->last_grab = device->num_grabbed++;
+            payload->config_generation = info.generation;
+            payload->grab_start = info.grab_start;
+            payload->grab_end = info.grab_end;
+        }
+
+        UCAD_TRACE (push_grab, grab_start, device->num_sent, payload->buffer_size);
+
+        /* Update frame metadata and send request */
+        payload->frame_number = device->num_sent;
+        payload->timestamp = g_get_real_time ();
+        payload->send_poison_pill = send_poison_pill;
+
+        /* Get status from all senders */
+        zmq_retval = ucad_zmq_push_frame (device, payload);
+        if (zmq_retval < 0) {
+            /* If even only one failed we stop sending, stop the threads without
+             * end of stream and return */
+            g_set_error (&error, UCAD_ERROR, UCAD_ERROR_ZMQ_SENDING_FAILED,
+                         "sending image failed: %s\n", zmq_strerror (zmq_retval));
+            break;
+        } else {
+            device->num_sent++;
+        }
+
+        if (i == 0) {
+            /* Send end of stream indicator and stop */
+            payload->buffer_size = 0;
+            payload->send_poison_pill = send_poison_pill;
+            udad_zmq_push_to_all (device->zmq_endpoints, payload);
+            zmq_retval = udad_zmq_wait_for_all (device->zmq_endpoints);
+            if (zmq_retval < 0) {
+                g_warning ("sending end of stream failed: %s\n", zmq_strerror (zmq_retval));
+            }
+            break;
+        }
+    }
+
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        /* Stopped while waiting for the next frame of a ring */
+        g_clear_error (&error);
+        device->stop_streaming_requested = FALSE;
+        send_poison_pill = TRUE;
+        payload->buffer_size = 0;
+        payload->send_poison_pill = TRUE;
+        udad_zmq_push_to_all (device->zmq_endpoints, payload);
+
+        if ((zmq_retval = udad_zmq_wait_for_all (device->zmq_endpoints)) < 0)
+            g_warning ("sending end of stream failed: %s\n", zmq_strerror (zmq_retval));
+    }
+
+    reply.drain_time = (g_get_monotonic_time () - drain_start) / (gdouble) G_TIME_SPAN_SECOND;
+    UCAD_TRACE (push, drain_start, device->num_sent, current_frame_size);
+
+  send_error_reply:
+    ucad_affinity_restore_thread (state);
+
+    /* Changes queued after the last frame are applied right away */
+    g_atomic_int_set (&device->push_running, FALSE);
+    ucad_apply_property_changes (camera);
+
+    if (burst.ring != NULL) {
+        if (capture_thread != NULL) {
+            g_atomic_int_set (&burst.stopped, TRUE);
+            g_thread_join (capture_thread);
+        }
+
+        ucad_burst_finish (&burst, &reply, &error);
+    }
+
+    g_debug("Pushed %lu frames, poison pill: %d", device->num_sent, send_poison_pill);
+    if (cursor.dropped > 0)
+      g_debug("Dropped %" G_GUINT64_FORMAT " frames of the acquisition", cursor.dropped);
+    ucad_stats_add (device->stats.dropped, cursor.dropped);
+    if (send_poison_pill) {
+      device->num_sent = 0;
+      device->num_grabbed = 0;
+    }
+    g_thread_pool_free(pool, FALSE, TRUE);
+    ucad_zmq_report_queues (device->zmq_endpoints, &reply.max_queue_depth, &reply.num_spilled, &reply.spilled_bytes);
+    ucad_accumulator_clear(&accumulator);
+    ucad_pool_release (device->pool, payload->buffer);
+    g_free(payload);
+    prepare_error_reply(error, &reply.error);
+    send_reply(connection, &reply, extended ? sizeof (reply) : sizeof (UcaNetDefaultReply), stream_error);
+
+#else
+    g_set_error (stream_error, UCAD_ERROR, UCAD_ERROR_ZMQ_NOT_AVAILABLE,
+        "ZMQ not enabled");
+#endif
+}
+
+static void
+handle_stop_push_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+{
+#ifdef WITH_ZMQ_NETWORKING
+    g_debug ("Stop push request");
+    ucad_device_get (camera)->stop_streaming_requested = TRUE;
+    UcaNetDefaultReply reply = { .type = ((UcaNetMessageDefault *) message)->type };
+    send_reply (connection, &reply, sizeof (reply), stream_error);
+#else
+  g_set_error(stream_error, UCAD_ERROR, UCAD_ERROR_ZMQ_NOT_AVAILABLE,
+      "ZMQ not enabled");
+#endif
+}
+
+#ifdef WITH_ZMQ_NETWORKING
+/**
+ * Let the pool keep as many buffers as the deepest endpoint queue holds, so
+ * that queued copies of frames are reused instead of allocated and faulted in
+ * for every frame.
+ */
+static void
+ucad_zmq_update_pool (UcadDevice *device)
+{
+    GHashTableIter iter;
+    gpointer node;
+    guint depth = 0;
+
+    g_hash_table_iter_init (&iter, device->zmq_endpoints);
+
+    while (g_hash_table_iter_next (&iter, NULL, &node))
+        depth = MAX (depth, ((UcadZmqNode *) node)->queue.depth);
+
+    /* Besides the queued copies, the grabbed frame and the one being sent */
+    ucad_pool_set_max_idle (device->pool, depth + 2);
+}
+#endif
+
+static void
+handle_zmq_add_endpoint_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+{
+#ifdef WITH_ZMQ_NETWORKING
+    UcaNetMessageAddZmqEndpointRequest *request = (UcaNetMessageAddZmqEndpointRequest *) message;
+    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_ZMQ_ADD_ENDPOINT };
+    UcadDevice *device = ucad_device_get (camera);
+    UcadZmqNode *node = g_new (UcadZmqNode, 1);
+    GError *error = NULL;
+
+    if (device->zmq_endpoints == NULL) {
+        device->zmq_endpoints = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, ucad_zmq_node_free);
+    }
+
+    if (g_hash_table_lookup (device->zmq_endpoints, request->endpoint) == NULL) {
+        g_debug ("Adding endpoint `%s' to `%s'", request->endpoint, device->name);
+        if (!ucad_zmq_node_init (node, device, request, zmq_context, &error)) {
+            ucad_zmq_node_stats_clear (&node->stats);
+            goto send_error_reply;
+        }
+        g_hash_table_insert (device->zmq_endpoints, g_strdup (request->endpoint), node);
+        ucad_zmq_update_pool (device);
+    } else {
+        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_ZMQ_INVALID_ENDPOINT,
+                     "zmq endpoint already in list: %s\n", request->endpoint);
+        g_debug ("Endpoint `%s' already in list", request->endpoint);
+    }
+
+send_error_reply:
+    prepare_error_reply (error, &reply.error);
+    send_reply (connection, &reply, sizeof (reply), stream_error);
+    g_debug ("Current number of endpoints: %d", g_hash_table_size (device->zmq_endpoints));
+#else
+    g_set_error(stream_error, UCAD_ERROR, UCAD_ERROR_ZMQ_NOT_AVAILABLE,
+        "ZMQ not enabled");
+#endif
+}
+
+static void
+handle_zmq_remove_endpoint_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+{
+#ifdef WITH_ZMQ_NETWORKING
+    UcaNetMessageRemoveZmqEndpointRequest *request = (UcaNetMessageRemoveZmqEndpointRequest *) message;
+    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_ZMQ_REMOVE_ENDPOINT };
+    UcadDevice *device = ucad_device_get (camera);
+    GError *error = NULL;
+    UcadZmqNode *node = g_hash_table_lookup (device->zmq_endpoints, request->endpoint);
+
+    if (node == NULL) {
+        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_ZMQ_INVALID_ENDPOINT,
+                     "zmq endpoint not in list: %s\n", request->endpoint);
+        g_debug ("Endpoint `%s' not in list", request->endpoint);
+    } else {
+        g_hash_table_remove (device->zmq_endpoints, request->endpoint);
+        ucad_zmq_update_pool (device);
+        g_debug ("Removed endpoint `%s'", request->endpoint);
+    }
+
+    prepare_error_reply (error, &reply.error);
+    send_reply (connection, &reply, sizeof (reply), stream_error);
+    g_debug ("Current number of endpoints: %d", g_hash_table_size (device->zmq_endpoints));
+#else
+    g_set_error(stream_error, UCAD_ERROR, UCAD_ERROR_ZMQ_NOT_AVAILABLE,
+        "ZMQ not enabled");
+#endif
+}
+
+static void
+handle_zmq_remove_all_endpoints_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+{
+#ifdef WITH_ZMQ_NETWORKING
+    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_ZMQ_REMOVE_ALL_ENDPOINTS };
+    UcadDevice *device = ucad_device_get (camera);
+
+    if (device->zmq_endpoints != NULL) {
+        g_hash_table_remove_all (device->zmq_endpoints);
+        ucad_zmq_update_pool (device);
+    }
+    send_reply (connection, &reply, sizeof (reply), stream_error);
+    g_debug ("All endpoints removed");
+#else
+    g_set_error(stream_error, UCAD_ERROR, UCAD_ERROR_ZMQ_NOT_AVAILABLE,
+        "ZMQ not enabled");
+#endif
+}
+
+static void
+handle_write_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+{
+    GInputStream *input;
+    UcaNetMessageWriteRequest *request;
+    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_WRITE };
+    gchar *buffer;
+    gsize bytes_left;
+    GError *error = NULL;
+
+    input = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+    request = (UcaNetMessageWriteRequest *) message;
+    buffer = g_malloc0 (request->size);
+    bytes_left = request->size;
+
+    while (bytes_left > 0) {
+        gssize read;
+
+        read = g_input_stream_read (input, &buffer[request->size - bytes_left], bytes_left, NULL, stream_error);
+
+        if (read < 0)
+            goto handle_write_request_cleanup;
+
+        bytes_left -= read;
+    }
+
+    uca_camera_write (camera, request->name, buffer, request->size, &error);
+
+    prepare_error_reply (error, &reply.error);
+    send_reply (connection, &reply, sizeof (reply), stream_error);
+
+handle_write_request_cleanup:
+    g_free (buffer);
+}
+
+static void
+handle_set_reference_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+{
+    UcaNetMessageSetReferenceRequest *request;
+    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_SET_REFERENCE };
+    gchar *buffer = NULL;
+    gfloat *data;
+    gsize num_pixels;
+    gsize bytes_read;
+    GError *error = NULL;
+
+    request = (UcaNetMessageSetReferenceRequest *) message;
+    num_pixels = (gsize) request->width * request->height;
+
+    if (request->reference != UCA_NET_REFERENCE_DARK && request->reference != UCA_NET_REFERENCE_FLAT) {
+        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_INVALID_REFERENCE,
+                     "Unknown reference kind %i", request->reference);
+    }
+    else if (request->dtype != UCA_NET_DTYPE_UINT8 && request->dtype != UCA_NET_DTYPE_UINT16 &&
+             request->dtype != UCA_NET_DTYPE_FLOAT32) {
+        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_INVALID_REFERENCE,
+                     "References must be uint8, uint16 or float32");
+    }
+    else if (request->width > UCAD_MAX_REFERENCE_SIZE || request->height > UCAD_MAX_REFERENCE_SIZE ||
+             request->size != num_pixels * ucad_dtype_size (request->dtype)) {
+        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_INVALID_REFERENCE,
+                     "Reference of %" G_GSIZE_FORMAT " bytes does not match %u x %u pixels",
+                     request->size, request->width, request->height);
+    }
+    else if ((buffer = g_try_malloc (request->size)) == NULL) {
+        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_INVALID_REFERENCE,
+                     "Not enough memory for a %u x %u reference", request->width, request->height);
+    }
+
+    if (error != NULL) {
+        /* Drop the data that follows to stay in sync with the client */
+        if (!skip_payload (connection, request->size, stream_error)) {
+            g_error_free (error);
+            return;
+        }
+
+        prepare_error_reply (error, &reply.error);
+        send_reply (connection, &reply, sizeof (reply), stream_error);
+        return;
+    }
+
+    if (!g_input_stream_read_all (g_io_stream_get_input_stream (G_IO_STREAM (connection)),
+                                  buffer, request->size, &bytes_read, NULL, stream_error))
+        goto handle_set_reference_request_cleanup;
+
+    if (bytes_read != request->size) {
+        g_set_error (stream_error, G_IO_ERROR, G_IO_ERROR_CLOSED, "Connection closed by client");
+        goto handle_set_reference_request_cleanup;
+    }
+
+    data = g_new (gfloat, num_pixels);
+
+    for (gsize i = 0; i < num_pixels; i++) {
+        switch (request->dtype) {
+            case UCA_NET_DTYPE_UINT8:
+                data[i] = ((guint8 *) buffer)[i];
+                break;
+            case UCA_NET_DTYPE_UINT16:
+                data[i] = ((guint16 *) buffer)[i];
+                break;
+            default:
+                data[i] = ((gfloat *) buffer)[i];
+                break;
+        }
+    }
+
+    ucad_references_update (ucad_device_get (camera), request->reference, request->width, request->height, data);
+
+    prepare_error_reply (error, &reply.error);
+    send_reply (connection, &reply, sizeof (reply), stream_error);
+
+handle_set_reference_request_cleanup:
+    g_free (buffer);
+}
+
+static void
+handle_acquire_reference_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+{
+    UcaNetMessageAcquireReferenceRequest *request;
+    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_ACQUIRE_REFERENCE };
+    UcadDevice *device = ucad_device_get (camera);
+    guint width, height, bitdepth, num_frames;
+    gsize num_pixels;
+    gchar *frame;
+    gdouble *sum;
+    UcadRingCursor cursor = { 0, };
+    GError *error = NULL;
+
+    request = (UcaNetMessageAcquireReferenceRequest *) message;
+    num_frames = MAX (request->num_frames, 1);
+
+    g_object_get (camera, "roi-width", &width, "roi-height", &height, "sensor-bitdepth", &bitdepth, NULL);
+    num_pixels = (gsize) width * height;
+    frame = ucad_pool_acquire (device->pool, num_pixels * (bitdepth <= 8 ? 1 : 2));
+    sum = g_new0 (gdouble, num_pixels);
+
+    for (guint i = 0; i < num_frames && error == NULL; i++) {
+        if (!ucad_grab_frame (camera, device->acquisition.ring, &cursor, UCAD_RING_NEXT,
+                              frame, num_pixels * (bitdepth <= 8 ? 1 : 2), NULL, NULL, &error))
+            break;
+
+        if (bitdepth <= 8) {
+            for (gsize j = 0; j < num_pixels; j++)
+                sum[j] += ((guint8 *) frame)[j];
+        }
+        else {
+            for (gsize j = 0; j < num_pixels; j++)
+                sum[j] += ((guint16 *) frame)[j];
+        }
+    }
+
+    if (error == NULL) {
+        gfloat *data = g_new (gfloat, num_pixels);
+
+        for (gsize j = 0; j < num_pixels; j++)
+            data[j] = (gfloat) (sum[j] / num_frames);
+
+        ucad_references_update (device, request->reference, width, height, data);
+    }
+
+    g_free (sum);
+    ucad_pool_release (device->pool, frame);
+    prepare_error_reply (error, &reply.error);
+    send_reply (connection, &reply, sizeof (reply), stream_error);
+}
+
+/**
+ * Classify a request by what it may run concurrently with.
+ */
+static UcadAccess
+get_access (UcaNetMessageDefault *message)
+{
+    UcaNetMessageGetPropertyRequest *get_request;
+    UcaNetMessageSetPropertyRequest *set_request;
+
+    switch (UCA_NET_MESSAGE_GET_TYPE (message->type)) {
+        case UCA_NET_MESSAGE_GET_PROPERTIES:
+            /* Only describes the properties of the class */
+            return UCAD_ACCESS_QUERY;
+        case UCA_NET_MESSAGE_GET_PROPERTY:
+            get_request = (UcaNetMessageGetPropertyRequest *) message;
+            get_request->property_name[sizeof (get_request->property_name) - 1] = '\0';
+
+            return is_concurrent_property (get_request->property_name) ? UCAD_ACCESS_QUERY : UCAD_ACCESS_EXCLUSIVE;
+        case UCA_NET_MESSAGE_SET_PROPERTY:
+            set_request = (UcaNetMessageSetPropertyRequest *) message;
+            set_request->property_name[sizeof (set_request->property_name) - 1] = '\0';
+
+            return is_concurrent_property (set_request->property_name) ? UCAD_ACCESS_SETTER : UCAD_ACCESS_EXCLUSIVE;
+        case UCA_NET_MESSAGE_TIMED_TRIGGER:
+            return ((UcaNetMessageTimedTriggerRequest *) message)->grab ? UCAD_ACCESS_EXCLUSIVE : UCAD_ACCESS_FREE;
+        case UCA_NET_MESSAGE_READ_HISTORY:
+            /* Sending to the endpoints would interfere with a push */
+            return ((UcaNetMessageReadHistoryRequest *) message)->target == UCA_NET_HISTORY_ZMQ ?
+                   UCAD_ACCESS_EXCLUSIVE : UCAD_ACCESS_FREE;
+        case UCA_NET_MESSAGE_TRIGGER:
+        case UCA_NET_MESSAGE_QUEUE_PROPERTY:
+        case UCA_NET_MESSAGE_STOP_PUSH:
+        case UCA_NET_MESSAGE_GRAB_STRIPE:
+        case UCA_NET_MESSAGE_SELECT_CAMERA:
+        case UCA_NET_MESSAGE_GET_STATS:
+        case UCA_NET_MESSAGE_CLOCK_SYNC:
+            return UCAD_ACCESS_FREE;
+        default:
+            return UCAD_ACCESS_EXCLUSIVE;
+    }
+}
+
+static void
+handle_select_camera_request (UcadSession *session, gpointer message, GError **stream_error)
+{
+    UcaNetMessageSelectCameraRequest *request;
+    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_SELECT_CAMERA };
+    UcadDevice *device;
+    GError *error = NULL;
+
+    request = (UcaNetMessageSelectCameraRequest *) message;
+    request->name[sizeof (request->name) - 1] = '\0';
+    device = ucad_device_lookup (request->name);
+
+    if (device == NULL)
+        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_UNKNOWN_CAMERA, "No camera `%s'", request->name);
+    else
+        session->device = device;
+
+    prepare_error_reply (error, &reply.error);
+    send_reply (session->connection, &reply, sizeof (reply), stream_error);
+}
+
+/**
+ * Reply with the metrics of all cameras, which never waits for a request in
+ * progress.
+ */
+static void
+handle_get_stats_request (UcadSession *session, GError **stream_error)
+{
+    UcaNetMessageGetStatsReply reply = { .type = UCA_NET_MESSAGE_GET_STATS };
+    GOutputStream *output;
+    gchar *stats;
+
+    stats = ucad_stats_to_prometheus ();
+    reply.size = strlen (stats);
+    prepare_error_reply (NULL, &reply.error);
+    output = g_io_stream_get_output_stream (G_IO_STREAM (session->connection));
+
+    if (g_output_stream_write_all (output, &reply, sizeof (reply), NULL, NULL, stream_error))
+        send_reply (session->connection, stats, reply.size, stream_error);
+
+    g_free (stats);
+}
+
+/**
+ * Reply with the clocks of ucad right away, so that the round trip bounds the
+ * error of the offset the client derives.
+ */
+static void
+handle_clock_sync_request (UcadSession *session, gpointer message, GError **stream_error)
+{
+    UcaNetMessageClockSyncReply reply = { .type = UCA_NET_MESSAGE_CLOCK_SYNC };
+
+    reply.client_time = ((UcaNetMessageClockSyncRequest *) message)->client_time;
+    reply.monotonic = g_get_monotonic_time ();
+    reply.real = g_get_real_time ();
+    prepare_error_reply (NULL, &reply.error);
+    send_reply (session->connection, &reply, sizeof (reply), stream_error);
+}
+
+/**
+ * Size of the structure a request of type is sent with. Requests which grew
+ * since the first version of the protocol are sent in their original size
+ * unless marked with UCA_NET_MESSAGE_EXTENDED. Returns 0 for unknown types.
+ */
+static gsize
+get_request_size (guint type)
+{
+    gboolean extended = (type & UCA_NET_MESSAGE_EXTENDED) != 0;
+
+    switch (UCA_NET_MESSAGE_GET_TYPE (type)) {
+        case UCA_NET_MESSAGE_GET_PROPERTIES:
+        case UCA_NET_MESSAGE_START_RECORDING:
+        case UCA_NET_MESSAGE_STOP_RECORDING:
+        case UCA_NET_MESSAGE_START_READOUT:
+        case UCA_NET_MESSAGE_STOP_READOUT:
+        case UCA_NET_MESSAGE_TRIGGER:
+        case UCA_NET_MESSAGE_STOP_PUSH:
+        case UCA_NET_MESSAGE_ZMQ_REMOVE_ALL_ENDPOINTS:
+        case UCA_NET_MESSAGE_GET_STATS:
+            return sizeof (UcaNetMessageDefault);
+        case UCA_NET_MESSAGE_GET_PROPERTY:
+            return sizeof (UcaNetMessageGetPropertyRequest);
+        case UCA_NET_MESSAGE_SET_PROPERTY:
+            return sizeof (UcaNetMessageSetPropertyRequest);
+        case UCA_NET_MESSAGE_GRAB:
+            return extended ? sizeof (UcaNetMessageGrabRequest) : sizeof (UcaNetMessageOriginalGrabRequest);
+        case UCA_NET_MESSAGE_PUSH:
+            return extended ? sizeof (UcaNetMessagePushRequest) : sizeof (UcaNetMessageOriginalPushRequest);
+        case UCA_NET_MESSAGE_ZMQ_ADD_ENDPOINT:
+            return extended ? sizeof (UcaNetMessageAddZmqEndpointRequest) : sizeof (UcaNetMessageOriginalAddZmqEndpointRequest);
+        case UCA_NET_MESSAGE_ZMQ_REMOVE_ENDPOINT:
+            return sizeof (UcaNetMessageRemoveZmqEndpointRequest);
+        case UCA_NET_MESSAGE_WRITE:
+            return sizeof (UcaNetMessageWriteRequest);
+        case UCA_NET_MESSAGE_SET_REFERENCE:
+            return sizeof (UcaNetMessageSetReferenceRequest);
+        case UCA_NET_MESSAGE_ACQUIRE_REFERENCE:
+            return sizeof (UcaNetMessageAcquireReferenceRequest);
+        case UCA_NET_MESSAGE_GRAB_STRIPE:
+            return sizeof (UcaNetMessageGrabStripeRequest);
+        case UCA_NET_MESSAGE_READ_HISTORY:
+            return sizeof (UcaNetMessageReadHistoryRequest);
+        case UCA_NET_MESSAGE_QUEUE_PROPERTY:
+            return sizeof (UcaNetMessageQueuePropertyRequest);
+        case UCA_NET_MESSAGE_TIMED_TRIGGER:
+            return sizeof (UcaNetMessageTimedTriggerRequest);
+        case UCA_NET_MESSAGE_SELECT_CAMERA:
+            return sizeof (UcaNetMessageSelectCameraRequest);
+        case UCA_NET_MESSAGE_CLOCK_SYNC:
+            return sizeof (UcaNetMessageClockSyncRequest);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Read exactly one request from the session, so that data following it, such
+ * as the payload of a write request, stays in the stream for its handler. The
+ * buffer holds the current structure of the request, with fields the client
+ * did not send zero. Returns NULL if the client closed the connection or the
+ * connection can no longer be used.
+ */
+static gchar *
+read_request_blocking (UcadSession *session, GError **error)
+{
+    GInputStream *input;
+    UcaNetMessageDefault header;
+    gchar *buffer;
+    gsize size;
+    gsize bytes_read = 0;
+
+    input = g_io_stream_get_input_stream (G_IO_STREAM (session->connection));
+
+    if (!g_input_stream_read_all (input, &header, sizeof (header), &bytes_read, NULL, error))
+        return NULL;
+
+    if (bytes_read == 0) {
+        /* Closed by the client */
+        return NULL;
+    }
+
+    if (bytes_read < sizeof (header)) {
+        g_set_error_literal (error, UCAD_ERROR, UCAD_ERROR_INVALID_REQUEST,
+                             "Connection closed within a request");
+        return NULL;
+    }
+
+    if ((size = get_request_size (header.type)) == 0) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_INVALID_REQUEST,
+                     "Unknown request type %u", (guint) header.type);
+        return NULL;
+    }
+
+    buffer = g_malloc0 (get_request_size (header.type | UCA_NET_MESSAGE_EXTENDED));
+    memcpy (buffer, &header, sizeof (header));
+
+    if (!g_input_stream_read_all (input, buffer + sizeof (header), size - sizeof (header),
+                                  &bytes_read, NULL, error)) {
+        g_free (buffer);
+        return NULL;
+    }
+
+    if (bytes_read < size - sizeof (header)) {
+        g_set_error_literal (error, UCAD_ERROR, UCAD_ERROR_INVALID_REQUEST,
+                             "Connection closed within a request");
+        g_free (buffer);
+        return NULL;
+    }
+
+    return buffer;
+}
+
+/*
+ * The request is read in a worker once its first bytes arrived. A client which
+ * stops within it must not keep the worker, so reading times out. Handlers
+ * and the wait for the next request are not limited, so the timeout only
+ * applies meanwhile.
+ */
+static gchar *
+read_request (UcadSession *session, GError **error)
+{
+    GSocket *socket = g_socket_connection_get_socket (session->connection);
+    gchar *buffer;
+
+    g_socket_set_timeout (socket, UCAD_REQUEST_TIMEOUT);
+    buffer = read_request_blocking (session, error);
+    g_socket_set_timeout (socket, 0);
+
+    return buffer;
+}
+
+static MessageHandler
+get_handler (UcaNetMessageType type)
+{
+    static const HandlerTable table[] = {
+        { UCA_NET_MESSAGE_GET_PROPERTIES,   handle_get_properties_request },
+        { UCA_NET_MESSAGE_GET_PROPERTY,     handle_get_property_request },
+        { UCA_NET_MESSAGE_SET_PROPERTY,     handle_set_property_request },
+        { UCA_NET_MESSAGE_START_RECORDING,  handle_start_recording_request },
+        { UCA_NET_MESSAGE_STOP_RECORDING,   handle_stop_recording_request },
+        { UCA_NET_MESSAGE_START_READOUT,    handle_start_readout_request },
+        { UCA_NET_MESSAGE_STOP_READOUT,     handle_stop_readout_request },
+        { UCA_NET_MESSAGE_TRIGGER,          handle_trigger_request },
+        { UCA_NET_MESSAGE_GRAB,             handle_grab_request },
+        { UCA_NET_MESSAGE_PUSH,             handle_push_request },
+        { UCA_NET_MESSAGE_STOP_PUSH,        handle_stop_push_request },
+        { UCA_NET_MESSAGE_ZMQ_ADD_ENDPOINT, handle_zmq_add_endpoint_request },
+        { UCA_NET_MESSAGE_ZMQ_REMOVE_ENDPOINT,
+                                            handle_zmq_remove_endpoint_request },
+        { UCA_NET_MESSAGE_ZMQ_REMOVE_ALL_ENDPOINTS,
+                                            handle_zmq_remove_all_endpoints_request },
+        { UCA_NET_MESSAGE_WRITE,            handle_write_request },
+        { UCA_NET_MESSAGE_SET_REFERENCE,    handle_set_reference_request },
+        { UCA_NET_MESSAGE_ACQUIRE_REFERENCE,
+                                            handle_acquire_reference_request },
+        { UCA_NET_MESSAGE_GRAB_STRIPE,      handle_grab_stripe_request },
+        { UCA_NET_MESSAGE_READ_HISTORY,     handle_read_history_request },
+        { UCA_NET_MESSAGE_QUEUE_PROPERTY,   handle_queue_property_request },
+        { UCA_NET_MESSAGE_TIMED_TRIGGER,    handle_timed_trigger_request },
+        { UCA_NET_MESSAGE_INVALID,          NULL }
+    };
+
+    for (guint i = 0; table[i].type != UCA_NET_MESSAGE_INVALID; i++) {
+        if (table[i].type == type)
+            return table[i].handler;
+    }
+
+    return NULL;
+}
+
+/**
+ * Handle a request with the camera its session selected, taking the locks its
+ * access requires. Returns FALSE if the connection can no longer be used.
+ */
+static gboolean
+handle_request (UcadSession *session, gpointer message, UcadAccess access)
+{
+    UcadDevice *device = session->device;
+    UcaNetMessageType type = UCA_NET_MESSAGE_GET_TYPE (((UcaNetMessageDefault *) message)->type);
+    GError *error = NULL;
+    gint64 start = g_get_monotonic_time ();
+
+    if (type == UCA_NET_MESSAGE_SELECT_CAMERA) {
+        handle_select_camera_request (session, message, &error);
+    }
+    else if (type == UCA_NET_MESSAGE_GET_STATS) {
+        handle_get_stats_request (session, &error);
+    }
+    else if (type == UCA_NET_MESSAGE_CLOCK_SYNC) {
+        handle_clock_sync_request (session, message, &error);
+    }
+    else {
+        gboolean setting;
+        gboolean pausing;
+
+        /* Exclusive requests are already serialized by their queue, the lock
+         * guards what they set up against the other requests. Concurrent
+         * properties are read and set meanwhile, but only while frames are
+         * acquired. */
+        setting = access == UCAD_ACCESS_SETTER ||
+                  (access == UCAD_ACCESS_EXCLUSIVE && !is_frame_request (type));
+        pausing = access == UCAD_ACCESS_EXCLUSIVE && is_plugin_request (type);
+
+        if (access == UCAD_ACCESS_EXCLUSIVE)
+            g_mutex_lock (&device->access_lock);
+
+        if (access == UCAD_ACCESS_QUERY)
+            g_rw_lock_reader_lock (&device->property_lock);
+        else if (setting)
+            g_rw_lock_writer_lock (&device->property_lock);
+
+        if (pausing)
+            ucad_acquisition_pause (device);
+
+        UCAD_TRACE (request_wait, start, type, 0);
+        start = g_get_monotonic_time ();
+        get_handler (type) (session->connection, device->camera, message, &error);
+
+        if (pausing)
+            ucad_acquisition_resume (device);
+
+        if (access == UCAD_ACCESS_QUERY)
+            g_rw_lock_reader_unlock (&device->property_lock);
+        else if (setting)
+            g_rw_lock_writer_unlock (&device->property_lock);
+
+        if (access == UCAD_ACCESS_EXCLUSIVE)
+            g_mutex_unlock (&device->access_lock);
+    }
+
+    /* The wait for the locks is the request_wait span */
+    UCAD_TRACE (request, start, type, 0);
+
+    if (error != NULL) {
+        g_warning ("Error handling requests: %s", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+ucad_session_watch (UcadSession *session);
+
+/**
+ * Wait for the next request of a session if it is still open, or close it.
+ */
+static void
+ucad_session_continue (UcadSession *session, gboolean open)
+{
+    if (open) {
+        ucad_session_watch (session);
+        return;
+    }
+
+    g_io_stream_close (G_IO_STREAM (session->connection), NULL, NULL);
+    g_object_unref (session->connection);
+    g_free (session);
+}
+
+static void
+ucad_request_finish (UcadRequest *request, gboolean open)
+{
+    ucad_session_continue (request->session, open);
+    g_free (request->buffer);
+    g_free (request);
+}
+
+static void
+ucad_request_run (UcadRequest *request)
+{
+    ucad_request_finish (request, handle_request (request->session, request->buffer, request->access));
+}
+
+/**
+ * Queue request and, unless another worker already runs the queue, run it and
+ * all requests queued meanwhile in this one.
+ */
+static void
+ucad_serial_queue_run (UcadSerialQueue *queue, UcadRequest *request, void (*run) (UcadRequest *))
+{
+    g_mutex_lock (&queue->lock);
+    g_queue_push_tail (&queue->requests, request);
+
+    if (queue->running) {
+        g_mutex_unlock (&queue->lock);
+        return;
+    }
+
+    queue->running = TRUE;
+
+    while ((request = g_queue_pop_head (&queue->requests)) != NULL) {
+        g_mutex_unlock (&queue->lock);
+        run (request);
+        g_mutex_lock (&queue->lock);
     }
-    g_thread_pool_free(pool, FALSE, TRUE);
-    g_free(payload->buffer);
-    g_free(payload);
-    prepare_error_reply(error, &reply.error);
-    send_reply(connection, &reply, sizeof(reply), stream_error);
 
-#else
-    g_set_error (stream_error, UCAD_ERROR, UCAD_ERROR_ZMQ_NOT_AVAILABLE,
-        "ZMQ not enabled");
-#endif
+    queue->running = FALSE;
+    g_mutex_unlock (&queue->lock);
 }
 
+/**
+ * Grab from the acquisition ring, which only excludes other grabs, or from the
+ * camera like any other exclusive request if recording stopped meanwhile.
+ */
 static void
-handle_stop_push_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+ucad_request_run_ring_grab (UcadRequest *request)
 {
-#ifdef WITH_ZMQ_NETWORKING
-    g_debug ("Stop push request");
-    stop_streaming_requested = TRUE;
-    UcaNetDefaultReply reply = { .type = ((UcaNetMessageDefault *) message)->type };
-    send_reply (connection, &reply, sizeof (reply), stream_error);
-#else
-  g_set_error(stream_error, UCAD_ERROR, UCAD_ERROR_ZMQ_NOT_AVAILABLE,
-      "ZMQ not enabled");
-#endif
+    UcadDevice *device = request->session->device;
+    gboolean open;
+
+    g_mutex_lock (&device->grab_lock);
+
+    if (device->acquisition.ring == NULL) {
+        g_mutex_unlock (&device->grab_lock);
+        ucad_serial_queue_run (&device->exclusive_queue, request, ucad_request_run);
+        return;
+    }
+
+    open = handle_request (request->session, request->buffer, UCAD_ACCESS_FREE);
+    g_mutex_unlock (&device->grab_lock);
+    ucad_request_finish (request, open);
 }
 
+/**
+ * Read the request which arrived on a session in a worker and handle it.
+ * Exclusive requests and grabs from the ring may wait for as long as a push
+ * or for the next frame. They are queued per camera instead of waiting in a
+ * worker each, so that requests like STOP_PUSH or TRIGGER which end the wait
+ * always find a free worker.
+ */
 static void
-handle_zmq_add_endpoint_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+ucad_session_run (UcadSession *session, gpointer user_data)
 {
-#ifdef WITH_ZMQ_NETWORKING
-    UcaNetMessageAddZmqEndpointRequest *request = (UcaNetMessageAddZmqEndpointRequest *) message;
-    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_ZMQ_ADD_ENDPOINT };
-    static gpointer context = NULL;
-    UcadZmqNode *node = g_new (UcadZmqNode, 1);
+    UcadDevice *device = session->device;
+    UcadRequest *request;
+    gchar *buffer;
     GError *error = NULL;
 
-    if (zmq_endpoints == NULL) {
-        zmq_endpoints = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, ucad_zmq_node_free);
-    }
-
-    if (g_hash_table_lookup (zmq_endpoints, request->endpoint) == NULL) {
-        g_debug ("Adding endpoint `%s'", request->endpoint);
-        if (context == NULL) {
-            if ((context = zmq_ctx_new ()) == NULL) {
-                g_set_error (&error, UCAD_ERROR, UCAD_ERROR_ZMQ_CONTEXT_CREATION_FAILED,
-                             "zmq context creation failed: %s\n", zmq_strerror (zmq_errno ()));
-                goto send_error_reply;
-            }
-        }
-        if (!ucad_zmq_node_init (node, request, context, &error)) {
-            goto send_error_reply;
+    if ((buffer = read_request (session, &error)) == NULL) {
+        if (error != NULL) {
+            g_warning ("Error reading request: %s", error->message);
+            g_error_free (error);
         }
-        g_hash_table_insert (zmq_endpoints, g_strdup (request->endpoint), node);
-    } else {
-        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_ZMQ_INVALID_ENDPOINT,
-                     "zmq endpoint already in list: %s\n", request->endpoint);
-        g_debug ("Endpoint `%s' already in list", request->endpoint);
+
+        ucad_session_continue (session, FALSE);
+        return;
     }
 
-send_error_reply:
-    prepare_error_reply (error, &reply.error);
-    send_reply (connection, &reply, sizeof (reply), stream_error);
-    g_debug ("Current number of endpoints: %d", g_hash_table_size (zmq_endpoints));
-#else
-    g_set_error(stream_error, UCAD_ERROR, UCAD_ERROR_ZMQ_NOT_AVAILABLE,
-        "ZMQ not enabled");
-#endif
+    request = g_new0 (UcadRequest, 1);
+    request->session = session;
+    request->buffer = buffer;
+    request->access = get_access ((UcaNetMessageDefault *) buffer);
+
+    if (UCA_NET_MESSAGE_GET_TYPE (((UcaNetMessageDefault *) buffer)->type) == UCA_NET_MESSAGE_GRAB &&
+        ucad_acquisition_is_running (device))
+        ucad_serial_queue_run (&device->ring_queue, request, ucad_request_run_ring_grab);
+    else if (request->access == UCAD_ACCESS_EXCLUSIVE)
+        ucad_serial_queue_run (&device->exclusive_queue, request, ucad_request_run);
+    else
+        ucad_request_run (request);
 }
 
-static void
-handle_zmq_remove_endpoint_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+static gboolean
+ucad_session_readable (GSocket *socket, GIOCondition condition, UcadSession *session)
 {
-#ifdef WITH_ZMQ_NETWORKING
-    UcaNetMessageRemoveZmqEndpointRequest *request = (UcaNetMessageRemoveZmqEndpointRequest *) message;
-    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_ZMQ_REMOVE_ENDPOINT };
     GError *error = NULL;
-    UcadZmqNode *node = g_hash_table_lookup (zmq_endpoints, request->endpoint);
 
-    if (node == NULL) {
-        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_ZMQ_INVALID_ENDPOINT,
-                     "zmq endpoint not in list: %s\n", request->endpoint);
-        g_debug ("Endpoint `%s' not in list", request->endpoint);
-    } else {
-        g_hash_table_remove (zmq_endpoints, request->endpoint);
-        g_debug ("Removed endpoint `%s'", request->endpoint);
+    if (!g_thread_pool_push (workers, session, &error)) {
+        g_warning ("Could not handle request: %s", error->message);
+        g_error_free (error);
     }
 
-    prepare_error_reply (error, &reply.error);
-    send_reply (connection, &reply, sizeof (reply), stream_error);
-    g_debug ("Current number of endpoints: %d", g_hash_table_size (zmq_endpoints));
-#else
-    g_set_error(stream_error, UCAD_ERROR, UCAD_ERROR_ZMQ_NOT_AVAILABLE,
-        "ZMQ not enabled");
-#endif
+    return G_SOURCE_REMOVE;
 }
 
+/**
+ * Let the main loop wait until the next request of a session arrives.
+ */
 static void
-handle_zmq_remove_all_endpoints_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+ucad_session_watch (UcadSession *session)
 {
-#ifdef WITH_ZMQ_NETWORKING
-    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_ZMQ_REMOVE_ALL_ENDPOINTS };
+    GSource *source;
 
-    if (zmq_endpoints != NULL) {
-        g_hash_table_remove_all (zmq_endpoints);
-    }
-    send_reply (connection, &reply, sizeof (reply), stream_error);
-    g_debug ("All endpoints removed");
-#else
-    g_set_error(stream_error, UCAD_ERROR, UCAD_ERROR_ZMQ_NOT_AVAILABLE,
-        "ZMQ not enabled");
-#endif
+    source = g_socket_create_source (g_socket_connection_get_socket (session->connection),
+                                     G_IO_IN | G_IO_HUP | G_IO_ERR, NULL);
+    g_source_set_callback (source, (GSourceFunc) ucad_session_readable, session, NULL);
+    g_source_attach (source, NULL);
+    g_source_unref (source);
 }
 
-static void
-handle_write_request (GSocketConnection *connection, UcaCamera *camera, gpointer message, GError **stream_error)
+static gboolean
+incoming_callback (GSocketService *service, GSocketConnection *connection, GObject *source, gpointer user_data)
 {
-    GInputStream *input;
-    UcaNetMessageWriteRequest *request;
-    UcaNetDefaultReply reply = { .type = UCA_NET_MESSAGE_WRITE };
-    gchar *buffer;
-    gsize bytes_left;
-    GError *error = NULL;
+    UcadSession *session;
 
-    input = g_io_stream_get_input_stream (G_IO_STREAM (connection));
-    request = (UcaNetMessageWriteRequest *) message;
-    buffer = g_malloc0 (request->size);
-    bytes_left = request->size;
+#if defined (HAVE_UNIX) && GLIB_CHECK_VERSION (2, 36, 0)
+    /* Replies such as trigger acknowledgements must not wait for more data */
+    g_socket_set_option (g_socket_connection_get_socket (connection), IPPROTO_TCP, TCP_NODELAY, TRUE, NULL);
+#endif
 
-    while (bytes_left > 0) {
-        gssize read;
+    session = g_new0 (UcadSession, 1);
+    session->connection = g_object_ref (connection);
+    session->device = g_ptr_array_index (devices, 0);
+    ucad_session_watch (session);
 
-        read = g_input_stream_read (input, &buffer[request->size - bytes_left], bytes_left, NULL, stream_error);
+    return TRUE;
+}
 
-        if (read < 0)
-            goto handle_write_request_cleanup;
+static gboolean
+ucad_write_stats (gpointer user_data)
+{
+    GError *error = NULL;
 
-        bytes_left -= read;
+    if (!ucad_stats_write_file (stats_file, &error)) {
+        g_warning ("Could not write statistics: %s", error->message);
+        g_error_free (error);
     }
 
-    uca_camera_write (camera, request->name, buffer, request->size, &error);
+    return G_SOURCE_CONTINUE;
+}
 
-    prepare_error_reply (error, &reply.error);
-    send_reply (connection, &reply, sizeof (reply), stream_error);
+static gboolean
+ucad_log_stats (gpointer user_data)
+{
+    gchar *summary = ucad_stats_get_summary ();
 
-handle_write_request_cleanup:
-    g_free (buffer);
+    g_message ("%s", summary);
+    g_free (summary);
+
+    return G_SOURCE_CONTINUE;
 }
 
 static gboolean
-run_callback (GSocketService *service, GSocketConnection *connection, GObject *source, gpointer user_data)
+ucad_stop_trace (gpointer user_data)
 {
-    GInputStream *input;
-    UcaCamera *camera;
-    UcaNetMessageDefault *message;
-    gchar *buffer;
     GError *error = NULL;
 
-    HandlerTable table[] = {
-        { UCA_NET_MESSAGE_GET_PROPERTIES,   handle_get_properties_request },
-        { UCA_NET_MESSAGE_GET_PROPERTY,     handle_get_property_request },
-        { UCA_NET_MESSAGE_SET_PROPERTY,     handle_set_property_request },
-        { UCA_NET_MESSAGE_START_RECORDING,  handle_start_recording_request },
-        { UCA_NET_MESSAGE_STOP_RECORDING,   handle_stop_recording_request },
-        { UCA_NET_MESSAGE_START_READOUT,    handle_start_readout_request },
-        { UCA_NET_MESSAGE_STOP_READOUT,     handle_stop_readout_request },
-        { UCA_NET_MESSAGE_TRIGGER,          handle_trigger_request },
-        { UCA_NET_MESSAGE_GRAB,             handle_grab_request },
-        { UCA_NET_MESSAGE_PUSH,             handle_push_request },
-        { UCA_NET_MESSAGE_STOP_PUSH,        handle_stop_push_request },
-        { UCA_NET_MESSAGE_ZMQ_ADD_ENDPOINT, handle_zmq_add_endpoint_request },
-        { UCA_NET_MESSAGE_ZMQ_REMOVE_ENDPOINT,
-                                            handle_zmq_remove_endpoint_request },
-        { UCA_NET_MESSAGE_ZMQ_REMOVE_ALL_ENDPOINTS,
-                                            handle_zmq_remove_all_endpoints_request },
-        { UCA_NET_MESSAGE_WRITE,            handle_write_request },
-        { UCA_NET_MESSAGE_INVALID,          NULL }
-    };
-
-    camera = UCA_CAMERA (user_data);
-    buffer = g_malloc0 (4096);
-    input = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+    if (!ucad_trace_stop (trace_file, &error)) {
+        g_warning ("Could not write trace: %s", error->message);
+        g_error_free (error);
+    }
 
-    /* looks dangerous */
-    g_input_stream_read (input, buffer, 4096, NULL, &error);
-    message = (UcaNetMessageDefault *) buffer;
+    return G_SOURCE_REMOVE;
+}
 
-#if (GLIB_CHECK_VERSION (2, 36, 0))
-    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE)) {
-#else
-    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_FAILED)) {
-#endif
-        g_error_free (error);
-        error = NULL;
+/**
+ * Record the frame path for the next trace_seconds and write it to
+ * trace_file then.
+ */
+static gboolean
+ucad_start_trace (gpointer user_data)
+{
+    if (trace_file == NULL) {
+        g_warning ("Not tracing, start ucad with --trace-file");
+        return G_SOURCE_CONTINUE;
     }
-    else {
-        for (guint i = 0; table[i].type != UCA_NET_MESSAGE_INVALID; i++) {
-            if (table[i].type == message->type) {
-                /* We allow only one request at a time by using a lock. The only
-                 * exception is the request to stop the stream which must be
-                 * able to arrive while the streaming is in progress. */
-                if (message->type != UCA_NET_MESSAGE_STOP_PUSH) {
-                    g_mutex_lock (&access_lock);
-                }
-                table[i].handler (connection, camera, buffer, &error);
-                if (message->type != UCA_NET_MESSAGE_STOP_PUSH) {
-                    g_mutex_unlock (&access_lock);
-                }
-            }
-        }
 
-        if (error != NULL) {
-            g_warning ("Error handling requests: %s", error->message);
-            g_error_free (error);
-        }
+    if (!ucad_trace_start ((guint) MAX (trace_events, 1))) {
+        g_warning ("Already tracing");
+        return G_SOURCE_CONTINUE;
     }
 
-    g_free (buffer);
-    return FALSE;
+    g_message ("Tracing for %d seconds into `%s'", MAX (trace_seconds, 1), trace_file);
+    g_timeout_add_seconds (MAX (trace_seconds, 1), ucad_stop_trace, NULL);
+
+    return G_SOURCE_CONTINUE;
 }
 
 static void
-serve (UcaCamera *camera, guint16 port, GError **error)
+serve (guint16 port, GError **error)
 {
     GSocketService *service;
 
-    service = g_threaded_socket_service_new (2);
+    /* Connections are only watched by the main loop, requests are handled by
+     * a bounded number of workers, at least enough for the exclusive request
+     * and the ring grab of each camera and one more to stop them */
+    workers = g_thread_pool_new ((GFunc) ucad_session_run, NULL,
+                                 MAX (max_workers, 2 * (gint) devices->len + 1), FALSE, error);
+
+    if (workers == NULL)
+        return;
+
+    service = g_socket_service_new ();
 
     if (!g_socket_listener_add_inet_port (G_SOCKET_LISTENER (service), port, NULL, error))
         return;
 
-    g_signal_connect (service, "run", G_CALLBACK (run_callback), camera);
+    g_signal_connect (service, "incoming", G_CALLBACK (incoming_callback), NULL);
 
     loop = g_main_loop_new (NULL, TRUE);
 
 #ifdef HAVE_UNIX
     g_unix_signal_add (SIGINT, (GSourceFunc) g_main_loop_quit, loop);
+    g_unix_signal_add (SIGUSR1, ucad_log_stats, NULL);
+    g_unix_signal_add (SIGUSR2, ucad_start_trace, NULL);
 #endif
 
+    /* Rewritten in the main loop, so that requests never wait for it */
+    if (stats_file != NULL)
+        g_timeout_add_seconds (MAX (stats_interval, 1), ucad_write_stats, NULL);
+
     g_main_loop_run (loop);
 }
 
+/**
+ * Create a camera from a specification NAME=PLUGIN[@NODE] and add it to the
+ * served devices.
+ */
+static gboolean
+ucad_add_device (UcaPluginManager *manager, const gchar *spec, GError **error)
+{
+    UcaCamera *camera;
+    UcadAffinity *affinity = NULL;
+    gchar **parts;
+    gchar *plugin;
+    gchar *node;
+
+    parts = g_strsplit (spec, "=", 2);
+
+    if (parts[0] == NULL || parts[1] == NULL || *parts[0] == '\0') {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_UNKNOWN_CAMERA,
+                     "Camera `%s' is not given as NAME=PLUGIN[@NODE]", spec);
+        g_strfreev (parts);
+        return FALSE;
+    }
+
+    if (ucad_device_lookup (parts[0]) != NULL) {
+        g_set_error (error, UCAD_ERROR, UCAD_ERROR_UNKNOWN_CAMERA, "Camera `%s' given twice", parts[0]);
+        g_strfreev (parts);
+        return FALSE;
+    }
+
+    plugin = parts[1];
+    node = strchr (plugin, '@');
+
+    if (node != NULL) {
+        *node++ = '\0';
+        affinity = ucad_affinity_new_for_node ((guint) g_ascii_strtoull (node, NULL, 10), error);
+
+        if (affinity == NULL) {
+            g_strfreev (parts);
+            return FALSE;
+        }
+    }
+
+    camera = uca_plugin_manager_get_camera (manager, plugin, error, NULL);
+
+    if (camera == NULL) {
+        ucad_affinity_free (affinity);
+        g_strfreev (parts);
+        return FALSE;
+    }
+
+    g_ptr_array_add (devices, ucad_device_new (parts[0], camera, affinity));
+    g_debug ("Serving `%s' as `%s'%s%s", plugin, parts[0], affinity != NULL ? " on " : "",
+             affinity != NULL ? ucad_affinity_get_description (affinity) : "");
+    g_strfreev (parts);
+
+    return TRUE;
+}
+
+/**
+ * Log how threads and sockets are set up after options were parsed.
+ */
+static void
+ucad_report_settings (void)
+{
+    for (guint i = 0; i < devices->len; i++) {
+        UcadDevice *device = g_ptr_array_index (devices, i);
+        UcadAffinity *cpus = device->acquisition_cpus != NULL ? device->acquisition_cpus : device->affinity;
+
+        g_message ("Camera `%s': grabbing on CPUs %s", device->name,
+                   cpus != NULL ? ucad_affinity_get_description (cpus) : "any");
+    }
+
+    g_message ("Sending on CPUs %s, real-time priority %d",
+               sender_cpus != NULL ? ucad_affinity_get_description (sender_cpus) : "of the camera",
+               realtime_priority);
+
+#ifdef WITH_ZMQ_NETWORKING
+    g_message ("ZMQ I/O threads %d, send buffer %d bytes%s", zmq_ctx_get (zmq_context, ZMQ_IO_THREADS),
+               zmq_sndbuf, zmq_sndbuf > 0 ? "" : " (system default)");
+#endif
+}
+
 int
 main (int argc, char **argv)
 {
     GOptionContext *context;
     UcaPluginManager *manager;
-    UcaCamera *camera;
+    UcaCamera *camera = NULL;
+    UcadAffinity *affinity = NULL;
     GError *error = NULL;
     static guint16 port = UCA_NET_DEFAULT_PORT;
+    static gchar *io_engine = NULL;
+    static gchar *replay = NULL;
+    static gdouble replay_fps = 0.0;
+    static gchar **camera_specs = NULL;
+    static gint numa_node = -1;
+    static gchar *acquisition_cpus = NULL;
+    static gchar *sender_cpu_list = NULL;
 
     static GOptionEntry entries[] = {
         { "port", 'p', 0, G_OPTION_ARG_INT, &port, "Listen port (default: "G_STRINGIFY (UCA_NET_DEFAULT_PORT)")", NULL },
+        { "io-engine", 0, 0, G_OPTION_ARG_STRING, &io_engine, "Engine sending grabbed frames, gio or uring (default: gio)", "ENGINE" },
+        { "ring-size", 0, 0, G_OPTION_ARG_INT, &ring_size, "Acquire continuously into a ring of N frames while recording (default: 0, off)", "N" },
+        { "ring-bytes", 0, 0, G_OPTION_ARG_INT64, &ring_bytes, "Size the ring by bytes instead of frames", "BYTES" },
+        { "ring-hugepages", 0, 0, G_OPTION_ARG_NONE, &ring_hugepages, "Allocate the ring from huge pages", NULL },
+        { "pool-hugepages", 0, 0, G_OPTION_ARG_NONE, &pool_hugepages, "Allocate frame buffers from huge pages", NULL },
+        { "pool-mlock", 0, 0, G_OPTION_ARG_NONE, &pool_mlock, "Lock frame buffers in memory", NULL },
+        { "max-workers", 0, 0, G_OPTION_ARG_INT, &max_workers, "Requests handled at the same time (default: 16)", "N" },
+        { "replay", 0, 0, G_OPTION_ARG_FILENAME, &replay, "Serve frames recorded to file://PREFIX instead of a camera", "PREFIX" },
+        { "replay-fps", 0, 0, G_OPTION_ARG_DOUBLE, &replay_fps, "Frame rate of the replay (default: 0, as fast as possible)", "FPS" },
+        { "camera", 0, 0, G_OPTION_ARG_STRING_ARRAY, &camera_specs, "Also serve PLUGIN as NAME, pinned to NUMA node NODE", "NAME=PLUGIN[@NODE]" },
+        { "numa-node", 0, 0, G_OPTION_ARG_INT, &numa_node, "Pin the threads of the default camera to NUMA node N", "N" },
+        { "acquisition-cpus", 0, 0, G_OPTION_ARG_STRING, &acquisition_cpus, "Pin the grabbing threads of the default camera to CPUs, e.g. 2-3", "LIST" },
+        { "sender-cpus", 0, 0, G_OPTION_ARG_STRING, &sender_cpu_list, "Pin each ZMQ sending thread to one of CPUs", "LIST" },
+        { "realtime-priority", 0, 0, G_OPTION_ARG_INT, &realtime_priority, "Run grabbing and sending threads with SCHED_FIFO priority N (default: 0, off)", "N" },
+        { "zmq-io-threads", 0, 0, G_OPTION_ARG_INT, &zmq_io_threads, "Number of ZMQ I/O threads (default: 1)", "N" },
+        { "zmq-sndbuf", 0, 0, G_OPTION_ARG_INT, &zmq_sndbuf, "Kernel send buffer of ZMQ sockets (default: 0, system default)", "BYTES" },
+        { "stats-file", 0, 0, G_OPTION_ARG_FILENAME, &stats_file, "Rewrite metrics in the Prometheus text format to FILE periodically", "FILE" },
+        { "stats-interval", 0, 0, G_OPTION_ARG_INT, &stats_interval, "Seconds between rewriting the metrics file (default: 10)", "N" },
+        { "trace-file", 0, 0, G_OPTION_ARG_FILENAME, &trace_file, "Write a Chrome trace of the frame path to FILE on SIGUSR2", "FILE" },
+        { "trace-seconds", 0, 0, G_OPTION_ARG_INT, &trace_seconds, "Length of a trace (default: 10)", "N" },
+        { "trace-events", 0, 0, G_OPTION_ARG_INT, &trace_events, "Spans kept in a trace (default: 262144)", "N" },
+        { "concurrent-properties", 0, 0, G_OPTION_ARG_STRING_ARRAY, &concurrent_properties, "Read and set PROPERTY while frames are acquired, if the plugin allows it", "PROPERTY" },
+        { "data-directory", 0, 0, G_OPTION_ARG_FILENAME, &data_directory, "Let clients spill and record frames below DIR only (default: none)", "DIR" },
         { NULL }
     };
 
@@ -1005,37 +5175,131 @@ main (int argc, char **argv)
         goto cleanup_manager;
     }
 
-    if (argc < 2) {
+    if (argc < 2 && replay == NULL && camera_specs == NULL) {
         g_print ("%s\n", g_option_context_get_help (context, TRUE, NULL));
         goto cleanup_manager;
     }
 
-    camera = uca_plugin_manager_get_camera (manager, argv[argc - 1], &error, NULL);
+    if (ring_size < 0 || ring_bytes < 0) {
+        g_printerr ("Ring size must not be negative\n");
+        goto cleanup_manager;
+    }
 
-    if (camera == NULL) {
-        g_printerr ("Error during initialization: %s\n", error->message);
+    if (data_directory != NULL && !g_file_test (data_directory, G_FILE_TEST_IS_DIR)) {
+        g_printerr ("Data directory `%s' does not exist\n", data_directory);
         goto cleanup_manager;
     }
 
-    if (!uca_camera_parse_arg_props (camera, argv, argc - 1, &error)) {
-        g_printerr ("Error setting properties: %s\n", error->message);
+    if (io_engine != NULL && !g_strcmp0 (io_engine, "uring")) {
+        GError *uring_error = NULL;
+        UcadUring *uring;
+
+        /* Only to check support, grabs are sent with rings of their own */
+        uring = ucad_uring_new (UCAD_URING_QUEUE_DEPTH, &uring_error);
+
+        if (uring == NULL) {
+            g_warning ("Falling back to GIO: %s", uring_error->message);
+            g_error_free (uring_error);
+        }
+        else {
+            g_debug ("Using io_uring engine (zero-copy %s)",
+                     ucad_uring_supports_zerocopy (uring) ? "supported" : "not supported");
+            ucad_uring_free (uring);
+            use_uring = TRUE;
+        }
+    }
+    else if (io_engine != NULL && g_strcmp0 (io_engine, "gio")) {
+        g_printerr ("Unknown I/O engine `%s'\n", io_engine);
         goto cleanup_manager;
     }
 
-    if (error != NULL)
+    devices = g_ptr_array_new_with_free_func ((GDestroyNotify) ucad_device_free);
+    realtime_priority = ucad_affinity_clamp_priority (realtime_priority);
+
+    if (sender_cpu_list != NULL && (sender_cpus = ucad_affinity_new_from_list (sender_cpu_list, &error)) == NULL) {
         g_printerr ("Error: %s\n", error->message);
+        goto cleanup_devices;
+    }
+
+#ifdef WITH_ZMQ_NETWORKING
+    /* I/O threads are started with the first socket and cannot change later */
+    if ((zmq_context = zmq_ctx_new ()) == NULL) {
+        g_set_error (&error, UCAD_ERROR, UCAD_ERROR_ZMQ_CONTEXT_CREATION_FAILED,
+                     "zmq context creation failed: %s", zmq_strerror (zmq_errno ()));
+        g_printerr ("Error: %s\n", error->message);
+        goto cleanup_devices;
+    }
+
+    if (zmq_io_threads > 0)
+        zmq_ctx_set (zmq_context, ZMQ_IO_THREADS, zmq_io_threads);
+
+#if defined (ZMQ_THREAD_SCHED_POLICY) && defined (HAVE_UNIX)
+    if (realtime_priority > 0) {
+        zmq_ctx_set (zmq_context, ZMQ_THREAD_SCHED_POLICY, SCHED_FIFO);
+        zmq_ctx_set (zmq_context, ZMQ_THREAD_PRIORITY, realtime_priority);
+    }
+#endif
+#endif
+
+    if (numa_node >= 0 && (affinity = ucad_affinity_new_for_node ((guint) numa_node, &error)) == NULL) {
+        g_printerr ("Error: %s\n", error->message);
+        goto cleanup_devices;
+    }
+
+    /* The camera given as argument, if any, is the default */
+    if (replay != NULL)
+        camera = ucad_replay_camera_new (replay, replay_fps, &error);
+    else if (argc >= 2)
+        camera = uca_plugin_manager_get_camera (manager, argv[argc - 1], &error, NULL);
+
+    if (camera == NULL && error != NULL) {
+        g_printerr ("Error during initialization: %s\n", error->message);
+        ucad_affinity_free (affinity);
+        goto cleanup_devices;
+    }
+
+    if (camera != NULL) {
+        UcadDevice *device = ucad_device_new (replay != NULL ? "replay" : argv[argc - 1], camera, affinity);
+
+        g_ptr_array_add (devices, device);
+
+        if (acquisition_cpus != NULL &&
+            (device->acquisition_cpus = ucad_affinity_new_from_list (acquisition_cpus, &error)) == NULL) {
+            g_printerr ("Error: %s\n", error->message);
+            goto cleanup_devices;
+        }
+
+        if (replay == NULL && !uca_camera_parse_arg_props (camera, argv, argc - 1, &error)) {
+            g_printerr ("Error setting properties: %s\n", error->message);
+            goto cleanup_devices;
+        }
+    }
+    else {
+        ucad_affinity_free (affinity);
+    }
+
+    for (guint i = 0; camera_specs != NULL && camera_specs[i] != NULL; i++) {
+        if (!ucad_add_device (manager, camera_specs[i], &error)) {
+            g_printerr ("Error during initialization: %s\n", error->message);
+            goto cleanup_devices;
+        }
+    }
 
     g_option_context_free (context);
 
-    serve (camera, port, &error);
+    for (guint i = 0; i < devices->len; i++)
+        ucad_device_prepare_pool (g_ptr_array_index (devices, i));
+
+    ucad_report_settings ();
+
+    serve (port, &error);
 
     if (error != NULL)
         g_printerr ("Error: %s\n", error->message);
 
-    g_object_unref (camera);
-    if (zmq_endpoints != NULL) {
-        g_hash_table_destroy (zmq_endpoints);
-    }
+cleanup_devices:
+    g_ptr_array_free (devices, TRUE);
+    ucad_affinity_free (sender_cpus);
 
 cleanup_manager:
     g_object_unref (manager);